@@ -2,91 +2,42 @@
 // *                           ATTACK TESTING FUNCTIONS                        *
 // *****************************************************************************
 
-#include "chess_engine.h"
-#include "globals.h"
-
-// ============================================================================
+#include "chess_engine.h"
+#include "globals.h"
+#include "bitboards.h"
 
-bool isAttacked(int square,int sideAttacking)
-{ // This function returns true if side 1-sideAttacking is in Check now.
-  // It basically tries all moves *FROM* the square and sees if there is one
-  // of the oponent's peices on the square (Must be the same as the move we
-  // are trieing).
-  // Has been ordered (most likely to be true first) to try to make quicker.
-  // VERY OPTOMIZED - NEARLY AS FAST AS (Old N=64) InCheck() function!!!
+// ============================================================================
 
-  int* MovePtr;                             // To iterate through Move Tables.
-  int tempSquare;                           // Holds square read from lookup.
-  int dirIndex;                             // To iterate through move dirs.
+bool isAttacked(const Position &pos,int square,int sideAttacking)
+{ // This function returns true if side 1-sideAttacking is in Check now.
+  // It basically looks up the attacks *FROM* the square for each type of
+  // piece and sees if there is one of the oponent's pieces on them (Must be
+  // the same as the move we are trieing).
+  // Has been ordered (cheapest tests first) to try to make quicker.
 
-  // Do both in the same iterator for speed.
-  for (dirIndex=0;dirIndex<4;dirIndex++) {
+  const GameState &state=*pos.currentState;
+  const Bitboard attackers=state.colourBB[sideAttacking];
+  const Bitboard occupied=state.colourBB[WHITE]|state.colourBB[BLACK];
 
-    // Test For Oponment's Rooks and Queens (Straight moves).
-    MovePtr=g_straightMoves[square][dirIndex];
-    while ((tempSquare=(*(MovePtr++)))!=END_OF_LOOKUP){
-      if (g_currentColour[tempSquare]==sideAttacking
-          && (g_currentPiece[tempSquare]==ROOK
-              || g_currentPiece[tempSquare]==QUEEN)) {
-        return true;                         // square under attack.
-      }
-      if (g_currentColour[tempSquare]!=NONE)
-        break;
-    }
-
-    // Test For Oponment's Bishops and Queens (Diagonal moves ).
-    MovePtr=g_diagonalMoves[square][dirIndex];
-    while ((tempSquare=(*(MovePtr++)))!=END_OF_LOOKUP){
-      if (g_currentColour[tempSquare]==sideAttacking
-          && (g_currentPiece[tempSquare]==BISHOP
-              || g_currentPiece[tempSquare]==QUEEN)) {
-        return true;                         // square under attack.
-      }
-      if (g_currentColour[tempSquare]!=NONE)
-        break;
-    }
-  }
+  // Test for Oponment's Pawn Captures (ie: where OUR pawn would capture from).
+  if (g_pawnAttacks[getOtherSide(sideAttacking)][square]&state.pieceBB[PAWN]&attackers)
+    return true;                             // square under attack.
 
   // Test For Oponment's Knights.
-  MovePtr=g_knightMoves[square];
-  while ((tempSquare=(*(MovePtr++)))!=END_OF_LOOKUP) {
-    if (g_currentPiece[tempSquare]==KNIGHT
-        && g_currentColour[tempSquare]==sideAttacking) {
-      return true;                         // square under attack.
-    }
-  }
-
-  // Test for Oponment's Pawn Captures.
-  // This now is corrected and works with the new board orientation.
-  if (sideAttacking==WHITE && square<=47) { //(BUG: 47 not 40!)
-    if (getFile(square)!=0 && g_currentPiece[square+7]==PAWN
-        && g_currentColour[square+7]==WHITE) {
-      return true;                         // square under attack.
-    }
-    if (getFile(square)!=7 && g_currentPiece[square+9]==PAWN
-        && g_currentColour[square+9]==WHITE) {
-      return true;                         // square under attack.
-    }
-  }
-  else if (sideAttacking==BLACK && square>=16) {
-    if (getFile(square)!=0 && g_currentPiece[square-9]==PAWN
-        && g_currentColour[square-9]==BLACK) {
-      return true;                         // square under attack.
-    }
-    if (getFile(square)!=7 && g_currentPiece[square-7]==PAWN
-        && g_currentColour[square-7]==BLACK) {
-      return true;                         // square under attack.
-    }
-  }
+  if (g_knightAttacks[square]&state.pieceBB[KNIGHT]&attackers)
+    return true;                             // square under attack.
 
   // Test For Oponment's King.
-  MovePtr=g_kingMoves[square];
-  while ((tempSquare=(*(MovePtr++)))!=END_OF_LOOKUP) {
-    if (g_currentPiece[tempSquare]==KING
-        && g_currentColour[tempSquare]==sideAttacking) {
-      return true;                         // square under attack.
-    }
-  }
+  if (g_kingAttacks[square]&state.pieceBB[KING]&attackers)
+    return true;                             // square under attack.
+
+  // Test For Oponment's Bishops and Queens (Diagonal moves).
+  if (bishopAttacks(square,occupied)&(state.pieceBB[BISHOP]|state.pieceBB[QUEEN])&attackers)
+    return true;                             // square under attack.
+
+  // Test For Oponment's Rooks and Queens (Straight moves).
+  if (rookAttacks(square,occupied)&(state.pieceBB[ROOK]|state.pieceBB[QUEEN])&attackers)
+    return true;                             // square under attack.
 
   // square not under attack.
   return false;
@@ -95,7 +46,7 @@ bool isAttacked(int square,int sideAttacking)
 
 // =============================================================================
 
-bool singleAttack(int targetSquare,int newEnemySquare)
+bool singleAttack(const Position &pos,int targetSquare,int newEnemySquare)
 { // Works like Attack(), but only tests if the enemy piece can attack the
   // designated square, rather than any enemy piece like in Attack().
   // NOTE: No need to check for enemy king checking us as this should of been
@@ -111,15 +62,15 @@ bool singleAttack(int targetSquare,int newEnemySquare)
 
   // Enemy Rooks or Queen? (Straight move).
   // NOTE: Castling move must use a proper Attack()!
-  if ((g_currentPiece[newEnemySquare]==ROOK
-       || g_currentPiece[newEnemySquare]==QUEEN)
+  if ((pos.currentPiece[newEnemySquare]==ROOK
+       || pos.currentPiece[newEnemySquare]==QUEEN)
       && lookupIndex>=0 && lookupIndex<=3) {
 
     // Test all the squares inbetween to see if we are unobstructed.
     MovePtr=g_straightMoves[targetSquare][lookupIndex];
     tempSquare=(*MovePtr);
     while (tempSquare!=newEnemySquare) {
-      if (g_currentColour[tempSquare]!=NONE)
+      if (pos.currentColour[tempSquare]!=NONE)
         return false;                         // Attack blocked.
       tempSquare=(*(++MovePtr));
     }
@@ -128,15 +79,15 @@ bool singleAttack(int targetSquare,int newEnemySquare)
   }
 
   // Enemy Bishop or Queen? (Diagonal move).
-  else if ((g_currentPiece[newEnemySquare]==BISHOP
-            || g_currentPiece[newEnemySquare]==QUEEN)
+  else if ((pos.currentPiece[newEnemySquare]==BISHOP
+            || pos.currentPiece[newEnemySquare]==QUEEN)
            && lookupIndex>=4) {
 
     // Test all the squares inbetween to see if we are unobstructed.
     MovePtr=g_diagonalMoves[targetSquare][lookupIndex-4];
     tempSquare=(*MovePtr);
     while (tempSquare!=newEnemySquare) {
-      if (g_currentColour[tempSquare]!=NONE)
+      if (pos.currentColour[tempSquare]!=NONE)
         return false;                         // Attack blocked.
       tempSquare=(*(++MovePtr));
     }
@@ -145,7 +96,7 @@ bool singleAttack(int targetSquare,int newEnemySquare)
   }
 
   // Enemy Knight? (Knight move).
-  else if (g_currentPiece[newEnemySquare]==KNIGHT) {
+  else if (pos.currentPiece[newEnemySquare]==KNIGHT) {
 
     // dirIndexust use the Knight attack lookup table.
     return g_knightAttackTable[targetSquare][newEnemySquare];
@@ -155,13 +106,13 @@ bool singleAttack(int targetSquare,int newEnemySquare)
   // Enemy Pawn? (Pawn move).
   // BUG: Enpassent move causes an extra diagonal to need checking and hence
   //      just use attack!.
-  else if (g_currentPiece[newEnemySquare]==PAWN) {
-    if (g_currentColour[newEnemySquare]==WHITE && targetSquare<=39
+  else if (pos.currentPiece[newEnemySquare]==PAWN) {
+    if (pos.currentColour[newEnemySquare]==WHITE && targetSquare<=39
         && (getRank(newEnemySquare)-1)==getRank(targetSquare)
         && labs(getFile(targetSquare)-getFile(newEnemySquare))==1) {
       return true;                         // square under attack.
     }
-    else if (g_currentColour[newEnemySquare]==BLACK && targetSquare>=24
+    else if (pos.currentColour[newEnemySquare]==BLACK && targetSquare>=24
              && (getRank(newEnemySquare)+1)==getRank(targetSquare)
              && labs(getFile(targetSquare)-getFile(newEnemySquare))==1) {
       return true;                         // square under attack.
@@ -175,7 +126,7 @@ bool singleAttack(int targetSquare,int newEnemySquare)
 
 // =============================================================================
 
-bool testExposure(int targetSquare,int evacuatedSquare,int sideAttacking)
+bool testExposure(const Position &pos,int targetSquare,int evacuatedSquare,int sideAttacking)
 { // This function tests if the targetSquare has been exposed to an attack
   // because of a piece (NOT KING!) moveing out of the line of your king.
 
@@ -196,12 +147,12 @@ bool testExposure(int targetSquare,int evacuatedSquare,int sideAttacking)
     // Test For Oponment's Rooks and Queens (Straight moves).
     MovePtr=g_straightMoves[targetSquare][lookupIndex];
     while ((tempSquare=(*(MovePtr++)))!=END_OF_LOOKUP){
-      if (g_currentColour[tempSquare]==sideAttacking
-          && (g_currentPiece[tempSquare]==ROOK
-              || g_currentPiece[tempSquare]==QUEEN)) {
+      if (pos.currentColour[tempSquare]==sideAttacking
+          && (pos.currentPiece[tempSquare]==ROOK
+              || pos.currentPiece[tempSquare]==QUEEN)) {
         return true;                         // square under attack.
       }
-      if (g_currentColour[tempSquare]!=NONE)
+      if (pos.currentColour[tempSquare]!=NONE)
         break;
     }
   }
@@ -212,12 +163,12 @@ bool testExposure(int targetSquare,int evacuatedSquare,int sideAttacking)
     // Test For Oponment's Bishops and Queens (Diagonal moves ).
     MovePtr=g_diagonalMoves[targetSquare][lookupIndex-4];
     while ((tempSquare=(*(MovePtr++)))!=END_OF_LOOKUP){
-      if (g_currentColour[tempSquare]==sideAttacking
-          && (g_currentPiece[tempSquare]==BISHOP
-              || g_currentPiece[tempSquare]==QUEEN)) {
+      if (pos.currentColour[tempSquare]==sideAttacking
+          && (pos.currentPiece[tempSquare]==BISHOP
+              || pos.currentPiece[tempSquare]==QUEEN)) {
         return true;                         // square under attack.
       }
-      if (g_currentColour[tempSquare]!=NONE)
+      if (pos.currentColour[tempSquare]!=NONE)
         break;
     }
 
@@ -230,4 +181,39 @@ bool testExposure(int targetSquare,int evacuatedSquare,int sideAttacking)
 
 // ============================================================================
 
-
+bool isLegal(const Position &pos,const MoveStruct &move)
+{ // Tests if a pseudo-legal move leaves our king in check, without making it
+  // (for the en passant and castle moves in genLegalMoves()). The board after
+  // the move is only needed as an occupancy: the captured piece is masked out
+  // of the attackers, and sliders see through the square we leave (and an
+  // en-passant pawn).
+
+  const GameState &state=*pos.currentState;
+  const int side=pos.currentSide;
+  const int otherSide=getOtherSide(side);
+
+  // Castling: The generator has checked we are not in check and the squares
+  // are empty, so just test the squares the king crosses and lands on.
+  if (move.type&CASTLE) {
+    const int crossed=(move.source+move.target)/2;
+    return !isAttacked(pos,crossed,otherSide) && !isAttacked(pos,move.target,otherSide);
+  }
+
+  Bitboard occupied=(state.colourBB[WHITE]|state.colourBB[BLACK]|squareBB(move.target))
+                    ^squareBB(move.source);
+  Bitboard enemies=state.colourBB[otherSide]&~squareBB(move.target);
+  if (move.type&EN_PASSANT) {
+    const int passed=(side==WHITE) ? move.target+8 : move.target-8;
+    occupied^=squareBB(passed);
+    enemies^=squareBB(passed);
+  }
+
+  const int kingSquare=(pos.currentPiece[move.source]==KING) ? move.target
+                                                            : state.kingSquare[side];
+  return (attackersTo(state,kingSquare,occupied)&enemies)==0;
+
+} // End isLegal.
+
+// ============================================================================
+
+
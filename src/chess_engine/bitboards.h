@@ -0,0 +1,141 @@
+// *****************************************************************************
+// *                              BITBOARD HELPERS                             *
+// *****************************************************************************
+// Inline helpers for the bitboards kept in each GameState (alongside the
+// mailbox colour[]/piece[] arrays). Sliding attacks use magic bitboards, or
+// the BMI2 PEXT instruction when the compiler targets it (-march=native does
+// on most recent x86 CPUs). Build with -DNO_PEXT to force the magic lookup
+// (PEXT is very slow on AMD CPUs before Zen 3).
+
+#pragma once
+
+#include <bit>
+#include "chess_engine.h"
+#include "globals.h"
+
+#if defined(__BMI2__) && !defined(NO_PEXT)
+#include <immintrin.h>
+constexpr bool PEXT_BITBOARDS = true;
+#else
+constexpr bool PEXT_BITBOARDS = false;
+#endif
+
+// =============================================================================
+// MASKS
+// =============================================================================
+
+constexpr Bitboard FILE_A_BB = 0x0101010101010101ULL;
+constexpr Bitboard FILE_H_BB = FILE_A_BB << 7;
+constexpr Bitboard RANK_8_BB = 0xFFULL;           // White promotes here.
+constexpr Bitboard RANK_6_BB = 0xFFULL << 16;     // Black's single pushes land here.
+constexpr Bitboard RANK_3_BB = 0xFFULL << 40;     // White's single pushes land here.
+constexpr Bitboard RANK_1_BB = 0xFFULL << 56;     // Black promotes here.
+constexpr Bitboard LIGHT_SQUARES_BB = 0xAA55AA55AA55AA55ULL;  // A8, C8, ..., H1.
+
+// =============================================================================
+// SQUARE SETS
+// =============================================================================
+
+[[nodiscard]] inline constexpr Bitboard squareBB(int square) noexcept {
+    return Bitboard(1) << square;
+}
+
+[[nodiscard]] inline int getFirstSquare(Bitboard bb) noexcept {
+    return std::countr_zero(bb);
+}
+
+// Returns the lowest square in the set and removes it.
+inline int popFirstSquare(Bitboard& bb) noexcept {
+    const int square = std::countr_zero(bb);
+    bb &= bb - 1;
+    return square;
+}
+
+[[nodiscard]] inline int countSquares(Bitboard bb) noexcept {
+    return std::popcount(bb);
+}
+
+// Adds/removes a piece from the bitboards (the mailbox is updated separately).
+inline void togglePiece(GameState& state, int side, int piece, int square) noexcept {
+    const Bitboard bb = squareBB(square);
+    state.pieceBB[piece] ^= bb;
+    state.colourBB[side] ^= bb;
+}
+
+// =============================================================================
+// MATERIAL
+// =============================================================================
+
+// One of a side's piece in a material signature (see MaterialKey).
+[[nodiscard]] inline constexpr MaterialKey materialKeyUnit(int side, int piece) noexcept {
+    return MaterialKey(1) << (4 * (6 * side + piece));
+}
+
+// The part of a signature holding one piece type, for both sides.
+[[nodiscard]] inline constexpr MaterialKey materialKeyMask(int piece) noexcept {
+    return (materialKeyUnit(WHITE, piece) | materialKeyUnit(BLACK, piece)) * 0xF;
+}
+
+// The number of a side's piece in a material signature.
+[[nodiscard]] inline constexpr int materialKeyCount(MaterialKey key, int side, int piece) noexcept {
+    return static_cast<int>((key >> (4 * (6 * side + piece))) & 0xF);
+}
+
+// Adds/removes a piece from the piece counts and material signature (the
+// captures and promotions in makeMove(), everything else is set up by
+// initBitboards()).
+inline void addPieceCount(GameState& state, int side, int piece) noexcept {
+    state.pieceCount[side][piece]++;
+    state.materialKey += materialKeyUnit(side, piece);
+}
+inline void removePieceCount(GameState& state, int side, int piece) noexcept {
+    state.pieceCount[side][piece]--;
+    state.materialKey -= materialKeyUnit(side, piece);
+}
+
+// =============================================================================
+// ATTACK LOOKUPS
+// =============================================================================
+
+[[nodiscard]] inline unsigned magicIndex(const MagicEntry& entry, Bitboard occupied) noexcept {
+#if defined(__BMI2__) && !defined(NO_PEXT)
+    return static_cast<unsigned>(_pext_u64(occupied, entry.mask));
+#else
+    return static_cast<unsigned>(((occupied & entry.mask) * entry.magic) >> entry.shift);
+#endif
+}
+
+[[nodiscard]] inline Bitboard bishopAttacks(int square, Bitboard occupied) noexcept {
+    const MagicEntry& entry = g_bishopMagics[square];
+    return entry.attacks[magicIndex(entry, occupied)];
+}
+
+[[nodiscard]] inline Bitboard rookAttacks(int square, Bitboard occupied) noexcept {
+    const MagicEntry& entry = g_rookMagics[square];
+    return entry.attacks[magicIndex(entry, occupied)];
+}
+
+// Attacks of a (non-pawn) piece standing on the square.
+[[nodiscard]] inline Bitboard pieceAttacks(int piece, int square, Bitboard occupied) noexcept {
+    switch (piece) {
+        case KNIGHT: return g_knightAttacks[square];
+        case BISHOP: return bishopAttacks(square, occupied);
+        case ROOK:   return rookAttacks(square, occupied);
+        case QUEEN:  return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+        default:     return g_kingAttacks[square];
+    }
+}
+
+// All pieces (of both sides) attacking the square, with the given occupancy.
+// NOTE: Sliders are looked up through 'occupied', so removing pieces from it
+//       uncovers the x-ray attackers behind them (used by the SEE).
+[[nodiscard]] inline Bitboard attackersTo(const GameState& state, int square, Bitboard occupied) noexcept {
+    const Bitboard diagonalSliders = state.pieceBB[BISHOP] | state.pieceBB[QUEEN];
+    const Bitboard straightSliders = state.pieceBB[ROOK] | state.pieceBB[QUEEN];
+    return (g_pawnAttacks[BLACK][square] & state.pieceBB[PAWN] & state.colourBB[WHITE])
+         | (g_pawnAttacks[WHITE][square] & state.pieceBB[PAWN] & state.colourBB[BLACK])
+         | (g_knightAttacks[square] & state.pieceBB[KNIGHT])
+         | (g_kingAttacks[square] & state.pieceBB[KING])
+         | (bishopAttacks(square, occupied) & diagonalSliders)
+         | (rookAttacks(square, occupied) & straightSliders);
+}
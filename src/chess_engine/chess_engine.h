@@ -14,10 +14,12 @@
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <string>
 
 // Shared types and constants
 #include "types.h"
 #include "constants.h"
+#include "position.h"
 
 // =============================================================================
 // CORE LIBRARIES
@@ -104,37 +106,66 @@ enum Square : int {
     return (static_cast<int>('8' - rank) * 8) + static_cast<int>(file - 'a');
 }
 
+// Put the current position's key in pos.repetitionKeys (the repetition tests
+// then scan just the keys, and not the GameStates).
+inline void storeRepetitionKey(Position& pos) noexcept {
+    pos.repetitionKeys[pos.moveNum] = pos.currentState->key;
+}
+
+// Did the move before last (ie: our last one) change this square? Used to
+// score captures on it higher, as that's where the exchange is going on.
+// NOTE: Needs pos.moveNum>1.
+[[nodiscard]] inline bool ourLastMoveChanged(const Position& pos, int square) noexcept {
+    const MoveStruct& move = pos.movesMade[pos.moveNum - 2];
+    if (square == move.source || square == move.target)
+        return true;
+    if (move.type & EN_PASSANT)                     // The pawn taken.
+        return square == ((move.source & ~7) | (move.target & 7));
+    if (move.type & CASTLE)                         // The rook's squares.
+        return (move.target & 7) == 6 ? (square == move.target + 1 || square == move.target - 1)
+                                      : (square == move.target - 2 || square == move.target + 1);
+    return false;
+}
+
 // =============================================================================
 // FUNCTION PROTOTYPES
 // =============================================================================
 
 // Game history functions
-void initAll();
-bool makeMove(MoveStruct& moveToMake);
-void takeMoveBack();
+void initAll(Position& pos);
+bool setupFromFEN(Position& pos, const std::string& fen);
+bool makeMove(Position& pos, MoveStruct& moveToMake);
+void takeMoveBack(Position& pos);
+bool makeMoveInPlace(Position& pos, MoveStruct& moveToMake);
+void unmakeMove(Position& pos);
+void initBitboards(GameState& state);
 
 // Attack testing functions
-[[nodiscard]] bool isAttacked(int square, int sideAttacking);
-bool singleAttack(int targetSquare, int newEnemySquare);
-bool testExposure(int targetSquare, int evacuatedSquare, int sideAttacking);
+[[nodiscard]] bool isAttacked(const Position& pos, int square, int sideAttacking);
+bool singleAttack(const Position& pos, int targetSquare, int newEnemySquare);
+bool testExposure(const Position& pos, int targetSquare, int evacuatedSquare, int sideAttacking);
+[[nodiscard]] bool isLegal(const Position& pos, const MoveStruct& move);  // Pseudo-legal moves only.
 
 // Draw testing functions
-[[nodiscard]] bool testRepetition();
-bool testSingleRepetition(int minMoveNum);
-[[nodiscard]] bool testNotEnoughMaterial();
+[[nodiscard]] bool testRepetition(const Position& pos);
+bool testSingleRepetition(const Position& pos, int minMoveNum);
+[[nodiscard]] bool testNotEnoughMaterial(const Position& pos);
 
 // Move generation functions
-void genLegalMoves(MoveList& moves);
-void genMoves(MoveList& moves);
-void genCaptures(MoveList& moves);
-void genPush(MoveList& Moves, int source, int target, int type);
+void genLegalMoves(const Position& pos, MoveList& moves);
+void genMoves(const Position& pos, MoveList& moves);
+void genCaptures(const Position& pos, MoveList& moves);
+void genQuiets(const Position& pos, MoveList& moves);      // Adds to the list.
+[[nodiscard]] bool isPseudoLegal(const Position& pos, const MoveStruct& move);
+void genPush(const Position& pos, MoveList& Moves, int source, int target, int type);
 
 // Lookup table generation functions
 void generateMoveTables();
 void generateExposedAttackTable();
-void initPosData();
+void generateBitboardTables();
 
 // Hash key functions
 void initHashCodes();
-[[nodiscard]] HashKey currentKey();
+[[nodiscard]] HashKey currentKey(const Position& pos);
+[[nodiscard]] HashKey currentPawnKey(const Position& pos);
 
@@ -4,12 +4,14 @@
 
 #include "chess_engine.h"
 #include "globals.h"
+#include "bitboards.h"
 
+#include <algorithm>
 #include <array>
 
 // ============================================================================
 
-bool testRepetition(void)
+bool testRepetition(const Position &pos)
 { // Returns true if we have repeaded the same position 3 times.
   // start_again2: Have now speeded this up loads by doing (in order of speed!):
   //               1: Using FiftyCounter being greater than 8 (not movenum!).
@@ -25,41 +27,27 @@ bool testRepetition(void)
   //               This makes very little difference as already very fast here!
   // start_again8: Now uses the hash key only to search (is this safe?).
   // clean_up14: Now uses proper hash key (with castle permisions etc).
+  // NOTE: The keys are copied into pos.repetitionKeys once per move.
 
   int numSame;                 // If gets to 3, then draw due to repetition.
 
-  // These are used to make the true key, using Side/Castle permision etc.
-  HashKey currentKey;
-  HashKey oldKey;
-
-  // Get the current key.
-  currentKey=g_currentState->key;
-
-  // Add the castle permisions and the en-passent info etc.
-  currentKey^=g_castleHashCode[g_currentState->castlePerm];
-  if (g_currentState->enPass!=NO_EN_PASSANT)
-    currentKey^=g_enPassantHashCode[g_currentState->enPass];
-
   // Check the position history, to see if we have had the same position
   // three time. (Only check >=8 as these are possible onwards).
-  if (g_currentState->fiftyCounter>=8) {
+  // NOTE: A position set up from a FEN can have a fifty move counter that
+  //       goes back further than the history we have, so stop at state 0.
+  if (pos.currentState->fiftyCounter>=8) {
+
+    const HashKey currentKey=pos.repetitionKeys[pos.moveNum];
+    const int firstMoveNum=std::max(pos.moveNum-pos.currentState->fiftyCounter,0);
 
     // None the same yet.
     numSame=0;
 
     // Test with all previously stored moves (with the same player to move).
-    for (int i=g_moveNum-4;(g_currentState->fiftyCounter-(g_moveNum-i))>=0;i-=2) {
-
-      // Get the old (stored) key.
-      oldKey=g_gameHistory[i].key;
-
-      // Add the castle permisions and the en-passent info etc.
-      oldKey^=g_castleHashCode[g_gameHistory[i].castlePerm];
-      if (g_gameHistory[i].enPass!=NO_EN_PASSANT)
-        oldKey^=g_enPassantHashCode[g_gameHistory[i].enPass];
+    for (int i=pos.moveNum-4;i>=firstMoveNum;i-=2) {
 
       // See if the same (ie: Same position!).
-      if (currentKey==oldKey) {
+      if (pos.repetitionKeys[i]==currentKey) {
         numSame++;                     // One more same.
 
         // Check if We have two the same, if so 3 identilcle have been seen.
@@ -78,7 +66,7 @@ bool testRepetition(void)
 
 // =========================================================================
 
-bool testSingleRepetition(int minMoveNum)
+bool testSingleRepetition(const Position &pos,int minMoveNum)
 { // Returns true if we have repeaded the same position one before.
   // NOTE: Not for draws, but for spotting hash cycles when printing the PV
   //       from the hash. 
@@ -86,15 +74,15 @@ bool testSingleRepetition(int minMoveNum)
 
   // Check the position history, to see if we have had the same position
   // before. (Only check >=4 as these are possible onwards).
-  if (g_currentState->fiftyCounter>=4) {
+  if (pos.currentState->fiftyCounter>=4) {
 
     // Test with all previously stored moves.
-    for (int i=g_moveNum-4;(g_currentState->fiftyCounter-(g_moveNum-i))>=0
-                         && i>minMoveNum;i-=4) {
+    for (int i=pos.moveNum-4;(pos.currentState->fiftyCounter-(pos.moveNum-i))>=0
+                         && i>minMoveNum && i>=0;i-=4) {
 
       // If state not made by the null move, compare it.
-      //if (g_gameHistory[i].NullMove==false) {
-        if (g_gameHistory[i].key==g_currentState->key) {
+      //if (pos.gameHistory[i].NullMove==false) {
+        if (pos.repetitionKeys[i]==pos.currentState->key) {
             return true;          // Same found.
         }
       //}
@@ -110,7 +98,7 @@ bool testSingleRepetition(int minMoveNum)
 
 // ==========================================================================
 
-bool testNotEnoughMaterial(void)
+bool testNotEnoughMaterial(const Position &pos)
 { // This function detects a draw due to not having enough material to win.
   // - King vs King.
   // - King vs King and Knight.
@@ -126,23 +114,20 @@ bool testNotEnoughMaterial(void)
   // - King and two Knights vs King and Bishop.
   // - King and two Knights vs King and two Knights.
 
-  std::array<int, 2> numBishops = {0, 0};  // For each side.
-  std::array<int, 2> numKnights = {0, 0};  // For each side.
+  // NOTE: Just looks at the (incremental) material signature and counts.
 
-  // Scan through the pieces on the board, testing if any are pawns or major
-  // pieces - in which case stop.
-  for (int i=0;i<BOARD_SQUARES;i++) {
-    if (g_currentPiece[i]==PAWN
-        || g_currentPiece[i]==ROOK
-        || g_currentPiece[i]==QUEEN) {
-      return false;                     // Not an Material Draw.
-    }
+  const GameState &state=*pos.currentState;
+  std::array<int, 2> numBishops;           // For each side.
+  std::array<int, 2> numKnights;           // For each side.
+
+  // If there are any pawns or major pieces on the board then stop.
+  if (state.materialKey&(materialKeyMask(PAWN)|materialKeyMask(ROOK)|materialKeyMask(QUEEN)))
+    return false;                         // Not an Material Draw.
 
-    // count up each sides minor peices.
-    if (g_currentPiece[i]==BISHOP)
-      numBishops[g_currentColour[i]]++;
-    else if (g_currentPiece[i]==KNIGHT)
-      numKnights[g_currentColour[i]]++;
+  // count up each sides minor peices.
+  for (int side=WHITE;side<=BLACK;side++) {
+    numBishops[side]=state.pieceCount[side][BISHOP];
+    numKnights[side]=state.pieceCount[side][KNIGHT];
   }
 
   // Test to see if any of the draw situations have been reached.
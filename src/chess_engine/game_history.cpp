@@ -4,7 +4,12 @@
 
 #include "chess_engine.h"
 #include "globals.h"
+#include "bitboards.h"
+#include <algorithm>
+#include <cctype>
 #include <mutex>
+#include <sstream>
+#include <string>
 
 // ==========================================================================
 // Internal function to initialize lookup tables - called once via std::call_once
@@ -15,14 +20,14 @@ static void CreateLookupTables(void) {
   // Generate the exposed attack table.
   generateExposedAttackTable();        // MUST BE DONE AFTER MOVE TABLES.
 
-  // Generate the g_posData tables.
-  initPosData();
+  // Generate the bitboard attack tables.
+  generateBitboardTables();            // MUST BE DONE AFTER MOVE TABLES.
 
   // Init the hash codes.
   initHashCodes();
 } // End CreateLookupTables.
 
-void initAll(void)
+void initAll(Position &pos)
 { // Sets the board to the initial game state (Starts new game).
 
   // Thread-safe one-time initialization of lookup tables.
@@ -30,74 +35,199 @@ void initAll(void)
   std::call_once(lookupInitFlag, CreateLookupTables);
 
   // Set up the pieces for each square:
-  g_gameHistory[0].piece[0]=ROOK;        // Black Left Rook.
-  g_gameHistory[0].piece[1]=KNIGHT;      // Black Left Knight.
-  g_gameHistory[0].piece[2]=BISHOP;      // Black Left Bishop.
-  g_gameHistory[0].piece[3]=QUEEN;       // Black Queen.
-  g_gameHistory[0].piece[4]=KING;        // Black King.
-  g_gameHistory[0].piece[5]=BISHOP;      // Black Right Bishop.
-  g_gameHistory[0].piece[6]=KNIGHT;      // Black Right Knight.
-  g_gameHistory[0].piece[7]=ROOK;        // Black Right Rook.
+  pos.gameHistory[0].piece[0]=ROOK;        // Black Left Rook.
+  pos.gameHistory[0].piece[1]=KNIGHT;      // Black Left Knight.
+  pos.gameHistory[0].piece[2]=BISHOP;      // Black Left Bishop.
+  pos.gameHistory[0].piece[3]=QUEEN;       // Black Queen.
+  pos.gameHistory[0].piece[4]=KING;        // Black King.
+  pos.gameHistory[0].piece[5]=BISHOP;      // Black Right Bishop.
+  pos.gameHistory[0].piece[6]=KNIGHT;      // Black Right Knight.
+  pos.gameHistory[0].piece[7]=ROOK;        // Black Right Rook.
   for (int i=8;i<16;i++)
-    g_gameHistory[0].piece[i]=PAWN;      // Black Pawns.
+    pos.gameHistory[0].piece[i]=PAWN;      // Black Pawns.
   for (int i=16;i<48;i++)
-    g_gameHistory[0].piece[i]=NONE;      // Empty Squares.
+    pos.gameHistory[0].piece[i]=NONE;      // Empty Squares.
   for (int i=48;i<56;i++)
-    g_gameHistory[0].piece[i]=PAWN;      // White Pawns.
-  g_gameHistory[0].piece[56]=ROOK;       // White Left Rook.
-  g_gameHistory[0].piece[57]=KNIGHT;     // White Left Knight.
-  g_gameHistory[0].piece[58]=BISHOP;     // White Left Bishop.
-  g_gameHistory[0].piece[59]=QUEEN;      // White Queen.
-  g_gameHistory[0].piece[60]=KING;       // White King.
-  g_gameHistory[0].piece[61]=BISHOP;     // White Right Bishop.
-  g_gameHistory[0].piece[62]=KNIGHT;     // White Right Knight.
-  g_gameHistory[0].piece[63]=ROOK;       // White Right Rook.
+    pos.gameHistory[0].piece[i]=PAWN;      // White Pawns.
+  pos.gameHistory[0].piece[56]=ROOK;       // White Left Rook.
+  pos.gameHistory[0].piece[57]=KNIGHT;     // White Left Knight.
+  pos.gameHistory[0].piece[58]=BISHOP;     // White Left Bishop.
+  pos.gameHistory[0].piece[59]=QUEEN;      // White Queen.
+  pos.gameHistory[0].piece[60]=KING;       // White King.
+  pos.gameHistory[0].piece[61]=BISHOP;     // White Right Bishop.
+  pos.gameHistory[0].piece[62]=KNIGHT;     // White Right Knight.
+  pos.gameHistory[0].piece[63]=ROOK;       // White Right Rook.
 
   // Set up the Owner of each square.
   for (int i=0;i<16;i++)
-    g_gameHistory[0].colour[i]=BLACK;    // Black's Pieces.
+    pos.gameHistory[0].colour[i]=BLACK;    // Black's Pieces.
   for (int i=16;i<48;i++)
-    g_gameHistory[0].colour[i]=NONE;     // Empty Squares.
+    pos.gameHistory[0].colour[i]=NONE;     // Empty Squares.
   for (int i=48;i<64;i++)
-    g_gameHistory[0].colour[i]=WHITE;    // White's Pieces.
+    pos.gameHistory[0].colour[i]=WHITE;    // White's Pieces.
 
   // Reset the other variables to a new game.
-  g_gameHistory[0].castlePerm=15;        // All can castle.
-  g_gameHistory[0].enPass=NO_EN_PASSANT; // En-Pasent is NOT allowed yet.
-  g_gameHistory[0].fiftyCounter=0;       // Reset the first-move-rule counter.
-  g_gameHistory[0].kingSquare[WHITE]=60; // Set to start position.
-  g_gameHistory[0].kingSquare[BLACK]=4;  // Set to start position.
+  pos.gameHistory[0].castlePerm=15;        // All can castle.
+  pos.gameHistory[0].enPass=NO_EN_PASSANT; // En-Pasent is NOT allowed yet.
+  pos.gameHistory[0].fiftyCounter=0;       // Reset the first-move-rule counter.
+  pos.gameHistory[0].kingSquare[WHITE]=60; // Set to start position.
+  pos.gameHistory[0].kingSquare[BLACK]=4;  // Set to start position.
 
   // Set up the side to play to be WHITE.
-  g_currentSide=WHITE;                   // side is the side to play next.
+  pos.currentSide=WHITE;                   // side is the side to play next.
 
   // Start on move 0.
-  g_moveNum=0;                           // Now on move 0.
+  pos.moveNum=0;                           // Now on move 0.
 
   // Flag the fact that we are NOT in check at the start of the game.
-  g_gameHistory[0].inCheck=false;
+  pos.gameHistory[0].inCheck=false;
 
   // Can't be a draw on the first move.
-  g_gameHistory[0].isDraw=false;
+  pos.gameHistory[0].isDraw=false;
 
   // Set the pointer to the first state.
-  g_currentState=&g_gameHistory[0];
+  pos.currentState=&pos.gameHistory[0];
 
   // Set up the pointer to the current board.
-  g_currentColour=g_currentState->colour;
-  g_currentPiece=g_currentState->piece;
+  pos.currentColour=pos.currentState->colour;
+  pos.currentPiece=pos.currentState->piece;
+
+  // Build the bitboards from the board (updated on the fly after this).
+  initBitboards(pos.gameHistory[0]);
 
   // Init the 64bit Hash Key for this (starting) state.
   // Update on the fly the rest of the time.
-  g_gameHistory[0].key=currentKey();
+  pos.gameHistory[0].key=currentKey(pos);
+  pos.gameHistory[0].pawnKey=currentPawnKey(pos);
+  storeRepetitionKey(pos);
 
 } // End initAll.
 
 // =============================================================================
 
-bool makeMove(MoveStruct &moveToMake)
+bool setupFromFEN(Position &pos,const std::string &fen)
+{ // Sets the board up from a FEN string (as a new game, from move 0).
+  // Returns true if the FEN was invalid (the position is then left as it was).
+  // NOTE: The move counters are optional, as some GUIs leave them off.
+
+  std::istringstream fields(fen);
+  std::string board,side,castling="-",enPassant="-";
+  int fiftyCounter=0;
+
+  if (!(fields >> board >> side))
+    return true;                              // Need at least these two.
+  fields >> castling >> enPassant >> fiftyCounter;
+
+  // Build the new state in here, so a bad FEN doesn't trash the position.
+  GameState state=pos.gameHistory[0];
+  int numKings[2]={0,0};
+
+  // 1. The board, from a8 to h1 (which matches our square numbering).
+  int square=0;
+  for (char c : board) {
+    if (c=='/')
+      continue;
+    if (c>='1' && c<='8') {
+      for (int i=0;i<(c-'0') && square<BOARD_SQUARES;i++,square++) {
+        state.piece[square]=NONE;
+        state.colour[square]=NONE;
+      }
+      continue;
+    }
+    if (square>=BOARD_SQUARES)
+      return true;                            // Too many squares.
+    const int owner=std::isupper(static_cast<unsigned char>(c)) ? WHITE : BLACK;
+    switch (std::tolower(static_cast<unsigned char>(c))) {
+      case 'p': state.piece[square]=PAWN;   break;
+      case 'n': state.piece[square]=KNIGHT; break;
+      case 'b': state.piece[square]=BISHOP; break;
+      case 'r': state.piece[square]=ROOK;   break;
+      case 'q': state.piece[square]=QUEEN;  break;
+      case 'k': state.piece[square]=KING;
+                state.kingSquare[owner]=square;
+                numKings[owner]++;
+                break;
+      default:  return true;                  // Bad piece character.
+    }
+    state.colour[square++]=owner;
+  }
+  if (square!=BOARD_SQUARES || numKings[WHITE]!=1 || numKings[BLACK]!=1)
+    return true;
+
+  // 2. The side to move.
+  if (side!="w" && side!="b")
+    return true;
+
+  // 3. Castling (only if the king and rook are really there).
+  state.castlePerm=0;
+  for (char c : castling) {
+    if (c=='K' && state.piece[63]==ROOK && state.colour[63]==WHITE)
+      state.castlePerm|=WHITE_KING_SIDE;
+    else if (c=='Q' && state.piece[56]==ROOK && state.colour[56]==WHITE)
+      state.castlePerm|=WHITE_QUEEN_SIDE;
+    else if (c=='k' && state.piece[7]==ROOK && state.colour[7]==BLACK)
+      state.castlePerm|=BLACK_KING_SIDE;
+    else if (c=='q' && state.piece[0]==ROOK && state.colour[0]==BLACK)
+      state.castlePerm|=BLACK_QUEEN_SIDE;
+  }
+  if (state.kingSquare[WHITE]!=60)
+    state.castlePerm&=~(WHITE_KING_SIDE|WHITE_QUEEN_SIDE);
+  if (state.kingSquare[BLACK]!=4)
+    state.castlePerm&=~(BLACK_KING_SIDE|BLACK_QUEEN_SIDE);
+
+  // 4. The en-passant (target) square.
+  state.enPass=NO_EN_PASSANT;
+  if (enPassant.size()==2 && enPassant[0]>='a' && enPassant[0]<='h'
+      && (enPassant[1]=='3' || enPassant[1]=='6'))
+    state.enPass=getSquare(enPassant[0],enPassant[1]);
+
+  // 5. The fifty move counter.
+  state.fiftyCounter=std::max(0,fiftyCounter);
+  state.isDraw=false;
+
+  // All OK, so set the position up from the new state.
+  pos.gameHistory[0]=state;
+  pos.currentSide=(side=="w") ? WHITE : BLACK;
+  pos.setMoveNum(0);
+  initBitboards(pos.gameHistory[0]);
+  pos.gameHistory[0].inCheck=isAttacked(pos,pos.gameHistory[0].kingSquare[pos.currentSide],
+                                        getOtherSide(pos.currentSide));
+  pos.gameHistory[0].key=currentKey(pos);
+  pos.gameHistory[0].pawnKey=currentPawnKey(pos);
+  storeRepetitionKey(pos);
+  return false;
+
+} // End setupFromFEN.
+
+// =============================================================================
+
+void initBitboards(GameState &state)
+{ // Builds the bitboards, piece counts and material signature from the
+  // colour/piece arrays.
+  // Only use for loading ect, updated on the fly in makeMove.
+
+  state.pieceBB.fill(0);
+  state.colourBB.fill(0);
+  state.pieceCount={};
+  state.materialKey=0;
+
+  for (int i=0;i<BOARD_SQUARES;i++) {
+    if (state.colour[i]!=NONE) {
+      togglePiece(state,state.colour[i],state.piece[i],i);
+      addPieceCount(state,state.colour[i],state.piece[i]);
+    }
+  }
+
+} // End initBitboards.
+
+// =============================================================================
+
+template <bool InPlace>
+static bool doMakeMove(Position &pos,MoveStruct &moveToMake)
 { // This function makes a move. If the move is illegal, it undoes whatever
   // it did and returns false. Otherwise, it returns true.
+  // NOTE: If InPlace, the current state is changed in place (see
+  //       makeMoveInPlace()), else it is copied to the next one first.
 
   // This is -1 if no extra exposed square to check for putting oponent in
   // check. This is only when we castle (ie. to the rooks square) or when we
@@ -105,127 +235,149 @@ bool makeMove(MoveStruct &moveToMake)
   // a check to you).
   int extraExposedSquare=-1;
 
-  // Save the game state on the g_gameHistory.
-  // This is used for both rep check and for user take-back of move.
-  // BUG: This was in the wrong place before and catles had rook moved
-  //      priror to the state being saved!
-  *(g_currentState+1) = *g_currentState;
-
-  // This points to the current state (for speed) - NOTE: +1 now!.
-  g_currentState++;
+  // Can't castle across or onto an attacked square (tested before anything
+  // is changed, so there's nothing to undo).
+  if (moveToMake.type&CASTLE) {
+    if (isAttacked(pos,(moveToMake.source+moveToMake.target)/2,getOtherSide(pos.currentSide))
+        || isAttacked(pos,moveToMake.target,getOtherSide(pos.currentSide)))
+      return false;
+  }
 
-  // Set up the pointer to the current board.
-  g_currentColour=g_currentState->colour;
-  g_currentPiece=g_currentState->piece;
+  // Save what the move loses (for unmakeMove(), and so the piece taken can
+  // be looked up after the move is made), and the move itself.
+  UndoRecord &undo=pos.undoHistory[pos.moveNum];
+  undo.key=pos.currentState->key;
+  undo.pawnKey=pos.currentState->pawnKey;
+  undo.fiftyCounter=pos.currentState->fiftyCounter;
+  undo.castlePerm=pos.currentState->castlePerm;
+  undo.enPass=pos.currentState->enPass;
+  undo.captured=(moveToMake.type&EN_PASSANT) ? PAWN
+                : (moveToMake.type&CAPTURE) ? pos.currentPiece[moveToMake.target] : NONE;
+  undo.inCheck=pos.currentState->inCheck;
+  undo.isDraw=pos.currentState->isDraw;
+  pos.movesMade[pos.moveNum]=moveToMake;
+
+  if constexpr (!InPlace) {
+
+    // Save the game state on the pos.gameHistory.
+    // This is used for both rep check and for user take-back of move.
+    // BUG: This was in the wrong place before and catles had rook moved
+    //      priror to the state being saved!
+    *(pos.currentState+1) = *pos.currentState;
+
+    // This points to the current state (for speed) - NOTE: +1 now!.
+    pos.currentState++;
+
+    // Set up the pointer to the current board.
+    pos.currentColour=pos.currentState->colour;
+    pos.currentPiece=pos.currentState->piece;
+  }
 
-  // First test to see if a castle move is legal and move the rook (the king
-  // is moved with the usual move code later).
+  // If castling, move the rook (the king is moved with the usual move code
+  // later).
   if (moveToMake.type&CASTLE) {
     if (moveToMake.target==62) {
-      if (isAttacked(61,getOtherSide(g_currentSide)) || isAttacked(62,getOtherSide(g_currentSide))) {
-        g_currentState--;
-        g_currentColour=g_currentState->colour;
-        g_currentPiece=g_currentState->piece;
-        return false;
-      }
-      g_currentColour[61]=WHITE;
-      g_currentPiece[61]=ROOK;
-      g_currentColour[63]=NONE;
-      g_currentPiece[63]=NONE;
+      pos.currentColour[61]=WHITE;
+      pos.currentPiece[61]=ROOK;
+      pos.currentColour[63]=NONE;
+      pos.currentPiece[63]=NONE;
       extraExposedSquare=61;
-      g_currentState->key^=g_hashCode[WHITE][ROOK][63];
-      g_currentState->key^=g_hashCode[WHITE][ROOK][61];
+      pos.currentState->key^=g_hashCode[WHITE][ROOK][63];
+      togglePiece(*pos.currentState,WHITE,ROOK,63);
+      pos.currentState->key^=g_hashCode[WHITE][ROOK][61];
+      togglePiece(*pos.currentState,WHITE,ROOK,61);
     }
     else if (moveToMake.target==58) {
-      if (isAttacked(58,getOtherSide(g_currentSide)) || isAttacked(59,getOtherSide(g_currentSide))) {
-        g_currentState--;
-        g_currentColour=g_currentState->colour;
-        g_currentPiece=g_currentState->piece;
-        return false;
-      }
-      g_currentColour[59]=WHITE;
-      g_currentPiece[59]=ROOK;
-      g_currentColour[56]=NONE;
-      g_currentPiece[56]=NONE;
+      pos.currentColour[59]=WHITE;
+      pos.currentPiece[59]=ROOK;
+      pos.currentColour[56]=NONE;
+      pos.currentPiece[56]=NONE;
       extraExposedSquare=59;
-      g_currentState->key^=g_hashCode[WHITE][ROOK][56];
-      g_currentState->key^=g_hashCode[WHITE][ROOK][59];
+      pos.currentState->key^=g_hashCode[WHITE][ROOK][56];
+      togglePiece(*pos.currentState,WHITE,ROOK,56);
+      pos.currentState->key^=g_hashCode[WHITE][ROOK][59];
+      togglePiece(*pos.currentState,WHITE,ROOK,59);
     }
     else if (moveToMake.target==6) {
-      if (isAttacked(5,getOtherSide(g_currentSide)) || isAttacked(6,getOtherSide(g_currentSide))) {
-        g_currentState--;
-        g_currentColour=g_currentState->colour;
-        g_currentPiece=g_currentState->piece;
-        return false;
-      }
-      g_currentColour[5]=BLACK;
-      g_currentPiece[5]=ROOK;
-      g_currentColour[7]=NONE;
-      g_currentPiece[7]=NONE;
+      pos.currentColour[5]=BLACK;
+      pos.currentPiece[5]=ROOK;
+      pos.currentColour[7]=NONE;
+      pos.currentPiece[7]=NONE;
       extraExposedSquare=5;
-      g_currentState->key^=g_hashCode[BLACK][ROOK][7];
-      g_currentState->key^=g_hashCode[BLACK][ROOK][5];
+      pos.currentState->key^=g_hashCode[BLACK][ROOK][7];
+      togglePiece(*pos.currentState,BLACK,ROOK,7);
+      pos.currentState->key^=g_hashCode[BLACK][ROOK][5];
+      togglePiece(*pos.currentState,BLACK,ROOK,5);
     }
     else if (moveToMake.target==2) {
-      if (isAttacked(2,getOtherSide(g_currentSide)) || isAttacked(3,getOtherSide(g_currentSide))) {
-        g_currentState--;
-        g_currentColour=g_currentState->colour;
-        g_currentPiece=g_currentState->piece;
-        return false;
-      }
-      g_currentColour[3]=BLACK;
-      g_currentPiece[3]=ROOK;
-      g_currentColour[0]=NONE;
-      g_currentPiece[0]=NONE;
+      pos.currentColour[3]=BLACK;
+      pos.currentPiece[3]=ROOK;
+      pos.currentColour[0]=NONE;
+      pos.currentPiece[0]=NONE;
       extraExposedSquare=3;
-      g_currentState->key^=g_hashCode[BLACK][ROOK][0];
-      g_currentState->key^=g_hashCode[BLACK][ROOK][3];
+      pos.currentState->key^=g_hashCode[BLACK][ROOK][0];
+      togglePiece(*pos.currentState,BLACK,ROOK,0);
+      pos.currentState->key^=g_hashCode[BLACK][ROOK][3];
+      togglePiece(*pos.currentState,BLACK,ROOK,3);
     }
 
   }
 
   // Alter the King's Square if needed.
-  if (moveToMake.source==g_currentState->kingSquare[g_currentSide])
-    g_currentState->kingSquare[g_currentSide]=moveToMake.target;
+  if (moveToMake.source==pos.currentState->kingSquare[pos.currentSide])
+    pos.currentState->kingSquare[pos.currentSide]=moveToMake.target;
+
+  // Take the old castling and en passant codes out of the key (the new ones
+  // are put back in below).
+  pos.currentState->key^=g_castleHashCode[pos.currentState->castlePerm];
+  if (pos.currentState->enPass!=NO_EN_PASSANT)
+    pos.currentState->key^=g_enPassantHashCode[pos.currentState->enPass];
 
   // Update the castleing permisions. (Note: Targets must be used also!)
+  // BUG: This was one else-if chain, so a rook capturing a rook (eg: h1xh8)
+  //      only cleared the permission of the captured one!
   if (moveToMake.source==60) {
-    g_currentState->castlePerm&=~(WHITE_KING_SIDE|WHITE_QUEEN_SIDE);
+    pos.currentState->castlePerm&=~(WHITE_KING_SIDE|WHITE_QUEEN_SIDE);
   }
   else if (moveToMake.source==4) {
-    g_currentState->castlePerm&=~(BLACK_KING_SIDE|BLACK_QUEEN_SIDE);
+    pos.currentState->castlePerm&=~(BLACK_KING_SIDE|BLACK_QUEEN_SIDE);
   }
-  else if (moveToMake.source==0 || moveToMake.target==0) {
-    g_currentState->castlePerm&=~BLACK_QUEEN_SIDE;
+  if (moveToMake.source==0 || moveToMake.target==0) {
+    pos.currentState->castlePerm&=~BLACK_QUEEN_SIDE;
   }
-  else if (moveToMake.source==7 || moveToMake.target==7) {
-    g_currentState->castlePerm&=~BLACK_KING_SIDE;
+  if (moveToMake.source==7 || moveToMake.target==7) {
+    pos.currentState->castlePerm&=~BLACK_KING_SIDE;
   }
-  else if (moveToMake.source==56 || moveToMake.target==56) {
-    g_currentState->castlePerm&=~WHITE_QUEEN_SIDE;
+  if (moveToMake.source==56 || moveToMake.target==56) {
+    pos.currentState->castlePerm&=~WHITE_QUEEN_SIDE;
   }
-  else if (moveToMake.source==63 || moveToMake.target==63) {
-    g_currentState->castlePerm&=~WHITE_KING_SIDE;
+  if (moveToMake.source==63 || moveToMake.target==63) {
+    pos.currentState->castlePerm&=~WHITE_KING_SIDE;
   }
 
   // Update en passant info.
   if (moveToMake.type&TWO_SQUARES) {
-    if (g_currentSide==WHITE) {
-      g_currentState->enPass=moveToMake.target+8;
+    if (pos.currentSide==WHITE) {
+      pos.currentState->enPass=moveToMake.target+8;
     }
     else {
-      g_currentState->enPass=moveToMake.target-8;
+      pos.currentState->enPass=moveToMake.target-8;
     }
   }
   else {
-    g_currentState->enPass=NO_EN_PASSANT;
+    pos.currentState->enPass=NO_EN_PASSANT;
   }
 
+  // Put the new castling and en passant codes in the key.
+  pos.currentState->key^=g_castleHashCode[pos.currentState->castlePerm];
+  if (pos.currentState->enPass!=NO_EN_PASSANT)
+    pos.currentState->key^=g_enPassantHashCode[pos.currentState->enPass];
+
   // Update the fifty-move-draw counter.
   if (moveToMake.type&(PAWN_MOVE|CAPTURE))
-    g_currentState->fiftyCounter=0;
+    pos.currentState->fiftyCounter=0;
   else
-    g_currentState->fiftyCounter++;
+    pos.currentState->fiftyCounter++;
 
   // Alter the Peice or pawn material scores, if a capture.
   // MEGA FAT BUG THAT REALY PISSED ME OFF:
@@ -233,55 +385,82 @@ bool makeMove(MoveStruct &moveToMake)
   // The cause of the phantom queen/knight sacrifice when playing gnu chess!
   if (moveToMake.type&CAPTURE) {
     if (moveToMake.type&EN_PASSANT) {
-      if (g_currentSide==WHITE) {
-        g_currentColour[moveToMake.target+8]=NONE;
-        g_currentPiece[moveToMake.target+8]=NONE;
+      if (pos.currentSide==WHITE) {
+        pos.currentColour[moveToMake.target+8]=NONE;
+        pos.currentPiece[moveToMake.target+8]=NONE;
         extraExposedSquare=moveToMake.target+8;
-        g_currentState->key^=g_hashCode[getOtherSide(g_currentSide)][PAWN][moveToMake.target+8];
+        pos.currentState->key^=g_hashCode[getOtherSide(pos.currentSide)][PAWN][moveToMake.target+8];
+        pos.currentState->pawnKey^=g_hashCode[getOtherSide(pos.currentSide)][PAWN][moveToMake.target+8];
+        togglePiece(*pos.currentState,getOtherSide(pos.currentSide),PAWN,moveToMake.target+8);
+        removePieceCount(*pos.currentState,getOtherSide(pos.currentSide),PAWN);
       }
       else {
-        g_currentColour[moveToMake.target-8]=NONE;
-        g_currentPiece[moveToMake.target-8]=NONE;
+        pos.currentColour[moveToMake.target-8]=NONE;
+        pos.currentPiece[moveToMake.target-8]=NONE;
         extraExposedSquare=moveToMake.target-8;
-        g_currentState->key^=g_hashCode[getOtherSide(g_currentSide)][PAWN][moveToMake.target-8];
+        pos.currentState->key^=g_hashCode[getOtherSide(pos.currentSide)][PAWN][moveToMake.target-8];
+        pos.currentState->pawnKey^=g_hashCode[getOtherSide(pos.currentSide)][PAWN][moveToMake.target-8];
+        togglePiece(*pos.currentState,getOtherSide(pos.currentSide),PAWN,moveToMake.target-8);
+        removePieceCount(*pos.currentState,getOtherSide(pos.currentSide),PAWN);
       }
     }
     else {
-      g_currentState->key^=g_hashCode[getOtherSide(g_currentSide)][g_currentPiece[moveToMake.target]]
+      pos.currentState->key^=g_hashCode[getOtherSide(pos.currentSide)][pos.currentPiece[moveToMake.target]]
                                  [moveToMake.target];
+      if (pos.currentPiece[moveToMake.target]==PAWN)
+        pos.currentState->pawnKey^=g_hashCode[getOtherSide(pos.currentSide)][PAWN][moveToMake.target];
+      togglePiece(*pos.currentState,getOtherSide(pos.currentSide),
+                  pos.currentPiece[moveToMake.target],moveToMake.target);
+      removePieceCount(*pos.currentState,getOtherSide(pos.currentSide),
+                       pos.currentPiece[moveToMake.target]);
     }
   }
 
   // Move the piece.
-  g_currentColour[moveToMake.target]=g_currentSide;
+  pos.currentColour[moveToMake.target]=pos.currentSide;
   if (moveToMake.type&PROMOTION) {
-    g_currentState->key^=g_hashCode[g_currentSide][moveToMake.promote]
+    pos.currentState->key^=g_hashCode[pos.currentSide][moveToMake.promote]
                                [moveToMake.target];
-    g_currentPiece[moveToMake.target]=moveToMake.promote;
+    togglePiece(*pos.currentState,pos.currentSide,moveToMake.promote,moveToMake.target);
+    removePieceCount(*pos.currentState,pos.currentSide,PAWN);
+    addPieceCount(*pos.currentState,pos.currentSide,moveToMake.promote);
+    pos.currentPiece[moveToMake.target]=moveToMake.promote;
 
   }
   else {
-    g_currentPiece[moveToMake.target]=g_currentPiece[moveToMake.source];
-    g_currentState->key^=g_hashCode[g_currentSide][g_currentPiece[moveToMake.target]]
+    pos.currentPiece[moveToMake.target]=pos.currentPiece[moveToMake.source];
+    pos.currentState->key^=g_hashCode[pos.currentSide][pos.currentPiece[moveToMake.target]]
                                [moveToMake.target];
+    if (pos.currentPiece[moveToMake.target]==PAWN)
+      pos.currentState->pawnKey^=g_hashCode[pos.currentSide][PAWN][moveToMake.target];
+    togglePiece(*pos.currentState,pos.currentSide,pos.currentPiece[moveToMake.target],
+                moveToMake.target);
   }
-  g_currentState->key^=g_hashCode[g_currentSide][g_currentPiece[moveToMake.source]]  
+  pos.currentState->key^=g_hashCode[pos.currentSide][pos.currentPiece[moveToMake.source]]  
                              [moveToMake.source];  
-  g_currentColour[moveToMake.source]=NONE;
-  g_currentPiece[moveToMake.source]=NONE;
+  if (pos.currentPiece[moveToMake.source]==PAWN)
+    pos.currentState->pawnKey^=g_hashCode[pos.currentSide][PAWN][moveToMake.source];
+  togglePiece(*pos.currentState,pos.currentSide,pos.currentPiece[moveToMake.source],
+              moveToMake.source);
+  pos.currentColour[moveToMake.source]=NONE;
+  pos.currentPiece[moveToMake.source]=NONE;
 
   // Switch sides and test for legality (if we can capture the other guy's 
   // king, it's an illegal position and we need to take the move back).
   // start_againg6: Try to do less work with extra lookups (see other text)!
   //                Don't bother if a castling move as checked for legality
   //                already.
-  g_currentSide=getOtherSide(g_currentSide);             // Swap sides.
-  g_moveNum++;                         // One more move done.
+  pos.currentSide=getOtherSide(pos.currentSide);             // Swap sides.
+  pos.currentState->key^=g_sideHashCode;
+  pos.moveNum++;                         // One more move done.
   if (!(moveToMake.type&CASTLE)) {
-    if (g_gameHistory[g_moveNum-1].inCheck 
-        || moveToMake.target==g_currentState->kingSquare[getOtherSide(g_currentSide)]) {
-      if (isAttacked(g_currentState->kingSquare[getOtherSide(g_currentSide)],g_currentSide)) {
-        takeMoveBack();
+    if (undo.inCheck
+        || moveToMake.target==pos.currentState->kingSquare[getOtherSide(pos.currentSide)]) {
+      if (isAttacked(pos,pos.currentState->kingSquare[getOtherSide(pos.currentSide)],pos.currentSide)) {
+        if constexpr (InPlace)
+          unmakeMove(pos);
+        else
+          takeMoveBack(pos);
         return false;
       }
     }
@@ -290,85 +469,197 @@ bool makeMove(MoveStruct &moveToMake)
       // One more cheap attack (as before this required a full isAttacked() call!).
 
       // Only test the exposed squares (cheaper!).
-      if (testExposure(g_currentState->kingSquare[getOtherSide(g_currentSide)],moveToMake.source,
-                       g_currentSide)) {
-        takeMoveBack();
+      if (testExposure(pos,pos.currentState->kingSquare[getOtherSide(pos.currentSide)],moveToMake.source,
+                       pos.currentSide)) {
+        if constexpr (InPlace)
+          unmakeMove(pos);
+        else
+          takeMoveBack(pos);
         return false;
       }
     }
   }
 
+  // Its key for the repetition tests.
+  storeRepetitionKey(pos);
+
   // See if the state is a draw due to material, repetition or fifty move rule.
   // NOTE: Don't bother checking for check if so, as it doen't matter!
-  if (g_currentState->fiftyCounter>=50 || testNotEnoughMaterial()
-      || testRepetition()) {
-    g_currentState->isDraw=true;             // Is a draw.
-    g_currentState->inCheck=false;           // NOT LOOKED AT ANYWAY!
+  if (pos.currentState->fiftyCounter>=50 || testNotEnoughMaterial(pos)
+      || testRepetition(pos)) {
+    pos.currentState->isDraw=true;             // Is a draw.
+    pos.currentState->inCheck=false;           // NOT LOOKED AT ANYWAY!
   }
   // Else, see if we put the opponent in check.
   else {
 
-    g_currentState->isDraw=false;            // Is not a draw.
+    pos.currentState->isDraw=false;            // Is not a draw.
 
     // If castling, just check the rook for exposed check (cheap!).
     if (moveToMake.type&CASTLE
-        && testExposure(g_currentState->kingSquare[g_currentSide],
-                        extraExposedSquare,getOtherSide(g_currentSide))==true) {
-      g_currentState->inCheck=true;
+        && testExposure(pos,pos.currentState->kingSquare[pos.currentSide],
+                        extraExposedSquare,getOtherSide(pos.currentSide))==true) {
+      pos.currentState->inCheck=true;
     }
     else {
 
       // Enpassant move exposes an extra square to be checked (cheap!).
       if (moveToMake.type&EN_PASSANT
-          && testExposure(g_currentState->kingSquare[g_currentSide],
-                        extraExposedSquare,getOtherSide(g_currentSide))==true) {
-        g_currentState->inCheck=true;
+          && testExposure(pos,pos.currentState->kingSquare[pos.currentSide],
+                        extraExposedSquare,getOtherSide(pos.currentSide))==true) {
+        pos.currentState->inCheck=true;
       }
 
       // Check the exposed square and the piece that moved to see if it's check.
-      else if (singleAttack(g_currentState->kingSquare[g_currentSide],
+      else if (singleAttack(pos,pos.currentState->kingSquare[pos.currentSide],
                             moveToMake.target)==true
-               || testExposure(g_currentState->kingSquare[g_currentSide],
-                               moveToMake.source,getOtherSide(g_currentSide))==true) {
-        g_currentState->inCheck=true;
+               || testExposure(pos,pos.currentState->kingSquare[pos.currentSide],
+                               moveToMake.source,getOtherSide(pos.currentSide))==true) {
+        pos.currentState->inCheck=true;
       }
 
       // Not in check then!
       else {
-        g_currentState->inCheck=false;
+        pos.currentState->inCheck=false;
       }
 
     }
 
   }
 
-  // Save the move that we made into the g_movesMade list.
-  g_movesMade[g_moveNum-1]=moveToMake;
-
   // Return true as made a legal move.
   return true;
 
+} // End doMakeMove.
+
+// ==========================================================================
+
+bool makeMove(Position &pos,MoveStruct &moveToMake)
+{ // Make a move on a copy of the current state (so the game history holds
+  // every position), see doMakeMove(). Taken back with takeMoveBack().
+
+  return doMakeMove<false>(pos,moveToMake);
+
 } // End makeMove.
 
 // ==========================================================================
 
-void takeMoveBack(void)
+bool makeMoveInPlace(Position &pos,MoveStruct &moveToMake)
+{ // Make a move by changing the current state in place, see doMakeMove().
+  // Taken back with unmakeMove(), from the undo record. Used by the search,
+  // where copying the whole state for every move costs more.
+  // NOTE: The game history isn't written, so pos.gameHistory[pos.moveNum] is
+  //       not the current state until the move is taken back (always use
+  //       pos.currentState).
+
+  return doMakeMove<true>(pos,moveToMake);
+
+} // End makeMoveInPlace.
+
+// ==========================================================================
+
+void takeMoveBack(Position &pos)
 { // This function takes back a single move by restoring a previously saved
   // state.
   // NOTE: No need to restore state now.
 
   // Swap and decrement flags/counters.
-  g_currentSide=getOtherSide(g_currentSide);                                // Swap sides.
-  g_moveNum--;                                            // One less move.
+  pos.currentSide=getOtherSide(pos.currentSide);                                // Swap sides.
+  pos.moveNum--;                                            // One less move.
 
   // This points to the current state (for speed) - NOTE: -1 now!.
-  g_currentState--;
+  pos.currentState--;
 
   // Set up the pointer to the current board.
-  g_currentColour=g_currentState->colour;
-  g_currentPiece=g_currentState->piece;
+  pos.currentColour=pos.currentState->colour;
+  pos.currentPiece=pos.currentState->piece;
 
 } // End takeMoveBack.
 
 // ==========================================================================
 
+void unmakeMove(Position &pos)
+{ // This function takes back a single move made by makeMoveInPlace(), by
+  // moving the pieces back and restoring the rest from the undo record.
+
+  // Swap and decrement flags/counters.
+  pos.currentSide=getOtherSide(pos.currentSide);                                // Swap sides.
+  pos.moveNum--;                                            // One less move.
+
+  const MoveStruct &move=pos.movesMade[pos.moveNum];
+  const UndoRecord &undo=pos.undoHistory[pos.moveNum];
+  GameState &state=*pos.currentState;
+  const int side=pos.currentSide;
+  const int other=getOtherSide(side);
+
+  // Move the piece back (a pawn if it promoted).
+  const int piece=pos.currentPiece[move.target];
+  togglePiece(state,side,piece,move.target);
+  if (move.type&PROMOTION) {
+    removePieceCount(state,side,piece);
+    addPieceCount(state,side,PAWN);
+    pos.currentPiece[move.source]=PAWN;
+  }
+  else {
+    pos.currentPiece[move.source]=piece;
+  }
+  pos.currentColour[move.source]=side;
+  togglePiece(state,side,pos.currentPiece[move.source],move.source);
+  pos.currentColour[move.target]=NONE;
+  pos.currentPiece[move.target]=NONE;
+
+  // Put back the piece taken (the en passant pawn is behind the target).
+  if (undo.captured!=NONE) {
+    int capturedSquare=move.target;
+    if (move.type&EN_PASSANT)
+      capturedSquare=(side==WHITE) ? move.target+8 : move.target-8;
+    pos.currentColour[capturedSquare]=other;
+    pos.currentPiece[capturedSquare]=undo.captured;
+    togglePiece(state,other,undo.captured,capturedSquare);
+    addPieceCount(state,other,undo.captured);
+  }
+
+  // If castled, move the rook back.
+  if (move.type&CASTLE) {
+    int rookFrom,rookTo;
+    if (move.target==62) {
+      rookFrom=63;
+      rookTo=61;
+    }
+    else if (move.target==58) {
+      rookFrom=56;
+      rookTo=59;
+    }
+    else if (move.target==6) {
+      rookFrom=7;
+      rookTo=5;
+    }
+    else {
+      rookFrom=0;
+      rookTo=3;
+    }
+    pos.currentColour[rookFrom]=side;
+    pos.currentPiece[rookFrom]=ROOK;
+    pos.currentColour[rookTo]=NONE;
+    pos.currentPiece[rookTo]=NONE;
+    togglePiece(state,side,ROOK,rookTo);
+    togglePiece(state,side,ROOK,rookFrom);
+  }
+
+  // Alter the King's Square if needed.
+  if (move.target==state.kingSquare[side])
+    state.kingSquare[side]=move.source;
+
+  // The rest is just put back.
+  state.key=undo.key;
+  state.pawnKey=undo.pawnKey;
+  state.fiftyCounter=undo.fiftyCounter;
+  state.castlePerm=undo.castlePerm;
+  state.enPass=undo.enPass;
+  state.inCheck=undo.inCheck;
+  state.isDraw=undo.isDraw;
+
+} // End unmakeMove.
+
+// ==========================================================================
+
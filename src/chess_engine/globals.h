@@ -1,9 +1,8 @@
 // *****************************************************************************
 // *                             GLOBAL VARIABLES                              *
 // *****************************************************************************
-// Modernized for C++20 - Dynamic allocation for game history arrays
-// Arrays that were previously fixed-size C arrays are now dynamically allocated
-// based on SearchConfig parameters for safer memory usage.
+// Modernized for C++20 - Only the (read-only after init) lookup tables and hash
+// codes are global now.
 
 #pragma once
 
@@ -12,35 +11,8 @@
 #include "types.h"
 #include "constants.h"
 
-// Forward declaration to avoid circular include
-struct SearchConfig;
-
-// =============================================================================
-// CURRENT GAME/MOVE HISTORY (DYNAMICALLY ALLOCATED)
-// =============================================================================
-// These arrays are now allocated dynamically based on SearchConfig::maxPlysPerGame.
-// They are accessed via unique_ptr and raw pointers for compatibility.
-
-extern std::unique_ptr<GameState[]> g_gameHistory;
-extern int g_moveNum;
-extern int g_currentSide;
-extern GameState* g_currentState;
-extern int8_t* g_currentColour;
-extern int8_t* g_currentPiece;
-
-extern std::unique_ptr<MoveStruct[]> g_movesMade;
-
-// =============================================================================
-// INITIALIZATION FUNCTIONS
-// =============================================================================
-// These must be called before using the global arrays.
-
-// Initialize global arrays with the specified configuration.
-// Must be called before any game operations.
-void initGlobals(const SearchConfig& config);
-
-// Check if globals have been initialized.
-[[nodiscard]] bool areGlobalsInitialized();
+// NOTE: The game history/current state is no longer global, it is held in a
+//       Position object (see position.h) that is passed to the functions.
 
 // =============================================================================
 // LOOKUP TABLES
@@ -52,7 +24,24 @@ extern int g_straightMoves[64][4][8];
 extern int g_kingMoves[64][9];
 extern int g_exposedAttackTable[64][64];
 extern bool g_knightAttackTable[64][64];
-extern SquareData g_posData[6][64][64];
+
+// =============================================================================
+// BITBOARD LOOKUP TABLES
+// =============================================================================
+
+// Total size of the sliding attack tables (sum over squares of 2^relevant bits).
+constexpr int ROOK_ATTACK_TABLE_SIZE = 102400;
+constexpr int BISHOP_ATTACK_TABLE_SIZE = 5248;
+
+extern Bitboard g_knightAttacks[64];
+extern Bitboard g_kingAttacks[64];
+extern Bitboard g_pawnAttacks[2][64];      // Squares a [side] pawn on [square] attacks.
+extern MagicEntry g_rookMagics[64];
+extern MagicEntry g_bishopMagics[64];
+extern Bitboard g_rookAttackTable[ROOK_ATTACK_TABLE_SIZE];
+extern Bitboard g_bishopAttackTable[BISHOP_ATTACK_TABLE_SIZE];
+extern Bitboard g_betweenBB[64][64];       // Squares between two on a line (else 0).
+extern Bitboard g_lineBB[64][64];          // The whole line through two squares (else 0).
 
 // =============================================================================
 // HASH CODES
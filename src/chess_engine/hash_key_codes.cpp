@@ -36,18 +36,26 @@ void initHashCodes(void)
 
 // ============================================================================
 
-HashKey currentKey(void)
-{ // Make a key from the board description.
+HashKey currentKey(const Position &pos)
+{ // Make a key from the board description, castling permissions, en-passent
+  // square and side to move (ie: the same position always has the same key).
   // Only use for loading ect, updated on the fly in MakeMove.
 
   HashKey key=0;
 
   // Use XOR for all squares.
   for (int i=0;i<BOARD_SQUARES;i++) {
-    if (g_currentColour[i]!=NONE)
-      key^=g_hashCode[g_currentColour[i]][g_currentPiece[i]][i];
+    if (pos.currentColour[i]!=NONE)
+      key^=g_hashCode[pos.currentColour[i]][pos.currentPiece[i]][i];
   }
 
+  // And the rest.
+  key^=g_castleHashCode[pos.currentState->castlePerm];
+  if (pos.currentState->enPass!=NO_EN_PASSANT)
+    key^=g_enPassantHashCode[pos.currentState->enPass];
+  if (pos.currentSide==BLACK)
+    key^=g_sideHashCode;
+
   // Return the key.
   return key;
 
@@ -55,3 +63,20 @@ HashKey currentKey(void)
 
 // ============================================================================
 
+HashKey currentPawnKey(const Position &pos)
+{ // Make a key from just the pawns (using the same codes as currentKey()).
+  // Only use for loading ect, updated on the fly in MakeMove.
+
+  HashKey key=0;
+
+  for (int i=0;i<BOARD_SQUARES;i++) {
+    if (pos.currentPiece[i]==PAWN)
+      key^=g_hashCode[pos.currentColour[i]][PAWN][i];
+  }
+
+  return key;
+
+} // End currentPawnKey.
+
+// ============================================================================
+
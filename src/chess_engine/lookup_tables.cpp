@@ -4,7 +4,10 @@
 
 #include "chess_engine.h"
 #include "globals.h"
+#include "bitboards.h"
 #include <mutex>
+#include <random>
+#include <vector>
 
 // ============================================================================
 // Internal initialization function - called once via std::call_once
@@ -103,16 +106,21 @@ void generateExposedAttackTable(void)
   // check (ie Queen/Rook/Bishop) attacks.
   // This may be used to save a full test for check in MakeMove(), so long as
   // the king was not the piece moved.
-  // Also generates the knight attack table now.
+  // Also generates the knight attack table now, and the between/line
+  // bitboards (for the pins and check evasions in genLegalMoves()).
 
   int* movePtr;                             // To iterate through Move Tables.
   int tempSquare;                           // Holds square read from lookup.
+  Bitboard passed;                          // Squares passed along a line.
+  Bitboard rays[64][8];                     // Each square's lines (by lookup index).
 
   // Assume the square can't be attacked.
   for (int i=0;i<64;i++) {
     for (int j=0;j<64;j++) {
       g_exposedAttackTable[i][j]=-1;
       g_knightAttackTable[i][j]=false;
+      g_betweenBB[i][j]=0;
+      g_lineBB[i][j]=0;
     }
   }
 
@@ -122,15 +130,25 @@ void generateExposedAttackTable(void)
     // Add straight moves.
     for (int j=0;j<4;j++) {
       movePtr=g_straightMoves[i][j];
-      while ((tempSquare=(*(movePtr++)))!=END_OF_LOOKUP)
+      passed=0;
+      while ((tempSquare=(*(movePtr++)))!=END_OF_LOOKUP) {
         g_exposedAttackTable[i][tempSquare]=j;
+        g_betweenBB[i][tempSquare]=passed;
+        passed|=squareBB(tempSquare);
+      }
+      rays[i][j]=passed;
     }
 
     // Add diagonal moves.
     for (int j=0;j<4;j++) {
       movePtr=g_diagonalMoves[i][j];
-      while ((tempSquare=(*(movePtr++)))!=END_OF_LOOKUP)
+      passed=0;
+      while ((tempSquare=(*(movePtr++)))!=END_OF_LOOKUP) {
         g_exposedAttackTable[i][tempSquare]=4+j;
+        g_betweenBB[i][tempSquare]=passed;
+        passed|=squareBB(tempSquare);
+      }
+      rays[i][4+j]=passed;
     }
 
     // Add the knights moves.
@@ -140,137 +158,165 @@ void generateExposedAttackTable(void)
 
   }
 
+  // The line through two squares is the line from each through the other.
+  for (int i=0;i<64;i++) {
+    for (int j=0;j<64;j++) {
+      if (g_exposedAttackTable[i][j]!=-1)
+        g_lineBB[i][j]=rays[i][g_exposedAttackTable[i][j]]|rays[j][g_exposedAttackTable[j][i]];
+    }
+  }
+
 } // End generateExposedAttackTable.
 
 // =============================================================================
 
-void initPosData(void)
-{ // This function inits the g_posData lookup table.
-
-  int i,j,s,count;
-  int tableIndex;
-
-  // Add the Knignt moves.
-  for (s=0;s<64;s++) {
-
-    tableIndex=0;
+static Bitboard slidingAttacks(const int (*rays)[8],Bitboard occupied)
+{ // Walks the four rays (from the move tables) out from a square, stopping at
+  // (and including) the first occupied square on each.
 
-    // Add the moves.
-    for (i=0;g_knightMoves[s][i]!=END_OF_LOOKUP;i++,tableIndex++) {
-      g_posData[KNIGHT][s][tableIndex].testSquare=g_knightMoves[s][i];
-      g_posData[KNIGHT][s][tableIndex].skip=(g_posData[KNIGHT][s]+tableIndex+1);
-    }
-    g_posData[KNIGHT][s][tableIndex].testSquare=END_OF_LOOKUP;
-    g_posData[KNIGHT][s][tableIndex].skip=nullptr;
-
-  }
-
-  // Add the King moves.
-  for (s=0;s<64;s++) {
-
-    tableIndex=0;
+  Bitboard attacks=0;
 
-    // Add the moves.
-    for (i=0;g_kingMoves[s][i]!=END_OF_LOOKUP;i++,tableIndex++) {
-      g_posData[KING][s][tableIndex].testSquare=g_kingMoves[s][i];
-      g_posData[KING][s][tableIndex].skip=(g_posData[KING][s]+tableIndex+1);
+  for (int dirIndex=0;dirIndex<4;dirIndex++) {
+    for (const int* movePtr=rays[dirIndex];*movePtr!=END_OF_LOOKUP;movePtr++) {
+      attacks|=squareBB(*movePtr);
+      if (occupied&squareBB(*movePtr))
+        break;
     }
-    g_posData[KING][s][tableIndex].testSquare=END_OF_LOOKUP;
-    g_posData[KING][s][tableIndex].skip=nullptr;
-
   }
 
-  // Add the bishop moves.
-  for (s=0;s<64;s++) {
-
-    tableIndex=0;
-
-    // Add the moves.
-    for (j=0;j<4;j++) {
+  return attacks;
 
-      // count how mnay are in list.
-      for (count=0,i=0;g_diagonalMoves[s][j][i]!=END_OF_LOOKUP;i++)
-        count++;
+} // End slidingAttacks.
 
-      int nextEnd=tableIndex+count;
+// =============================================================================
 
-      for (i=0;g_diagonalMoves[s][j][i]!=END_OF_LOOKUP;i++,tableIndex++) {
-        g_posData[BISHOP][s][tableIndex].testSquare=g_diagonalMoves[s][j][i];
-        g_posData[BISHOP][s][tableIndex].skip=(g_posData[BISHOP][s]+nextEnd);
-      }
+static Bitboard relevantOccupancy(const int (*rays)[8])
+{ // The squares whose occupancy can change the sliding attacks: all the ray
+  // squares apart from the last one on each ray (it is attacked either way).
 
-    }
-    g_posData[BISHOP][s][tableIndex].testSquare=END_OF_LOOKUP;
-    g_posData[BISHOP][s][tableIndex].skip=nullptr;
+  Bitboard mask=0;
 
+  for (int dirIndex=0;dirIndex<4;dirIndex++) {
+    for (int i=0;rays[dirIndex][i]!=END_OF_LOOKUP && rays[dirIndex][i+1]!=END_OF_LOOKUP;i++)
+      mask|=squareBB(rays[dirIndex][i]);
   }
 
-  // Add the rook moves.
-  for (s=0;s<64;s++) {
-
-    tableIndex=0;
+  return mask;
 
-    // Add the moves.
-    for (j=0;j<4;j++) {
+} // End relevantOccupancy.
 
-      // count how mnay are in list.
-      for (count=0,i=0;g_straightMoves[s][j][i]!=END_OF_LOOKUP;i++)
-        count++;
+// =============================================================================
 
-      int nextEnd=tableIndex+count;
+static void initMagics(MagicEntry* magics,Bitboard* attackTable,int tableSize,
+                       int (*rays)[4][8],std::mt19937_64 &magicRng)
+{ // Fills the attack table for one type of slider. Each square gets a slice of
+  // 2^(relevant bits) entries; without PEXT we also search for a magic number
+  // that maps every occupancy subset into the slice without a bad collision.
+
+  std::vector<Bitboard> occupancy(4096);
+  std::vector<Bitboard> reference(4096);
+  std::vector<int> epoch(4096,0);
+  int attempt=0;
+  int tableUsed=0;
+
+  for (int s=0;s<64;s++) {
+
+    MagicEntry &entry=magics[s];
+    entry.mask=relevantOccupancy(rays[s]);
+    entry.shift=64-countSquares(entry.mask);
+    entry.magic=0;
+    entry.attacks=attackTable+tableUsed;
+    tableUsed+=(1<<countSquares(entry.mask));
+    if (tableUsed>tableSize)
+      FATAL_ERROR("Sliding attack table too small.");
+
+    // Enumerate all subsets of the mask (Carry-Rippler trick).
+    int numSubsets=0;
+    Bitboard subset=0;
+    do {
+      occupancy[numSubsets]=subset;
+      reference[numSubsets++]=slidingAttacks(rays[s],subset);
+      subset=(subset-entry.mask)&entry.mask;
+    } while (subset);
+
+    // With PEXT the index is just the occupancy bits packed together.
+    if constexpr (PEXT_BITBOARDS) {
+      for (int i=0;i<numSubsets;i++)
+        entry.attacks[magicIndex(entry,occupancy[i])]=reference[i];
+      continue;
+    }
 
-      for (i=0;g_straightMoves[s][j][i]!=END_OF_LOOKUP;i++,tableIndex++) {
-        g_posData[ROOK][s][tableIndex].testSquare=g_straightMoves[s][j][i];
-        g_posData[ROOK][s][tableIndex].skip=(g_posData[ROOK][s]+nextEnd);
+    // Try sparse random numbers until one works (the epoch avoids having to
+    // clear the slice between attempts).
+    for (int i=0;i<numSubsets;) {
+      do {
+        entry.magic=magicRng()&magicRng()&magicRng();
+      } while (countSquares((entry.magic*entry.mask)>>56)<6);
+      attempt++;
+      for (i=0;i<numSubsets;i++) {
+        unsigned index=magicIndex(entry,occupancy[i]);
+        if (epoch[index]<attempt) {
+          epoch[index]=attempt;
+          entry.attacks[index]=reference[i];
+        }
+        else if (entry.attacks[index]!=reference[i]) {
+          break;                                    // Bad collision.
+        }
       }
-
     }
-    g_posData[ROOK][s][tableIndex].testSquare=END_OF_LOOKUP;
-    g_posData[ROOK][s][tableIndex].skip=nullptr;
 
   }
 
-  // Add the queen moves.
-  for (s=0;s<64;s++) {
+} // End initMagics.
 
-    tableIndex=0;
-
-    // Add the moves.
-    for (j=0;j<4;j++) {
-
-      // count how mnay are in list.
-      for (count=0,i=0;g_diagonalMoves[s][j][i]!=END_OF_LOOKUP;i++)
-        count++;
-
-      int nextEnd=tableIndex+count;
-
-      for (i=0;g_diagonalMoves[s][j][i]!=END_OF_LOOKUP;i++,tableIndex++) {
-        g_posData[QUEEN][s][tableIndex].testSquare=g_diagonalMoves[s][j][i];
-        g_posData[QUEEN][s][tableIndex].skip=(g_posData[QUEEN][s]+nextEnd);
-      }
+// =============================================================================
 
+static void generateBitboardTablesInternal(void)
+{ // This function generates the bitboard attack tables from the move tables.
+
+  // Fixed seed so the magics (and hence start-up time) are reproducible.
+  std::mt19937_64 magicRng(728);
+
+  for (int s=0;s<64;s++) {
+
+    // Knights and kings.
+    g_knightAttacks[s]=0;
+    for (int i=0;g_knightMoves[s][i]!=END_OF_LOOKUP;i++)
+      g_knightAttacks[s]|=squareBB(g_knightMoves[s][i]);
+    g_kingAttacks[s]=0;
+    for (int i=0;g_kingMoves[s][i]!=END_OF_LOOKUP;i++)
+      g_kingAttacks[s]|=squareBB(g_kingMoves[s][i]);
+
+    // Pawn captures (WHITE moves towards A8=0).
+    g_pawnAttacks[WHITE][s]=0;
+    g_pawnAttacks[BLACK][s]=0;
+    if (s>=8) {
+      if (getFile(s)!=0)
+        g_pawnAttacks[WHITE][s]|=squareBB(s-9);
+      if (getFile(s)!=7)
+        g_pawnAttacks[WHITE][s]|=squareBB(s-7);
     }
-    // Add the moves.
-    for (j=0;j<4;j++) {
-
-      // count how mnay are in list.
-      for (count=0,i=0;g_straightMoves[s][j][i]!=END_OF_LOOKUP;i++)
-        count++;
-
-      int nextEnd=tableIndex+count;
-
-      for (i=0;g_straightMoves[s][j][i]!=END_OF_LOOKUP;i++,tableIndex++) {
-        g_posData[QUEEN][s][tableIndex].testSquare=g_straightMoves[s][j][i];
-        g_posData[QUEEN][s][tableIndex].skip=(g_posData[QUEEN][s]+nextEnd);
-      }
-
+    if (s<56) {
+      if (getFile(s)!=0)
+        g_pawnAttacks[BLACK][s]|=squareBB(s+7);
+      if (getFile(s)!=7)
+        g_pawnAttacks[BLACK][s]|=squareBB(s+9);
     }
-    g_posData[QUEEN][s][tableIndex].testSquare=END_OF_LOOKUP;
-    g_posData[QUEEN][s][tableIndex].skip=nullptr;
 
   }
 
-} // End initPosData.
+  // Sliding pieces.
+  initMagics(g_bishopMagics,g_bishopAttackTable,BISHOP_ATTACK_TABLE_SIZE,g_diagonalMoves,magicRng);
+  initMagics(g_rookMagics,g_rookAttackTable,ROOK_ATTACK_TABLE_SIZE,g_straightMoves,magicRng);
+
+} // End generateBitboardTablesInternal.
+
+// Wrapper function for thread-safe initialization
+void generateBitboardTables(void)
+{ // MUST BE DONE AFTER MOVE TABLES.
+  static std::once_flag initFlag;
+  std::call_once(initFlag, generateBitboardTablesInternal);
+} // End generateBitboardTables.
 
 // ============================================================================
 
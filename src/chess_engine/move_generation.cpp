@@ -4,262 +4,446 @@
 
 #include "chess_engine.h"
 #include "globals.h"
+#include "bitboards.h"
 
 // ============================================================================
 
-void genLegalMoves(MoveList &moves)
-{ // This function returns a list of all legal moves from to position.
+static inline void genPawnTargets(const Position &pos,MoveList &moves,Bitboard targets,
+                                  int offset,int type)
+{ // Adds a pawn move to each target square (the source is offset from it).
 
-  // This is the list of psuedo-legal moves.
-  MoveList psuedoLegalMoves;
+  while (targets) {
+    const int target=popFirstSquare(targets);
+    genPush(pos,moves,target+offset,target,type);
+  }
 
-  // Generate all psuedo-legal moves.
-  genMoves(psuedoLegalMoves);
+} // End genPawnTargets.
 
-  // No moves in output yet.
-  moves.numMoves=0;
+// ============================================================================
 
-  // Attempt to make each move, and copy to output if legal.
-  for (int i=0;i<psuedoLegalMoves.numMoves;i++) {
+static inline void genPieceMoves(const Position &pos,MoveList &moves,Bitboard captureMask,
+                                 Bitboard quietMask)
+{ // Adds the moves of every (non-pawn) friendly piece: captures onto the
+  // squares in captureMask, then quiet moves onto the squares in quietMask.
+
+  const GameState &state=*pos.currentState;
+  const Bitboard occupied=state.colourBB[WHITE]|state.colourBB[BLACK];
+
+  for (int piece=KNIGHT;piece<=KING;piece++) {
+    Bitboard pieces=state.pieceBB[piece]&state.colourBB[pos.currentSide];
+    while (pieces) {
+      const int source=popFirstSquare(pieces);
+      const Bitboard attacks=pieceAttacks(piece,source,occupied);
+      Bitboard targets=attacks&captureMask;
+      while (targets)
+        genPush(pos,moves,source,popFirstSquare(targets),CAPTURE);
+      targets=attacks&quietMask;
+      while (targets)
+        genPush(pos,moves,source,popFirstSquare(targets),NORMAL_MOVE);
+    }
+  }
 
-    // See if the move is realy legal.
-    if (makeMove(psuedoLegalMoves.moves[i])) {
+} // End genPieceMoves.
 
-      // Take the move back.
-      takeMoveBack();
+// ============================================================================
 
-      // Copy it to the output.
-      moves.moves[moves.numMoves++] = psuedoLegalMoves.moves[i];
+static inline void genCastles(const Position &pos,MoveList &moves)
+{ // Adds the castle moves (if any).
+  // start_again6: All but the check for Attack here to save time. Attack check 
+  //               in MakeMove() in case this move is prunned and not looked at.
 
+  if (!pos.currentState->inCheck) {
+    if (pos.currentSide==WHITE) {
+      if (pos.currentState->castlePerm&WHITE_KING_SIDE
+          && pos.currentColour[61]==NONE
+          && pos.currentColour[62]==NONE) {
+        genPush(pos,moves,60,62,CASTLE);
+      }
+      if (pos.currentState->castlePerm&WHITE_QUEEN_SIDE
+          && pos.currentColour[57]==NONE
+          && pos.currentColour[58]==NONE
+          && pos.currentColour[59]==NONE) {
+        genPush(pos,moves,60,58,CASTLE);
+      }
+    }
+    else {
+      if (pos.currentState->castlePerm&BLACK_KING_SIDE
+          && pos.currentColour[5]==NONE
+          && pos.currentColour[6]==NONE) {
+        genPush(pos,moves,4,6,CASTLE);
+      }
+      if (pos.currentState->castlePerm&BLACK_QUEEN_SIDE
+          && pos.currentColour[1]==NONE
+          && pos.currentColour[2]==NONE
+          && pos.currentColour[3]==NONE) {
+        genPush(pos,moves,4,2,CASTLE);
+      }
+    }
+  }
+
+} // End genCastles.
+
+// ============================================================================
+
+static inline void genEnPassant(const Position &pos,MoveList &moves)
+{ // Adds the en passant captures (if any).
+
+  if (pos.currentState->enPass!=NO_EN_PASSANT) {
+
+    // Our pawns that could capture onto the square are on the squares an
+    // enemy pawn there would attack.
+    Bitboard sources=g_pawnAttacks[getOtherSide(pos.currentSide)][pos.currentState->enPass]
+                     &pos.currentState->pieceBB[PAWN]
+                     &pos.currentState->colourBB[pos.currentSide];
+    while (sources) {
+      genPush(pos,moves,popFirstSquare(sources),pos.currentState->enPass,
+              PAWN_MOVE|EN_PASSANT|CAPTURE);
     }
 
   }
 
-} // End GenLegalMoves. 
+} // End genEnPassant.
 
 // ============================================================================
 
-void genMoves(MoveList &moves)
-{ // This function generates (pseudo-legal) moves for the current position.
-  // It scans the board to find friendly pieces and then determines what 
-  // squares they attack. When it finds a piece/square combination, it calls 
-  // genPush to put the move on the "move stack."
-  // NOTE: All movement lookup tables are generated here *ONCE ONLY* and then
-  //       saved in statics for later use (saving on all the X/Y Bounds stuff).
+static inline Bitboard getPinned(const GameState &state,int side,int kingSquare)
+{ // Returns the side's pieces that are pinned to its king: ie: the only piece
+  // between the king and an enemy slider that could attack along the line.
+
+  const Bitboard occupied=state.colourBB[WHITE]|state.colourBB[BLACK];
+  Bitboard snipers=((rookAttacks(kingSquare,0)&(state.pieceBB[ROOK]|state.pieceBB[QUEEN]))
+                    |(bishopAttacks(kingSquare,0)&(state.pieceBB[BISHOP]|state.pieceBB[QUEEN])))
+                   &state.colourBB[getOtherSide(side)];
+  Bitboard pinned=0;
+
+  while (snipers) {
+    const Bitboard blockers=g_betweenBB[kingSquare][popFirstSquare(snipers)]&occupied;
+    if (blockers && !(blockers&(blockers-1)))
+      pinned|=blockers&state.colourBB[side];
+  }
+
+  return pinned;
+
+} // End getPinned.
 
-  SquareData* squareData;
+// ============================================================================
+
+static inline void genLegalPawnTargets(const Position &pos,MoveList &moves,Bitboard targets,
+                                       int offset,int type,Bitboard pinned)
+{ // Like genPawnTargets(), but a pinned pawn may only move along the pin.
+
+  const int kingSquare=pos.currentState->kingSquare[pos.currentSide];
+
+  while (targets) {
+    const int target=popFirstSquare(targets);
+    const int source=target+offset;
+    if ((pinned&squareBB(source)) && !(g_lineBB[kingSquare][source]&squareBB(target)))
+      continue;
+    genPush(pos,moves,source,target,type);
+  }
+
+} // End genLegalPawnTargets.
+
+// ============================================================================
+
+static inline void keepLegalMoves(const Position &pos,MoveList &moves,int first)
+{ // Drops the moves from first on that leave our king in check.
+
+  int numMoves=first;
+  for (int i=first;i<moves.numMoves;i++) {
+    if (isLegal(pos,moves.moves[i]))
+      moves.moves[numMoves++]=moves.moves[i];
+  }
+  moves.numMoves=numMoves;
+
+} // End keepLegalMoves.
+
+// ============================================================================
+
+void genLegalMoves(const Position &pos,MoveList &moves)
+{ // This function returns a list of all legal moves from to position.
+  // The checkers and pinned pieces are found first, so that only legal moves
+  // are generated (in the same order as genMoves()):
+  // - In check, a piece must take the checker or block it (in double check,
+  //   only the king can move).
+  // - A pinned piece can only move along the pin.
+  // - The king can't move onto an attacked square.
+  // Only en passant and castling are tested move by move (with isLegal()).
+
+  const GameState &state=*pos.currentState;
+  const int kingSquare=state.kingSquare[pos.currentSide];
+  const Bitboard own=state.colourBB[pos.currentSide];
+  const Bitboard enemy=state.colourBB[getOtherSide(pos.currentSide)];
+  const Bitboard occupied=own|enemy;
+  const Bitboard empty=~occupied;
+  const Bitboard checkers=attackersTo(state,kingSquare,occupied)&enemy;
+  const Bitboard pinned=getPinned(state,pos.currentSide,kingSquare);
+  const Bitboard pawns=state.pieceBB[PAWN]&own;
+  Bitboard pushes;
+
+  // Where the other pieces can move to when in check.
+  Bitboard targetMask=~Bitboard(0);
+  if (checkers&(checkers-1))
+    targetMask=0;
+  else if (checkers)
+    targetMask=checkers|g_betweenBB[kingSquare][getFirstSquare(checkers)];
 
   // So far, we have no moves for the current ply.
   moves.numMoves=0;
-  for (int i=0;i<BOARD_SQUARES;i++) {
-    if (g_currentColour[i]==g_currentSide) {
-      if (g_currentPiece[i]==PAWN) {
-        if (g_currentSide==WHITE) {
-          if (getFile(i)!=0 && g_currentColour[i-9]==BLACK)
-            genPush(moves,i,i-9,PAWN_MOVE|CAPTURE);
-          if (getFile(i)!=7 && g_currentColour[i-7]==BLACK)
-            genPush(moves,i,i-7,PAWN_MOVE|CAPTURE);
-          if (g_currentColour[i-8]==NONE) {
-            genPush(moves,i,i-8,PAWN_MOVE);
-            if (i>=48 && g_currentColour[i-16]==NONE)
-              genPush(moves,i,i-16,PAWN_MOVE|TWO_SQUARES);
-          }
-        }
-        else {
-          if (getFile(i)!=0 && g_currentColour[i+7]==WHITE)
-            genPush(moves,i,i+7,PAWN_MOVE|CAPTURE);
-          if (getFile(i)!=7 && g_currentColour[i+9]==WHITE)
-            genPush(moves,i,i+9,PAWN_MOVE|CAPTURE);
-          if (g_currentColour[i+8]==NONE) {
-            genPush(moves,i,i+8,PAWN_MOVE);
-            if (i<=15 && g_currentColour[i+16]==NONE)
-              genPush(moves,i,i+16,PAWN_MOVE|TWO_SQUARES);
-          }
-        }
 
-      }
-      
-      // Do other pieces.
-      else {
-        squareData=g_posData[g_currentPiece[i]][i];
-        do {
-          if (g_currentColour[squareData->testSquare]==NONE) { 
-            genPush(moves,i,squareData->testSquare,NORMAL_MOVE);
-            squareData++;
-          }
-          else {
-            if (g_currentColour[squareData->testSquare]==getOtherSide(g_currentSide))
-              genPush(moves,i,squareData->testSquare,CAPTURE);
-            squareData=squareData->skip;
-          }
-        } while (squareData->testSquare!=END_OF_LOOKUP);
-      }
+  // Pawn captures, pushes and double pushes.
+  if (pos.currentSide==WHITE) {
+    genLegalPawnTargets(pos,moves,((pawns&~FILE_A_BB)>>9)&enemy&targetMask,9,PAWN_MOVE|CAPTURE,pinned);
+    genLegalPawnTargets(pos,moves,((pawns&~FILE_H_BB)>>7)&enemy&targetMask,7,PAWN_MOVE|CAPTURE,pinned);
+    pushes=(pawns>>8)&empty;
+    genLegalPawnTargets(pos,moves,pushes&targetMask,8,PAWN_MOVE,pinned);
+    genLegalPawnTargets(pos,moves,((pushes&RANK_3_BB)>>8)&empty&targetMask,16,
+                        PAWN_MOVE|TWO_SQUARES,pinned);
+  }
+  else {
+    genLegalPawnTargets(pos,moves,((pawns&~FILE_A_BB)<<7)&enemy&targetMask,-7,PAWN_MOVE|CAPTURE,pinned);
+    genLegalPawnTargets(pos,moves,((pawns&~FILE_H_BB)<<9)&enemy&targetMask,-9,PAWN_MOVE|CAPTURE,pinned);
+    pushes=(pawns<<8)&empty;
+    genLegalPawnTargets(pos,moves,pushes&targetMask,-8,PAWN_MOVE,pinned);
+    genLegalPawnTargets(pos,moves,((pushes&RANK_6_BB)<<8)&empty&targetMask,-16,
+                        PAWN_MOVE|TWO_SQUARES,pinned);
+  }
 
+  // Do other pieces (a pinned knight can never move along the pin).
+  for (int piece=KNIGHT;piece<=QUEEN && targetMask;piece++) {
+    Bitboard pieces=state.pieceBB[piece]&own;
+    while (pieces) {
+      const int source=popFirstSquare(pieces);
+      Bitboard attacks=pieceAttacks(piece,source,occupied)&targetMask;
+      if (pinned&squareBB(source))
+        attacks&=g_lineBB[kingSquare][source];
+      Bitboard targets=attacks&enemy;
+      while (targets)
+        genPush(pos,moves,source,popFirstSquare(targets),CAPTURE);
+      targets=attacks&empty;
+      while (targets)
+        genPush(pos,moves,source,popFirstSquare(targets),NORMAL_MOVE);
     }
+  }
 
-  } // End for all squares.
+  // The king: Looked at without itself in the way, as it can't step back
+  // along the line of a slider checking it.
+  const Bitboard occupiedNoKing=occupied^squareBB(kingSquare);
+  Bitboard targets=g_kingAttacks[kingSquare]&enemy;
+  while (targets) {
+    const int target=popFirstSquare(targets);
+    if (!(attackersTo(state,target,occupiedNoKing)&enemy))
+      genPush(pos,moves,kingSquare,target,CAPTURE);
+  }
+  targets=g_kingAttacks[kingSquare]&empty;
+  while (targets) {
+    const int target=popFirstSquare(targets);
+    if (!(attackersTo(state,target,occupiedNoKing)&enemy))
+      genPush(pos,moves,kingSquare,target,NORMAL_MOVE);
+  }
 
-  // Generate castle moves.
-  // start_again6: All but the check for Attack here to save time. Attack check 
-  //               in MakeMove() in case this move is prunned and not looked at.
-  if (!g_currentState->inCheck) {
-    if (g_currentSide==WHITE) {
-      if (g_currentState->castlePerm&WHITE_KING_SIDE
-          && g_currentColour[61]==NONE
-          && g_currentColour[62]==NONE) {
-        genPush(moves,60,62,CASTLE);
-      }
-      if (g_currentState->castlePerm&WHITE_QUEEN_SIDE
-          && g_currentColour[57]==NONE
-          && g_currentColour[58]==NONE
-          && g_currentColour[59]==NONE) {
-        genPush(moves,60,58,CASTLE);
-      }
-    }
-    else {
-      if (g_currentState->castlePerm&BLACK_KING_SIDE
-          && g_currentColour[5]==NONE
-          && g_currentColour[6]==NONE) {
-        genPush(moves,4,6,CASTLE);
-      }
-      if (g_currentState->castlePerm&BLACK_QUEEN_SIDE
-          && g_currentColour[1]==NONE
-          && g_currentColour[2]==NONE
-          && g_currentColour[3]==NONE) {
-        genPush(moves,4,2,CASTLE);
-      }
-    }
+  // Generate castle moves (not in check), and en passant moves.
+  // NOTE: The inCheck flag isn't set in a drawn position, so test checkers.
+  int first=moves.numMoves;
+  if (!checkers) {
+    genCastles(pos,moves);
+    keepLegalMoves(pos,moves,first);
   }
+  first=moves.numMoves;
+  genEnPassant(pos,moves);
+  keepLegalMoves(pos,moves,first);
 
-  // Generate en passant moves.
-  if (g_currentState->enPass!=NO_EN_PASSANT) {
-    if (g_currentSide==WHITE) {
-      if (getFile(g_currentState->enPass)!=0
-          && g_currentColour[g_currentState->enPass+7]==WHITE 
-          && g_currentPiece[g_currentState->enPass+7]==PAWN) {
-        genPush(moves,g_currentState->enPass+7,
-                g_currentState->enPass,PAWN_MOVE|EN_PASSANT|CAPTURE);
-      }
-      if (getFile(g_currentState->enPass)!=7
-          && g_currentColour[g_currentState->enPass+9]==WHITE 
-          && g_currentPiece[g_currentState->enPass+9]==PAWN) {
-        genPush(moves,g_currentState->enPass+9,
-                g_currentState->enPass,PAWN_MOVE|EN_PASSANT|CAPTURE);
-      }
-    }
-    else {
-      if (getFile(g_currentState->enPass)!=0
-          && g_currentColour[g_currentState->enPass-9]==BLACK 
-          && g_currentPiece[g_currentState->enPass-9]==PAWN) {
-        genPush(moves,g_currentState->enPass-9,
-                g_currentState->enPass,PAWN_MOVE|EN_PASSANT|CAPTURE);
-      }
-      if (getFile(g_currentState->enPass)!=7
-          && g_currentColour[g_currentState->enPass-7]==BLACK 
-          && g_currentPiece[g_currentState->enPass-7]==PAWN) {
-        genPush(moves,g_currentState->enPass-7,
-                g_currentState->enPass,PAWN_MOVE|EN_PASSANT|CAPTURE);
-      }
-    }
+} // End genLegalMoves.
+
+// ============================================================================
+
+void genMoves(const Position &pos,MoveList &moves)
+{ // This function generates (pseudo-legal) moves for the current position.
+  // It uses the bitboards: the pawns are done all at once by shifting the
+  // pawn set, the other pieces look up their attack sets. Each move found is
+  // passed to genPush to put it on the "move stack."
+
+  const GameState &state=*pos.currentState;
+  const Bitboard enemy=state.colourBB[getOtherSide(pos.currentSide)];
+  const Bitboard empty=~(state.colourBB[WHITE]|state.colourBB[BLACK]);
+  const Bitboard pawns=state.pieceBB[PAWN]&state.colourBB[pos.currentSide];
+  Bitboard pushes;
+
+  // So far, we have no moves for the current ply.
+  moves.numMoves=0;
+
+  // Pawn captures, pushes and double pushes.
+  if (pos.currentSide==WHITE) {
+    genPawnTargets(pos,moves,((pawns&~FILE_A_BB)>>9)&enemy,9,PAWN_MOVE|CAPTURE);
+    genPawnTargets(pos,moves,((pawns&~FILE_H_BB)>>7)&enemy,7,PAWN_MOVE|CAPTURE);
+    pushes=(pawns>>8)&empty;
+    genPawnTargets(pos,moves,pushes,8,PAWN_MOVE);
+    genPawnTargets(pos,moves,((pushes&RANK_3_BB)>>8)&empty,16,PAWN_MOVE|TWO_SQUARES);
+  }
+  else {
+    genPawnTargets(pos,moves,((pawns&~FILE_A_BB)<<7)&enemy,-7,PAWN_MOVE|CAPTURE);
+    genPawnTargets(pos,moves,((pawns&~FILE_H_BB)<<9)&enemy,-9,PAWN_MOVE|CAPTURE);
+    pushes=(pawns<<8)&empty;
+    genPawnTargets(pos,moves,pushes,-8,PAWN_MOVE);
+    genPawnTargets(pos,moves,((pushes&RANK_6_BB)<<8)&empty,-16,PAWN_MOVE|TWO_SQUARES);
   }
 
+  // Do other pieces.
+  genPieceMoves(pos,moves,enemy,empty);
+
+  // Generate castle moves.
+  genCastles(pos,moves);
+
+  // Generate en passant moves.
+  genEnPassant(pos,moves);
+
 } // End genMoves.
 
 // ==========================================================================
 
-void genCaptures(MoveList &moves)
+void genCaptures(const Position &pos,MoveList &moves)
 { // This function generates (pseudo-legal) capture moves for the current 
-  // position for use in Q. search.
+  // position for use in Q. search (promotions by pushing are included).
 
-  SquareData* squareData;
+  const GameState &state=*pos.currentState;
+  const Bitboard enemy=state.colourBB[getOtherSide(pos.currentSide)];
+  const Bitboard empty=~(state.colourBB[WHITE]|state.colourBB[BLACK]);
+  const Bitboard pawns=state.pieceBB[PAWN]&state.colourBB[pos.currentSide];
 
   // So far, we have no moves for the current ply.
   moves.numMoves=0;
-  for (int i=0;i<BOARD_SQUARES;i++) {
-    if (g_currentColour[i]==g_currentSide) {
-      if (g_currentPiece[i]==PAWN) {
-        if (g_currentSide==WHITE) {
-          if (getFile(i)!=0 && g_currentColour[i-9]==BLACK)
-            genPush(moves,i,i-9,PAWN_MOVE|CAPTURE);
-          if (getFile(i)!=7 && g_currentColour[i-7]==BLACK)
-            genPush(moves,i,i-7,PAWN_MOVE|CAPTURE);
-          if (i<=15 && g_currentColour[i-8]==NONE)
-            genPush(moves,i,i-8,PAWN_MOVE);
-        }
-        else {
-          if (getFile(i)!=0 && g_currentColour[i+7]==WHITE)
-            genPush(moves,i,i+7,PAWN_MOVE|CAPTURE);
-          if (getFile(i)!=7 && g_currentColour[i+9]==WHITE)
-            genPush(moves,i,i+9,PAWN_MOVE|CAPTURE);
-          if (i>=48 && g_currentColour[i+8]==NONE)
-            genPush(moves,i,i+8,PAWN_MOVE);
-        }
 
-      }
+  // Pawn captures and promotions.
+  if (pos.currentSide==WHITE) {
+    genPawnTargets(pos,moves,((pawns&~FILE_A_BB)>>9)&enemy,9,PAWN_MOVE|CAPTURE);
+    genPawnTargets(pos,moves,((pawns&~FILE_H_BB)>>7)&enemy,7,PAWN_MOVE|CAPTURE);
+    genPawnTargets(pos,moves,(pawns>>8)&empty&RANK_8_BB,8,PAWN_MOVE);
+  }
+  else {
+    genPawnTargets(pos,moves,((pawns&~FILE_A_BB)<<7)&enemy,-7,PAWN_MOVE|CAPTURE);
+    genPawnTargets(pos,moves,((pawns&~FILE_H_BB)<<9)&enemy,-9,PAWN_MOVE|CAPTURE);
+    genPawnTargets(pos,moves,(pawns<<8)&empty&RANK_1_BB,-8,PAWN_MOVE);
+  }
 
-      // Do other pieces.
-      else {
-        squareData=g_posData[g_currentPiece[i]][i];
-        do {
-          if (g_currentColour[squareData->testSquare]==NONE) {
-            squareData++;
-          }
-          else {
-            if (g_currentColour[squareData->testSquare]==getOtherSide(g_currentSide))
-              genPush(moves,i,squareData->testSquare,CAPTURE);
-            squareData=squareData->skip;
-          }
-        } while (squareData->testSquare!=END_OF_LOOKUP);
-      }
+  // Do other pieces.
+  genPieceMoves(pos,moves,enemy,0);
 
-    }
+  // Generate en passant moves.
+  genEnPassant(pos,moves);
 
-  } // End for all squares.
+} // End genCaptures.
 
-  // Generate en passant moves.
-  if (g_currentState->enPass!=NO_EN_PASSANT) {
-    if (g_currentSide==WHITE) {
-      if (getFile(g_currentState->enPass)!=0
-          && g_currentColour[g_currentState->enPass+7]==WHITE
-          && g_currentPiece[g_currentState->enPass+7]==PAWN) {
-        genPush(moves,g_currentState->enPass+7,
-                g_currentState->enPass,PAWN_MOVE|EN_PASSANT|CAPTURE);
-      }
-      if (getFile(g_currentState->enPass)!=7
-          && g_currentColour[g_currentState->enPass+9]==WHITE
-          && g_currentPiece[g_currentState->enPass+9]==PAWN) {
-        genPush(moves,g_currentState->enPass+9,
-                g_currentState->enPass,PAWN_MOVE|EN_PASSANT|CAPTURE);
-      }
-    }
-    else {
-      if (getFile(g_currentState->enPass)!=0
-          && g_currentColour[g_currentState->enPass-9]==BLACK
-          && g_currentPiece[g_currentState->enPass-9]==PAWN) {
-        genPush(moves,g_currentState->enPass-9,
-                g_currentState->enPass,PAWN_MOVE|EN_PASSANT|CAPTURE);
-      }
-      if (getFile(g_currentState->enPass)!=7
-          && g_currentColour[g_currentState->enPass-7]==BLACK
-          && g_currentPiece[g_currentState->enPass-7]==PAWN) {
-        genPush(moves,g_currentState->enPass-7,
-                g_currentState->enPass,PAWN_MOVE|EN_PASSANT|CAPTURE);
-      }
-    }
+// ==========================================================================
+
+void genQuiets(const Position &pos,MoveList &moves)
+{ // This function generates the (pseudo-legal) moves genCaptures() doesn't:
+  // Pawn pushes (less promotions), other non-captures and castling.
+  // NOTE: The moves are ADDED to the list, so the staged move picker can
+  //       keep the captures it already has in front of them.
+
+  const GameState &state=*pos.currentState;
+  const Bitboard empty=~(state.colourBB[WHITE]|state.colourBB[BLACK]);
+  const Bitboard pawns=state.pieceBB[PAWN]&state.colourBB[pos.currentSide];
+  Bitboard pushes;
+
+  // Pawn pushes and double pushes.
+  if (pos.currentSide==WHITE) {
+    pushes=(pawns>>8)&empty;
+    genPawnTargets(pos,moves,pushes&~RANK_8_BB,8,PAWN_MOVE);
+    genPawnTargets(pos,moves,((pushes&RANK_3_BB)>>8)&empty,16,PAWN_MOVE|TWO_SQUARES);
+  }
+  else {
+    pushes=(pawns<<8)&empty;
+    genPawnTargets(pos,moves,pushes&~RANK_1_BB,-8,PAWN_MOVE);
+    genPawnTargets(pos,moves,((pushes&RANK_6_BB)<<8)&empty,-16,PAWN_MOVE|TWO_SQUARES);
   }
 
-} // End genCaptures.
+  // Do other pieces.
+  genPieceMoves(pos,moves,0,empty);
+
+  // Generate castle moves.
+  genCastles(pos,moves);
+
+} // End genQuiets.
+
+// ==========================================================================
+
+bool isPseudoLegal(const Position &pos,const MoveStruct &move)
+{ // Returns true if genMoves() would generate this move here, so that a move
+  // from elsewhere (the hash move or a killer) can be tried without
+  // generating the moves first. Any legality test is left to makeMove().
+
+  const GameState &state=*pos.currentState;
+  const int source=move.source;
+  const int target=move.target;
+
+  if (source<0 || source>=BOARD_SQUARES || target<0 || target>=BOARD_SQUARES
+      || pos.currentColour[source]!=pos.currentSide
+      || pos.currentColour[target]==pos.currentSide)
+    return false;
+
+  const int piece=pos.currentPiece[source];
+  const bool capture=(pos.currentColour[target]==getOtherSide(pos.currentSide));
+  const Bitboard targetBB=squareBB(target);
+
+  // Castling (the same tests as genCastles()).
+  if (move.type&CASTLE) {
+    if (move.type!=CASTLE || move.promote!=NO_PROMOTION || piece!=KING
+        || pos.currentState->inCheck)
+      return false;
+    if (pos.currentSide==WHITE)
+      return source==60
+             && ((target==62 && state.castlePerm&WHITE_KING_SIDE
+                  && pos.currentColour[61]==NONE && pos.currentColour[62]==NONE)
+                 || (target==58 && state.castlePerm&WHITE_QUEEN_SIDE
+                     && pos.currentColour[57]==NONE && pos.currentColour[58]==NONE
+                     && pos.currentColour[59]==NONE));
+    return source==4
+           && ((target==6 && state.castlePerm&BLACK_KING_SIDE
+                && pos.currentColour[5]==NONE && pos.currentColour[6]==NONE)
+               || (target==2 && state.castlePerm&BLACK_QUEEN_SIDE
+                   && pos.currentColour[1]==NONE && pos.currentColour[2]==NONE
+                   && pos.currentColour[3]==NONE));
+  }
+
+  // Pawns: The type and promotion must be the ones genPush() would give.
+  if (piece==PAWN) {
+    const int forward=(pos.currentSide==WHITE) ? -8 : 8;
+    const bool promotes=(pos.currentSide==WHITE) ? target<=7 : target>=56;
+    if (!(move.type&PAWN_MOVE) || promotes!=((move.type&PROMOTION)!=0)
+        || (promotes ? (move.promote<KNIGHT || move.promote>QUEEN)
+                     : move.promote!=NO_PROMOTION))
+      return false;
+    const int type=move.type&~PROMOTION;
+    if (move.type&EN_PASSANT)
+      return type==(PAWN_MOVE|EN_PASSANT|CAPTURE) && target==state.enPass
+             && (g_pawnAttacks[pos.currentSide][source]&targetBB);
+    if (capture)
+      return type==(PAWN_MOVE|CAPTURE) && (g_pawnAttacks[pos.currentSide][source]&targetBB);
+    if (move.type&TWO_SQUARES)
+      return type==(PAWN_MOVE|TWO_SQUARES) && target==source+2*forward
+             && getRank(source)==((pos.currentSide==WHITE) ? 6 : 1)
+             && pos.currentColour[source+forward]==NONE;
+    return type==PAWN_MOVE && target==source+forward;
+  }
+
+  // Other pieces.
+  if (move.type!=(capture ? CAPTURE : NORMAL_MOVE) || move.promote!=NO_PROMOTION)
+    return false;
+  return (pieceAttacks(piece,source,state.colourBB[WHITE]|state.colourBB[BLACK])&targetBB)!=0;
+
+} // End isPseudoLegal.
 
 // ==========================================================================
 
-void genPush(MoveList &moves,int Source,int Target,int Type)
+void genPush(const Position &pos,MoveList &moves,int Source,int Target,int Type)
 { // This function adds a move to the MoveList given.
   // If it is a Pawn Promotion, it adds 4 moves.
 
   // For pawn promotions, add all four of the possible promotion moves.
   if (Type&PAWN_MOVE 
-      && ((g_currentSide==WHITE && Target<=7)
-          || (g_currentSide==BLACK && Target>=56))) {
+      && ((pos.currentSide==WHITE && Target<=7)
+          || (pos.currentSide==BLACK && Target>=56))) {
 
     // Add the four different types (ie: target peices) of promotion.
     for (int i=KNIGHT;i<=QUEEN;i++) {
@@ -0,0 +1,55 @@
+// *****************************************************************************
+// *                              POSITION OBJECT                              *
+// *****************************************************************************
+// Allocation and copying of the game history held by a Position.
+
+#include "position.h"
+#include "../search_engine/search_config.h"
+#include "../core/error_handling.h"
+
+#include <algorithm>
+#include <string>
+
+// =============================================================================
+
+Position::Position(const SearchConfig& config)
+  : maxPlys(config.maxPlysPerGame), moveNum(0), currentSide(0)  // WHITE
+{ // Allocate game history arrays based on configuration.
+
+  try {
+    gameHistory = std::make_unique<GameState[]>(config.maxPlysPerGame);
+    movesMade = std::make_unique<MoveStruct[]>(config.maxPlysPerGame);
+    repetitionKeys = std::make_unique<HashKey[]>(config.maxPlysPerGame);
+    undoHistory = std::make_unique<UndoRecord[]>(config.maxPlysPerGame);
+  } catch (const std::bad_alloc& e) {
+    FATAL_ERROR("Failed to allocate position arrays: " + std::string(e.what()) +
+                " (requested " + std::to_string(config.maxPlysPerGame) + " plies)");
+  }
+
+  // Initialize pointers to first element for convenient access.
+  setMoveNum(0);
+
+} // End Position::Position.
+
+// =============================================================================
+
+void Position::copyFrom(const Position& other)
+{ // Copy the game so far from another position.
+  // NOTE: The states are self contained, so a flat copy is fine.
+
+  if (static_cast<size_t>(other.moveNum) >= maxPlys)
+    FATAL_ERROR("Position too long to copy (" + std::to_string(other.moveNum) + " plies)");
+
+  std::copy(other.gameHistory.get(),other.gameHistory.get()+other.moveNum+1,
+            gameHistory.get());
+  std::copy(other.movesMade.get(),other.movesMade.get()+other.moveNum,
+            movesMade.get());
+  std::copy(other.repetitionKeys.get(),other.repetitionKeys.get()+other.moveNum+1,
+            repetitionKeys.get());
+  std::copy(other.undoHistory.get(),other.undoHistory.get()+other.moveNum,
+            undoHistory.get());
+
+  currentSide = other.currentSide;
+  setMoveNum(other.moveNum);
+
+} // End Position::copyFrom.
@@ -0,0 +1,69 @@
+// *****************************************************************************
+// *                              POSITION OBJECT                              *
+// *****************************************************************************
+// A game position: the history stack of GameStates, the moves made to reach
+// each one and the side to move. This replaces the old g_gameHistory,
+// g_currentState, g_currentSide (etc) globals, so that several positions can
+// be searched/trained in parallel within one process. Every function that
+// reads or alters the board now takes the Position explicitly.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "types.h"
+#include "constants.h"
+
+// Forward declaration to avoid circular include
+struct SearchConfig;
+
+// =============================================================================
+// POSITION
+// =============================================================================
+
+struct Position {
+
+  // The game/move history (allocated based on SearchConfig::maxPlysPerGame).
+  std::unique_ptr<GameState[]> gameHistory;
+  std::unique_ptr<MoveStruct[]> movesMade;
+  size_t maxPlys;
+
+  // The key of each position, with the castling and en passant codes in
+  // (see storeRepetitionKey()). The repetition tests scan these (8 bytes a
+  // ply), so they never touch the (large) GameStates.
+  std::unique_ptr<HashKey[]> repetitionKeys;
+
+  // What each move lost (see makeMoveInPlace()/unmakeMove()), so a move
+  // made in place can be taken back.
+  std::unique_ptr<UndoRecord[]> undoHistory;
+
+  // The move we are on and the side to move next.
+  int moveNum;
+  int currentSide;
+
+  // These point at the current state (for speed): gameHistory[moveNum],
+  // less any moves made in place since (see makeMoveInPlace()).
+  GameState* currentState;
+  int8_t* currentColour;
+  int8_t* currentPiece;
+
+  // Allocate the history arrays (the position is NOT set up - see initAll()).
+  explicit Position(const SearchConfig& config);
+
+  // Positions own large arrays, so only copy on purpose via copyFrom().
+  Position(const Position&) = delete;
+  Position& operator=(const Position&) = delete;
+
+  // Copy the game so far (ie: states 0..moveNum) from another position.
+  void copyFrom(const Position& other);
+
+  // Point currentState/currentColour/currentPiece at gameHistory[newMoveNum].
+  void setMoveNum(int newMoveNum) noexcept {
+    moveNum = newMoveNum;
+    currentState = &gameHistory[newMoveNum];
+    currentColour = currentState->colour;
+    currentPiece = currentState->piece;
+  }
+
+}; // End Position.
@@ -20,6 +20,15 @@ using HashKey = uint64_t;
 // Clock time for search timing measurements
 using ClockTime = uint64_t;
 
+// Bitboards: one bit per square, using the same numbering as the mailbox
+// arrays (bit 0 = A8, bit 63 = H1)
+using Bitboard = uint64_t;
+
+// Material signatures: how many of each piece each side has, 4 bits for each
+// [Side][Piece] (see materialKeyUnit()), so two positions have the same one
+// if (and only if) they have the same material
+using MaterialKey = uint64_t;
+
 // =============================================================================
 // STRUCTURES
 // =============================================================================
@@ -36,6 +45,8 @@ struct MoveStruct {
 struct GameState {
     int8_t colour[BOARD_SQUARES];     // WHITE, BLACK, or NONE (-1)
     int8_t piece[BOARD_SQUARES];      // PAWN, KNIGHT, etc. or NONE (-1)
+    std::array<Bitboard, 6> pieceBB;  // Squares holding each piece type (both sides)
+    std::array<Bitboard, 2> colourBB; // Squares holding each side's pieces
     uint8_t castlePerm;               // Castling permissions bitfield
     int8_t enPass;                    // En passant square or NO_EN_PASSANT (-1)
     int fiftyCounter;                 // 50-move rule counter
@@ -43,6 +54,21 @@ struct GameState {
     unsigned inCheck : 1;             // Side to move is in check
     unsigned isDraw : 1;              // Position is drawn
     HashKey key;                      // Zobrist hash key
+    HashKey pawnKey;                  // Zobrist key of the pawns alone (for the pawn hash)
+    std::array<std::array<int8_t, 6>, 2> pieceCount; // How many of each [Side][Piece]
+    MaterialKey materialKey;          // Material signature (the same counts)
+};
+
+// What a move made in place loses, so it can be taken back (see unmakeMove())
+struct UndoRecord {
+    HashKey key;                      // The state's keys before the move
+    HashKey pawnKey;
+    int fiftyCounter;
+    uint8_t castlePerm;
+    int8_t enPass;
+    int8_t captured;                  // Piece taken (PAWN for en passant) or NONE
+    bool inCheck;
+    bool isDraw;
 };
 
 // Move list for move generation
@@ -53,10 +79,12 @@ struct MoveList {
     int numMoves;
 };
 
-// Square data for move generation
-struct SquareData {
-    int testSquare;
-    SquareData* skip;
+// Magic bitboard lookup for the sliding attacks of one square
+struct MagicEntry {
+    Bitboard  mask;        // Relevant occupancy (the rays less the board edge)
+    Bitboard  magic;       // Magic multiplier (unused when PEXT is available)
+    Bitboard* attacks;     // This square's slice of the attack table
+    unsigned  shift;       // 64 - number of relevant occupancy bits
 };
 
 // Search data structure
@@ -65,12 +93,18 @@ struct SearchData;
 // Evaluation parameters class
 class EvaluationParameters;
 
-// Hash record for transposition table
-struct HashRecord {
-    MoveStruct move;            // The best move we found here last time.
-    int        score;           // The score of the state.
-    uint8_t    flags;           // Flags describing the search at this state.
-    uint8_t    depth;           // The depth we were at when we searched it.
-    HashKey    key;             // Key to use (stored for quick comparison).
-    HashKey    nextKey;         // Key we have after move (0 otherwise).
+// Transposition table entry (12 bytes, so 5 fit in a 64-byte bucket)
+struct TTEntry {
+    uint32_t keyCheck;          // Top half of the key, XORed with the data below.
+    uint16_t move;              // Packed best move (0 if none).
+    uint8_t  depth;             // The depth we were at when we searched it.
+    uint8_t  genBound;          // Bound flags (low 3 bits) and generation (high 5).
+    int32_t  score;             // The score of the state.
+};
+
+// Transposition table bucket: one cache line of entries for the same index
+constexpr int TT_BUCKET_ENTRIES = 5;
+struct alignas(64) TTBucket {
+    TTEntry entries[TT_BUCKET_ENTRIES];
 };
+static_assert(sizeof(TTBucket) == 64, "TTBucket must be one cache line");
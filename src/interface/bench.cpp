@@ -0,0 +1,134 @@
+// ****************************************************************************
+// *                                 BENCHMARK                                *
+// ****************************************************************************
+// Searches a fixed set of positions to a fixed depth, each on a fresh hash
+// table, and reports the total nodes, time and nodes/second. With one thread
+// the search doesn't depend on the clock, so the total nodes are the same on
+// every run of the same build (and hash size): a change in them means the
+// search changed, a change in the time alone means the speed did.
+
+#include "interface.h"
+#include "../chess_engine/chess_engine.h"
+#include "../search_engine/search_engine.h"
+#include "../search_engine/search_config.h"
+#include "../core/timing.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// =============================================================================
+// CONSTANTS
+// =============================================================================
+
+// The start position, then two from each of a spread of the test files in
+// data/test_positions (openings, middlegames, tactics and endgames).
+static const char* const BENCH_POSITIONS[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r1b1k2r/1pq2ppp/p1n1p3/2b5/P1B1P1n1/2N2N1P/1P2QPP1/R1B2RK1 b kq -",         // larsen1
+  "r4rk1/1p1bpp1p/2pp2p1/p1nP4/2PQP1n1/P1N2NP1/1q3PBP/R3R1K1 w - -",
+  "4k3/p1P3p1/2q1np1p/3N4/8/1Q3PP1/6KP/8 w - -",                               // hardmid
+  "r1b1k3/5p1p/p1p5/3np3/1b2N3/4B3/PPP1BPrP/2KR3R w q -",
+  "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - -",                   // winatchess
+  "1R6/1brk2p1/4p2p/p1P1Pp2/P7/6P1/1P4P1/2R3K1 w - -",
+  "3b1kn1/6p1/3q1p2/4pPP1/pP1pP1N1/3P1NQ1/1rr5/5RRK w - -",                    // kotov
+  "r5k1/1n1bpp2/p5pp/3Pq3/1p2pN2/1P2P3/P1R2PPP/3Q1BK1 w - -",
+  "4k3/8/2pK4/2Pp1b2/7R/7p/8/8 w - -",                                         // speelman
+  "3k4/7p/8/2P5/K7/8/8/8 w - -",
+  "r2k4/1pp2rpp/pn1b1p2/3n4/8/P4NB1/1PP3PP/2KRR3 w - -",                       // reinfeld
+  "rn3R2/pp4p1/2p3k1/8/8/2P1B3/PPP3PP/6K1 w - -",
+  "rnb1k2r/ppp2pp1/5q1p/3p4/1b1P4/2N5/PPQ1PPPP/R3KBNR w KQkq -",               // bellin
+  "1k1r3r/pp1n1ppp/2pqbn2/3p4/3P4/2NBPN1P/PPQ2PP1/1K1R3R w - -",
+  "2krr3/pp3ppp/2b5/6q1/3P4/4N3/PP3PPP/R2Q1RK1 w - -",                         // positional
+  "4r1k1/p1p3pp/npRb4/5p2/3Pp3/P3B1P1/1P2PPBP/6K1 w - -",
+  "r1bq1rk1/pppnbppp/4pn2/3p2B1/2PP4/2N1PN2/PPQ2PPP/R3KB1R b KQ -",            // openings
+  "r1bqk2r/pppn1ppp/3bpn2/3p4/2PP4/2N1PN2/PP3PPP/R1BQKB1R w KQkq -",
+  "3R4/8/8/8/8/6K1/4p3/4k3 w - -",                                             // ece3
+  "8/8/8/K7/4p3/8/5k2/7R b - -",
+};
+
+// =============================================================================
+
+int runBench(int depth,bool jsonOutput,const EvaluationParameters &evalParams)
+{ // Runs the benchmark (see above), printing a table or else JSON.
+  // Returns non-zero if a built-in position couldn't be set up.
+
+  Position pos(g_searchConfig);
+  initAll(pos);
+
+  struct BenchResult {
+    const char* fen;
+    int64_t     nodes;
+    double      seconds;
+    MoveStruct  bestMove;
+    SearchStats stats;
+  };
+  vector<BenchResult> results;
+  int64_t totalNodes=0;
+  double totalSeconds=0.0;
+
+  if (!jsonOutput) {
+    cout << "Bench: " << size(BENCH_POSITIONS) << " positions to depth " << depth
+         << " (" << g_searchConfig.numThreads << " thread(s), "
+         << g_searchConfig.getHashMemoryMB() << " MB hash)" << endl << endl;
+    cout << "  #  Move   Nodes        Time (s)  Nodes/s" << endl;
+  }
+
+  for (const char* fen : BENCH_POSITIONS) {
+    if (setupFromFEN(pos,fen)) {
+      cerr << "Bench: invalid built-in position: " << fen << endl;
+      return 1;
+    }
+
+    // A fresh hash table and search data for each (not timed).
+    newGame();
+
+    const double start=getWallClockTime();
+    const MoveStruct bestMove=think(pos,depth,INFINITE_TIME,false,false,0.0,evalParams);
+    const double seconds=getWallClockTime()-start;
+    const int64_t nodes=getLastSearchNodes();
+
+    results.push_back({fen,nodes,seconds,bestMove,getLastSearchStats()});
+    totalNodes+=nodes;
+    totalSeconds+=seconds;
+
+    if (!jsonOutput) {
+      cout << setw(3) << results.size() << "  " << left << setw(6) << moveToUCI(bestMove)
+           << ' ' << setw(12) << nodes << right << ' '
+           << fixed << setprecision(3) << setw(8) << seconds << "  "
+           << setprecision(0) << static_cast<double>(nodes)/max(seconds,1e-9) << endl;
+    }
+  }
+
+  const double nodesPerSecond=static_cast<double>(totalNodes)/max(totalSeconds,1e-9);
+
+  if (jsonOutput) {
+    cout << "{\n  \"depth\": " << depth
+         << ",\n  \"threads\": " << g_searchConfig.numThreads
+         << ",\n  \"hash_mb\": " << g_searchConfig.getHashMemoryMB()
+         << ",\n  \"positions\": [\n";
+    for (size_t i=0;i<results.size();i++) {
+      cout << "    {\"fen\": \"" << results[i].fen << "\", \"bestmove\": \""
+           << moveToUCI(results[i].bestMove) << "\", \"nodes\": " << results[i].nodes
+           << ", \"seconds\": " << fixed << setprecision(6) << results[i].seconds
+           << ", \"stats\": ";
+      printSearchStats(results[i].stats,cout,true);
+      cout << "    }" << (i+1<results.size() ? ",\n" : "\n");
+    }
+    cout << "  ],\n  \"nodes\": " << totalNodes
+         << ",\n  \"seconds\": " << fixed << setprecision(6) << totalSeconds
+         << ",\n  \"nps\": " << setprecision(0) << nodesPerSecond << "\n}" << endl;
+  }
+  else {
+    cout << endl;
+    cout << "Total Nodes    : " << totalNodes << endl;
+    cout << "Total Time     : " << fixed << setprecision(3) << totalSeconds << " s" << endl;
+    cout << "Nodes/Second   : " << setprecision(0) << nodesPerSecond << endl;
+  }
+
+  return 0;
+
+} // End runBench.
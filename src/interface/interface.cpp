@@ -11,7 +11,7 @@
 
 using namespace std;
 
-void printBoard(int sideUpBoard)
+void printBoard(const Position &pos,int sideUpBoard)
 { // Prints the current board.
 
   // The piece letters for printing.
@@ -21,7 +21,7 @@ void printBoard(int sideUpBoard)
   if (sideUpBoard==WHITE) {
     cout << endl << "8|";
     for (int i=0;i<BOARD_SQUARES;i++) {
-      if (g_gameHistory[g_moveNum].colour[i]==NONE) {
+      if (pos.currentState->colour[i]==NONE) {
         if ((i/8)%2==0) {
           if (i%2==0)
             cout << " .";
@@ -35,10 +35,10 @@ void printBoard(int sideUpBoard)
             cout << " .";
         }
       }
-      else if (g_gameHistory[g_moveNum].colour[i]==WHITE)
-        cout << ' ' << static_cast<char>(PIECE_CHAR[g_gameHistory[g_moveNum].piece[i]]);
-      else if (g_gameHistory[g_moveNum].colour[i]==BLACK)
-        cout << ' ' << static_cast<char>(PIECE_CHAR[g_gameHistory[g_moveNum].piece[i]]
+      else if (pos.currentState->colour[i]==WHITE)
+        cout << ' ' << static_cast<char>(PIECE_CHAR[pos.currentState->piece[i]]);
+      else if (pos.currentState->colour[i]==BLACK)
+        cout << ' ' << static_cast<char>(PIECE_CHAR[pos.currentState->piece[i]]
                                +('a'-'A'));
 
       if ((i+1)%8==0 && i!=63)
@@ -52,7 +52,7 @@ void printBoard(int sideUpBoard)
   else {
     cout << endl << "1|";
     for (int i=63;i>=0;i--) {
-      if (g_gameHistory[g_moveNum].colour[i]==NONE) {
+      if (pos.currentState->colour[i]==NONE) {
         if ((i/8)%2==0) {
           if (i%2==0)
             cout << " .";
@@ -66,10 +66,10 @@ void printBoard(int sideUpBoard)
             cout << " .";
         }
       }
-      else if (g_gameHistory[g_moveNum].colour[i]==WHITE)
-        cout << ' ' << static_cast<char>(PIECE_CHAR[g_gameHistory[g_moveNum].piece[i]]);
-      else if (g_gameHistory[g_moveNum].colour[i]==BLACK)
-        cout << ' ' << static_cast<char>(PIECE_CHAR[g_gameHistory[g_moveNum].piece[i]]
+      else if (pos.currentState->colour[i]==WHITE)
+        cout << ' ' << static_cast<char>(PIECE_CHAR[pos.currentState->piece[i]]);
+      else if (pos.currentState->colour[i]==BLACK)
+        cout << ' ' << static_cast<char>(PIECE_CHAR[pos.currentState->piece[i]]
                                +('a'-'A'));
 
       if ((i)%8==0 && i!=0 && i!=63)
@@ -80,7 +80,7 @@ void printBoard(int sideUpBoard)
   }
 
   // Print if the move discloses check.
-  if (g_gameHistory[g_moveNum].inCheck)
+  if (pos.currentState->inCheck)
     cout << "Check..." << endl << endl;
 
 } // End printBoard.
@@ -276,6 +276,15 @@ void printLine(SearchData &sd,MoveStruct &line,int moveScore,char boundType)
   // '&' = New root move found on search.
   // '.' = Final move, ply completed.
   // '%' = Final move, ply partially completed (move usable though!).
+  // '+'/'-' = Root failed high/low.
+  // NOTE: For the UCI driver this is sent as an "info" line instead.
+
+  if (sd.uciOutput) {
+    printUciInfo(sd,line,moveScore,boundType);
+    return;
+  }
+
+  Position &pos=sd.pos;
 
   int j;
 
@@ -287,7 +296,7 @@ void printLine(SearchData &sd,MoveStruct &line,int moveScore,char boundType)
     std::cout << "| " << std::setw(2) << sd.iterDepth << boundType << " | "
               << std::fixed << std::setprecision(2) << std::setw(9)
               << timeDiffToSeconds(sd.startTime, getTime()) << " | "
-              << std::setw(10) << sd.totalNodesSearched << " | "
+              << std::setw(10) << getTotalNodes(sd) << " | "
               << std::setw(8) << std::setprecision(4)
               << (double)moveScore/(double)PIECE_VALUE[PAWN] << " |";
   }
@@ -295,22 +304,21 @@ void printLine(SearchData &sd,MoveStruct &line,int moveScore,char boundType)
     std::cout << "| " << std::setw(2) << sd.iterDepth << boundType << " | "
               << std::fixed << std::setprecision(2) << std::setw(9)
               << timeDiffToSeconds(sd.startTime, getTime()) << " | "
-              << std::setw(10) << sd.totalNodesSearched << " | "
+              << std::setw(10) << getTotalNodes(sd) << " | "
               << std::setw(7) << getMateIn(moveScore) << "# |";
   }
 
   // Print the PV from the hash if using it!.
   MoveStruct pvMove;
   int tempScore;
-  HashKey nextKey;
 
   // Get the first move from the PV[0][0] slot.
   cout << ' ';
   printMove(line);
 
   // Make the move and see if we are in check.
-  makeMove(line);
-  if (g_gameHistory[g_moveNum].inCheck) {
+  makeMove(pos,line);
+  if (pos.currentState->inCheck) {
 
     // Is it a matting move or check?
     //if (labs(Score)>(WIN_SCORE-100))
@@ -323,7 +331,7 @@ void printLine(SearchData &sd,MoveStruct &line,int moveScore,char boundType)
   // Make the initial move as it won't of been stored in the hash yet (in PV).
   for (j=1;;j++) {
 
-    if (ttGet(sd,0,0,tempScore,pvMove,nextKey)==0) {
+    if (ttGet(sd,0,0,tempScore,pvMove)==0) {
       cout << " ...";
       break;
     }
@@ -333,19 +341,19 @@ void printLine(SearchData &sd,MoveStruct &line,int moveScore,char boundType)
       break;
 
     // Test for repetition to stop cycles from causeing crashes!
-    if (g_currentState->isDraw==true) {
+    if (pos.currentState->isDraw==true) {
       cout << " ... (HASH DRAW)";
       break;
     }
 
     // Test for repetition to stop cycles from causeing crashes!
-    if (testSingleRepetition(g_moveNum-j)==true) {
+    if (testSingleRepetition(pos,pos.moveNum-j)==true) {
       cout << " ... (HASH CYCLE)";
       break;
     }
 
     // Generate moves (this won't interfere as were not at search's ply.
-    genMoves(moves);
+    genMoves(pos,moves);
 
     // See if the move we got is correct?
     bool found=false;
@@ -366,17 +374,11 @@ void printLine(SearchData &sd,MoveStruct &line,int moveScore,char boundType)
     }
 
     // Make the move and check we can.
-    if (!makeMove(pvMove)) {
+    if (!makeMove(pos,pvMove)) {
       cout << " ... (HASH MOVE ILLEGAL!)";      // Ilegal move.
       break;
     }
 
-    // Make sure the keys are the same.
-    if (g_currentState->key!=nextKey) {
-      cout << " ... (KEY CLASH!)";
-      break;
-    }
-
     // Print the move.
     if (j==sd.iterDepth && boundType!='%')
       cout << " :";
@@ -384,7 +386,7 @@ void printLine(SearchData &sd,MoveStruct &line,int moveScore,char boundType)
     printMove(pvMove);
 
     // See if we are in check.
-    if (g_gameHistory[g_moveNum].inCheck) {
+    if (pos.currentState->inCheck) {
 
       // Is it a matting move?
       //if (j==(LineLength-1) && labs(Score)>(WIN_SCORE-100))
@@ -405,13 +407,13 @@ void printLine(SearchData &sd,MoveStruct &line,int moveScore,char boundType)
 
   // Take all the moves back.
   for (;j>0;j--)
-    takeMoveBack();
+    takeMoveBack(pos);
 
 } // End printLine.
 
 // **************************************************************************
 
-int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
+int playGame(Position &pos,int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
              bool showOutput,bool showThinking,double randomSwing,
              const EvaluationParameters &epw,const EvaluationParameters &epb)
 { // This function basically is  an infinite loop that either calls Think() 
@@ -446,8 +448,11 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
     ComputerSide=NONE;          // Both sides are computers, so no single computer side
 
   // Init all a data to a new game and gererate the initial set of moves.
-  initAll();
-  genMoves(Moves);
+  initAll(pos);
+  genMoves(pos,Moves);
+
+  // Forget the last game's hash table entries, killers, history (etc).
+  newGame();
 
   // Loop until game over.
   for (;;) {
@@ -455,20 +460,20 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
     // Print the board so we can see it.
     if (showOutput) {
       if (ComputerSide==WHITE && modeOfPlay!=TWO_COMPUTERS)
-        printBoard(BLACK);           // If human vs white the print black up.
+        printBoard(pos,BLACK);           // If human vs white the print black up.
       else
-        printBoard(WHITE);           // Print the board for user to see.
+        printBoard(pos,WHITE);           // Print the board for user to see.
     }
 
     // Check for games 50-move-rule ending condition.
-    if (g_gameHistory[g_moveNum].fiftyCounter>=50)
+    if (pos.currentState->fiftyCounter>=50)
       return FIFTY_MOVE_RULE;        // 50 moves and no pawn move/capture.
 
     // Check for repetition draw.
-    if (testRepetition())
+    if (testRepetition(pos))
       return THREE_IDENTICLE_POS;    // Have had three identicle positions.
 
-    if (testNotEnoughMaterial())
+    if (testNotEnoughMaterial(pos))
       return NOT_ENOUGH_MATERIAL;    // Not enough to win.
 
     // No Moves found AT NOT yet.
@@ -479,8 +484,8 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
     // Also count how many are legal to see if only one is, then the computer
     // does not need to think (ie just does the move!).
     for (moveIndex=0;moveIndex<Moves.numMoves;moveIndex++) {
-      if (makeMove(Moves.moves[moveIndex])) {
-        takeMoveBack();              // Take it back as were only testing.
+      if (makeMove(pos,Moves.moves[moveIndex])) {
+        takeMoveBack(pos);              // Take it back as were only testing.
         Found=true;                  // Have found one.
         NumFound++;                  // One more move found.
       }
@@ -507,8 +512,8 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
       }
 	  */
 
-      if (g_gameHistory[g_moveNum].inCheck) {
-        if (getOtherSide(g_currentSide)==BLACK)
+      if (pos.currentState->inCheck) {
+        if (getOtherSide(pos.currentSide)==BLACK)
           return BLACK_MATES;         // BLACK has Mated.
         else
           return WHITE_MATES;        // White has Mated.
@@ -520,16 +525,16 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
 
     // Print move number an person to move, after game end checking.
     if (showOutput) {
-      if (g_currentSide==WHITE)
-        cout << "Move number " << g_moveNum << " - White to move next." << endl
+      if (pos.currentSide==WHITE)
+        cout << "Move number " << pos.moveNum << " - White to move next." << endl
              << endl;
       else
-        cout << "Move number " << g_moveNum << " - Black to move next." << endl
+        cout << "Move number " << pos.moveNum << " - Black to move next." << endl
              << endl;
     }
 
     // Check if it's the computer's turn.
-    if (modeOfPlay==TWO_COMPUTERS || g_currentSide==ComputerSide) {
+    if (modeOfPlay==TWO_COMPUTERS || pos.currentSide==ComputerSide) {
 
       // Only bother if there are more than one move to choose from.
       //if (NumFound==1) {
@@ -554,12 +559,12 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
       //else {
 
         // Call think.
-        if (g_currentSide==WHITE) {
-          ComputersMove=think(searchDepth,maxTimeSeconds,showOutput,
+        if (pos.currentSide==WHITE) {
+          ComputersMove=think(pos,searchDepth,maxTimeSeconds,showOutput,
                               showThinking,randomSwing,epw);
         }
         else {
-          ComputersMove=think(searchDepth,maxTimeSeconds,showOutput,
+          ComputersMove=think(pos,searchDepth,maxTimeSeconds,showOutput,
                               showThinking,randomSwing,epb);
         }
 
@@ -578,9 +583,9 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
                   << '.' << '\n';
       }
 
-      makeMove(ComputersMove);
+      makeMove(pos,ComputersMove);
 
-      genMoves(Moves);                 // Re-Generate the moves now.
+      genMoves(pos,Moves);                 // Re-Generate the moves now.
       continue;                        // Skip out for next move.
     }
 
@@ -592,7 +597,7 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
 
     // First check if the user has Retired.
     if (StringBuffer=="Q" || StringBuffer=="q") {
-      if (g_currentSide==WHITE)
+      if (pos.currentSide==WHITE)
         return WHITE_RETIRES;
       else
         return BLACK_RETIRES;
@@ -602,18 +607,18 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
     if (StringBuffer=="t" || StringBuffer=="T") {
 
       // Take the 'chess' Move (ie: two plys!) back, if moves to be taken back.
-      if (g_moveNum<2) {
+      if (pos.moveNum<2) {
         cout << "\aNo (2-Ply) moves to take back." << endl;
         continue;
       }
       else {
-        takeMoveBack();                 // Take back computer's move.
-        takeMoveBack();                 // Take back your move.
+        takeMoveBack(pos);                 // Take back computer's move.
+        takeMoveBack(pos);                 // Take back your move.
         cout << "Move has been taken back." << endl;
       }
 
       // Generate the moves again.
-      genMoves(Moves);
+      genMoves(pos,Moves);
       continue;
 
     }
@@ -662,11 +667,11 @@ int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
     }
 
     // If we have not found a valid move then re-try. 
-    if (!Found || !makeMove(Moves.moves[moveIndex]))
+    if (!Found || !makeMove(pos,Moves.moves[moveIndex]))
       cout << "\aIlegal Move. Please try again." << endl;
 
     // Generate the moves again. (NEEDED ALWAYS?)
-    genMoves(Moves);
+    genMoves(pos,Moves);
 
   } // End for-ever run game running loop.
 
@@ -10,6 +10,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <string>
 
 // =============================================================================
 // FORWARD DECLARATIONS
@@ -17,6 +18,7 @@
 
 struct SearchData;
 struct MoveStruct;
+struct Position;
 class EvaluationParameters;
 
 // =============================================================================
@@ -24,20 +26,29 @@ class EvaluationParameters;
 // =============================================================================
 
 // Function from parse_pgn.cpp
-bool convertFromSAN(char* sanMove, MoveStruct& algMove);
+bool convertFromSAN(Position& pos, char* sanMove, MoveStruct& algMove);
+
+// Functions from uci.cpp
+bool convertFromUCI(Position& pos, const std::string& uciMove, MoveStruct& algMove);
+std::string moveToUCI(const MoveStruct& move);
+void printUciInfo(SearchData& sd, const MoveStruct& line, int moveScore, char boundType);
+void uciLoop(EvaluationParameters& evalParams, const char* evalSetFile);
+
+// Function from bench.cpp
+int runBench(int depth, bool jsonOutput, const EvaluationParameters& evalParams);
 
 // =============================================================================
 // PROTOTYPES:
 // =============================================================================
 
-void printBoard(int sideUpBoard);
+void printBoard(const Position &pos,int sideUpBoard);
 void printMove(const MoveStruct &move);
 void writeMinimalHeader(int numMoves,int gameResult,std::ofstream &outFile);
 void readMinimalHeader(int &numMoves,int &gameResult,std::ifstream &inFile);
 void writeMinimalMove(const MoveStruct &move,bool isQuiescent,std::ofstream &outFile);
 void readMinimalMove(MoveStruct &move,uint8_t &isQuiescent,std::ifstream &inFile);
 void printLine(SearchData &sd,MoveStruct &line,int moveScore,char boundType);
-int playGame(int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
+int playGame(Position &pos,int modeOfPlay,int searchDepth,double maxTimeSeconds,bool useBell,
              bool showOutput,bool showThinking,double randomSwing,
              const EvaluationParameters &epw,const EvaluationParameters &epb);
 
@@ -18,7 +18,7 @@
 
 using namespace std;
 
-bool convertFromSAN(char* sanMove,MoveStruct& algMove)
+bool convertFromSAN(Position &pos,char* sanMove,MoveStruct& algMove)
 { // This is the better, more reliable version.
 
   // The move list.
@@ -30,8 +30,9 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
   // Used to find what the piece is we are looking for.
   int desiredPeice;
 
-  // Generate the moves for the current position.
-  genMoves(moves);
+  // Generate the (legal) moves for the current position, so a pinned piece
+  // can't match a move that doesn't say which piece.
+  genLegalMoves(pos,moves);
 
   // 1. Check to see if it's a castling move.
   //    NOTE: Also check to see if 0's have been used instead of O's.
@@ -41,22 +42,22 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
           && sanMove[3]=='-' && sanMove[4]=='0')) {
 
     // If the king is on the 'e' file then this is the queen side castle.
-    if (getFile(g_currentState->kingSquare[g_currentSide])==4) {
-      algMove.source=g_currentState->kingSquare[g_currentSide];
-      algMove.target=g_currentState->kingSquare[g_currentSide]-2;
+    if (getFile(pos.currentState->kingSquare[pos.currentSide])==4) {
+      algMove.source=pos.currentState->kingSquare[pos.currentSide];
+      algMove.target=pos.currentState->kingSquare[pos.currentSide]-2;
       algMove.type=CASTLE;
     }
 
     // Else it is the other way around (ie King on 'd' file).
     else {
-      algMove.source=g_currentState->kingSquare[g_currentSide];
-      algMove.target=g_currentState->kingSquare[g_currentSide]+2;
+      algMove.source=pos.currentState->kingSquare[pos.currentSide];
+      algMove.target=pos.currentState->kingSquare[pos.currentSide]+2;
       algMove.type=CASTLE;
     }
 
     // Check to see if the move is legal.
-    if (makeMove(algMove)) {
-      takeMoveBack();
+    if (makeMove(pos,algMove)) {
+      takeMoveBack(pos);
       return false;                            // Move O.K.
     }
     else {
@@ -72,22 +73,22 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
       || (sanMove[0]=='0' && sanMove[1]=='-' && sanMove[2]=='0')) {
 
     // If the king is on the 'e' file then this is the king side castle.
-    if (getFile(g_currentState->kingSquare[g_currentSide])==4) {
-      algMove.source=g_currentState->kingSquare[g_currentSide];
-      algMove.target=g_currentState->kingSquare[g_currentSide]+2;
+    if (getFile(pos.currentState->kingSquare[pos.currentSide])==4) {
+      algMove.source=pos.currentState->kingSquare[pos.currentSide];
+      algMove.target=pos.currentState->kingSquare[pos.currentSide]+2;
       algMove.type=CASTLE;
     }
 
     // Else it is the other way around (ie King on 'd' file).
     else {
-      algMove.source=g_currentState->kingSquare[g_currentSide];
-      algMove.target=g_currentState->kingSquare[g_currentSide]-2;
+      algMove.source=pos.currentState->kingSquare[pos.currentSide];
+      algMove.target=pos.currentState->kingSquare[pos.currentSide]-2;
       algMove.type=CASTLE;
     }
 
     // Check to see if the move is legal.
-    if (makeMove(algMove)) {
-      takeMoveBack();
+    if (makeMove(pos,algMove)) {
+      takeMoveBack(pos);
       return false;                            // Move O.K.
     }
     else {
@@ -157,7 +158,7 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
 
   // If the source piece is the king - easy, as only 1 king.
   if (sanMove[0]=='k') {
-    algMove.source=g_currentState->kingSquare[g_currentSide];
+    algMove.source=pos.currentState->kingSquare[pos.currentSide];
   }
 
   // If we have both the file and rank specifier, then easy too.
@@ -186,7 +187,7 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
            || (rankSpec!='0' 
                && getRank(moves.moves[i].source)==7-(rankSpec-'1')))
           && moves.moves[i].target==algMove.target
-          && g_currentPiece[moves.moves[i].source]==desiredPeice) {
+          && pos.currentPiece[moves.moves[i].source]==desiredPeice) {
 
         // Set the source square.
         algMove.source=moves.moves[i].source;
@@ -197,8 +198,8 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
           algMove.type|=CAPTURE;
 
         // Check to see if the move is legal.
-        if (makeMove(algMove)) {
-          takeMoveBack();
+        if (makeMove(pos,algMove)) {
+          takeMoveBack(pos);
           return false;                         // Move O.K.
         }
         else {
@@ -223,10 +224,10 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
 
     // Find the rank of the pawn (from the current side).
     int rank;
-    if (g_currentSide==WHITE) {
+    if (pos.currentSide==WHITE) {
       for (int i=0;i<64;i++)
-        if (g_currentPiece[i]==PAWN
-            && g_currentColour[i]==WHITE
+        if (pos.currentPiece[i]==PAWN
+            && pos.currentColour[i]==WHITE
             && getFile(i)==file) {
           rank=getRank(i);
           break;
@@ -234,8 +235,8 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
     }
     else {
       for (int i=0;i<64;i++)
-        if (g_currentPiece[i]==PAWN
-            && g_currentColour[i]==BLACK
+        if (pos.currentPiece[i]==PAWN
+            && pos.currentColour[i]==BLACK
             && getFile(i)==file) {
           rank=getRank(i);
           break;
@@ -250,8 +251,8 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
       algMove.type|=CAPTURE;
 
     // Check to see if the move is legal.
-    if (makeMove(algMove)) {
-      takeMoveBack();
+    if (makeMove(pos,algMove)) {
+      takeMoveBack(pos);
       return false;                             // Move O.K.
     }
     else {
@@ -264,8 +265,8 @@ bool convertFromSAN(char* sanMove,MoveStruct& algMove)
   // 6. Must be a normal piece move then.
 
   // Check to see if the move is legal.
-  if (makeMove(algMove)) {
-    takeMoveBack();
+  if (makeMove(pos,algMove)) {
+    takeMoveBack(pos);
     return false;                               // Move O.K.
   }
   else {
@@ -0,0 +1,575 @@
+// ****************************************************************************
+// *                            UCI PROTOCOL DRIVER                           *
+// ****************************************************************************
+// Talks the UCI protocol (see docs/uci-engine-interface.txt) on stdin/stdout.
+// The search runs on its own thread, so that "stop", "ponderhit" and
+// "isready" are answered straight away while it is thinking.
+
+#include "interface.h"
+#include "../chess_engine/chess_engine.h"
+#include "../search_engine/search_engine.h"
+#include "../search_engine/search_config.h"
+#include "../core/timing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// =============================================================================
+// CONSTANTS
+// =============================================================================
+
+constexpr const char* UCI_ENGINE_NAME = "Chess";
+constexpr const char* UCI_ENGINE_AUTHOR = "Juk Armstrong";
+constexpr const char* UCI_START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+constexpr int MIN_HASH_SIZE_MB = 1;
+constexpr int MAX_HASH_SIZE_MB = 65536;
+
+// Time control: This much is held back for the GUI's lag (the clock is
+// shared out by allocateTime(), see time_manager.cpp).
+constexpr int DEFAULT_MOVE_OVERHEAD_MS = 30;
+constexpr int MAX_MOVE_OVERHEAD_MS = 5000;
+
+// =============================================================================
+// SEARCH THREAD STATE
+// =============================================================================
+
+// The search thread and (once the ponder move is hit) its timer.
+static thread searchThread;
+static thread timerThread;
+
+// Set to stop the search (think() checks it after the first ply).
+static atomic<bool> stopSearch{false};
+
+// These are guarded by stateMutex (and waited on with stateChanged).
+static mutex stateMutex;
+static condition_variable stateChanged;
+static bool pondering=false;             // "go ponder" with no "ponderhit" yet.
+static bool infiniteSearch=false;        // "go infinite" (wait for "stop").
+static bool searchDone=true;             // think() has returned.
+static double ponderSeconds=0.0;         // Time to use after the "ponderhit".
+
+// The search thread's info lines and our replies mustn't interleave.
+static mutex outputMutex;
+
+// The last PV's first two moves (the second is what we ponder on).
+static MoveStruct pvBestMove{NONE,NONE,NORMAL_MOVE,NO_PROMOTION};
+static MoveStruct pvPonderMove{NONE,NONE,NORMAL_MOVE,NO_PROMOTION};
+
+static int moveOverheadMs=DEFAULT_MOVE_OVERHEAD_MS;
+
+// =============================================================================
+
+static void sendLine(const string &line)
+{ // Send a line to the GUI (flushed, as the GUI is waiting for it).
+
+  lock_guard<mutex> lock(outputMutex);
+  cout << line << endl;
+
+} // End sendLine.
+
+// =============================================================================
+
+string moveToUCI(const MoveStruct &move)
+{ // Long algebraic notation, eg: "e2e4", "e1g1" (castling) and "e7e8q".
+
+  if (move.source<0 || move.target<0)
+    return "0000";                               // The UCI null move.
+
+  string uciMove;
+  uciMove+=static_cast<char>(getFile(move.source)+'a');
+  uciMove+=static_cast<char>('8'-getRank(move.source));
+  uciMove+=static_cast<char>(getFile(move.target)+'a');
+  uciMove+=static_cast<char>('8'-getRank(move.target));
+  if (move.type&PROMOTION) {
+    if (move.promote==QUEEN)
+      uciMove+='q';
+    else if (move.promote==ROOK)
+      uciMove+='r';
+    else if (move.promote==BISHOP)
+      uciMove+='b';
+    else if (move.promote==KNIGHT)
+      uciMove+='n';
+  }
+  return uciMove;
+
+} // End moveToUCI.
+
+// =============================================================================
+
+bool convertFromUCI(Position &pos,const string &uciMove,MoveStruct &algMove)
+{ // Find the legal move (with its type flags) for a long algebraic move.
+  // Returns true on error (ie: not a legal move), as for convertFromSAN().
+
+  if (uciMove.size()<4 || uciMove[0]<'a' || uciMove[0]>'h' || uciMove[1]<'1' || uciMove[1]>'8'
+      || uciMove[2]<'a' || uciMove[2]>'h' || uciMove[3]<'1' || uciMove[3]>'8')
+    return true;
+
+  const int source=getSquare(uciMove[0],uciMove[1]);
+  const int target=getSquare(uciMove[2],uciMove[3]);
+  int promote=NO_PROMOTION;
+  if (uciMove.size()>4) {
+    switch (uciMove[4]) {
+      case 'q': promote=QUEEN;  break;
+      case 'r': promote=ROOK;   break;
+      case 'b': promote=BISHOP; break;
+      case 'n': promote=KNIGHT; break;
+      default:  return true;
+    }
+  }
+
+  MoveList moves;
+  genLegalMoves(pos,moves);
+  for (int i=0;i<moves.numMoves;i++) {
+    MoveStruct &move=moves.moves[i];
+    if (move.source!=source || move.target!=target)
+      continue;
+    if ((move.type&PROMOTION) ? move.promote!=promote : promote!=NO_PROMOTION)
+      continue;
+    algMove=move;
+    return false;
+  }
+
+  return true;                                   // No such move.
+
+} // End convertFromUCI.
+
+// =============================================================================
+
+void printUciInfo(SearchData &sd,const MoveStruct &line,int moveScore,char boundType)
+{ // Send an "info" line for the thinking (called by printLine() in UCI mode).
+  // The PV is read back from the hash table, as for printLine().
+
+  Position &pos=sd.pos;
+  vector<MoveStruct> pv;
+
+  // Walk the PV, stopping at anything odd (as printLine() does).
+  if (line.source>=0) {
+    MoveStruct firstMove=line;
+    if (makeMove(pos,firstMove)) {
+      pv.push_back(firstMove);
+      MoveStruct pvMove;
+      int tempScore;
+      MoveList moves;
+      for (;;) {
+        if (ttGet(sd,0,0,tempScore,pvMove)==0 || pvMove.source==-1)
+          break;
+        if (pos.currentState->isDraw
+            || testSingleRepetition(pos,pos.moveNum-static_cast<int>(pv.size())))
+          break;
+        genMoves(pos,moves);
+        bool found=false;
+        for (int i=0;i<moves.numMoves && !found;i++) {
+          found=(moves.moves[i].source==pvMove.source
+                 && moves.moves[i].target==pvMove.target
+                 && moves.moves[i].type==pvMove.type
+                 && moves.moves[i].promote==pvMove.promote);
+        }
+        if (!found || !makeMove(pos,pvMove))
+          break;
+        pv.push_back(pvMove);
+      }
+      for (size_t i=0;i<pv.size();i++)
+        takeMoveBack(pos);
+    }
+  }
+
+  // Build the line.
+  ostringstream info;
+  info << "info depth " << sd.iterDepth << " score ";
+  if (isMateScore(moveScore)) {
+    const int matePlies=getMateIn(moveScore);
+    info << "mate " << (matePlies>0 ? (matePlies+1)/2 : -((1-matePlies)/2));
+  }
+  else {
+    info << "cp " << (moveScore*100)/PIECE_VALUE[PAWN];
+  }
+  if (boundType=='+')
+    info << " lowerbound";
+  else if (boundType=='-')
+    info << " upperbound";
+
+  const int64_t nodes=getTotalNodes(sd);
+  const double seconds=getWallClockTime()-sd.wallClockStart;
+  info << " nodes " << nodes
+       << " nps " << (seconds>0.0 ? static_cast<int64_t>(static_cast<double>(nodes)/seconds) : 0)
+       << " hashfull " << ttHashFull()
+       << " time " << static_cast<int64_t>(seconds*1000.0);
+  if (!pv.empty()) {
+    info << " pv";
+    for (const auto &move : pv)
+      info << ' ' << moveToUCI(move);
+  }
+
+  // Remember the PV's reply to the best move, to ponder on.
+  if (boundType=='&' || boundType=='.' || boundType=='%') {
+    lock_guard<mutex> lock(outputMutex);
+    pvBestMove=pv.empty() ? line : pv[0];
+    pvPonderMove=(pv.size()>1) ? pv[1] : MoveStruct{NONE,NONE,NORMAL_MOVE,NO_PROMOTION};
+  }
+
+  sendLine(info.str());
+
+} // End printUciInfo.
+
+// =============================================================================
+
+static void startTimer(double seconds)
+{ // Stop the search after this long, unless it finishes first.
+  // NOTE: Called with stateMutex held.
+
+  timerThread=thread([seconds]() {
+    unique_lock<mutex> lock(stateMutex);
+    if (!stateChanged.wait_for(lock,chrono::duration<double>(seconds),[]{ return searchDone; }))
+      stopSearch=true;
+  });
+
+} // End startTimer.
+
+// =============================================================================
+
+static void stopAndWait(void)
+{ // Stop any search (it still sends its best move) and wait for it.
+
+  {
+    lock_guard<mutex> lock(stateMutex);
+    stopSearch=true;
+  }
+  stateChanged.notify_all();
+  if (searchThread.joinable())
+    searchThread.join();
+  if (timerThread.joinable())
+    timerThread.join();
+
+} // End stopAndWait.
+
+// =============================================================================
+
+static void searchWorker(const Position &pos,SearchLimits limits,
+                         const EvaluationParameters &evalParams)
+{ // The search thread: Think, then send the best move (and what to ponder).
+
+  const MoveStruct bestMove=think(pos,limits,false,false,0.0,evalParams);
+
+  {
+    unique_lock<mutex> lock(stateMutex);
+    searchDone=true;
+    stateChanged.notify_all();
+
+    // Never send the best move while pondering or in infinite mode.
+    stateChanged.wait(lock,[]{ return stopSearch.load() || (!pondering && !infiniteSearch); });
+  }
+
+  string reply="bestmove "+moveToUCI(bestMove);
+  {
+    lock_guard<mutex> lock(outputMutex);
+    if (bestMove.source>=0 && pvPonderMove.source>=0
+        && pvBestMove.source==bestMove.source && pvBestMove.target==bestMove.target
+        && pvBestMove.promote==bestMove.promote)
+      reply+=" ponder "+moveToUCI(pvPonderMove);
+  }
+  sendLine(reply);
+
+} // End searchWorker.
+
+// =============================================================================
+
+static bool hasLegalMove(Position &pos)
+{ // Returns true if the side to move has any legal move.
+
+  MoveList moves;
+  genLegalMoves(pos,moves);
+  return moves.numMoves>0;
+
+} // End hasLegalMove.
+
+// =============================================================================
+
+static void uciGo(Position &pos,istringstream &args,const EvaluationParameters &evalParams)
+{ // Parse "go ..." and start the search thread.
+  // NOTE: "searchmoves" is accepted but ignored (all moves are searched).
+
+  int64_t timeLeft[2]={-1,-1},increment[2]={0,0};
+  int movesToGo=0;
+  double moveTime=-1.0;
+  bool ponder=false;
+  SearchLimits limits;
+  limits.stop=&stopSearch;
+  limits.uciOutput=true;
+
+  string token;
+  while (args >> token) {
+    if (token=="wtime")
+      args >> timeLeft[WHITE];
+    else if (token=="btime")
+      args >> timeLeft[BLACK];
+    else if (token=="winc")
+      args >> increment[WHITE];
+    else if (token=="binc")
+      args >> increment[BLACK];
+    else if (token=="movestogo")
+      args >> movesToGo;
+    else if (token=="depth")
+      args >> limits.depth;
+    else if (token=="nodes")
+      args >> limits.nodes;
+    else if (token=="mate") {
+      int mateIn=0;
+      args >> mateIn;
+      limits.depth=std::max(1,2*mateIn-1);       // Mate in N is 2N-1 plies.
+    }
+    else if (token=="movetime") {
+      int64_t ms=0;
+      args >> ms;
+      moveTime=std::max(static_cast<double>(ms-moveOverheadMs)/1000.0,MIN_SEARCH_SECONDS);
+    }
+    else if (token=="infinite")
+      limits.infinite=true;
+    else if (token=="ponder")
+      ponder=true;
+  }
+
+  // Nothing to search if the game is over (think() expects a move to play).
+  if (!hasLegalMove(pos)) {
+    sendLine(pos.currentState->inCheck ? "info depth 0 score mate 0"
+                                       : "info depth 0 score cp 0");
+    sendLine("bestmove 0000");
+    return;
+  }
+
+  // Work out the time to use (if any). On a clock there is a soft limit as
+  // well, so the time manager can stop early on an easy move.
+  double searchSeconds=INFINITE_TIME,softSeconds=INFINITE_TIME;
+  if (moveTime>0.0)
+    searchSeconds=moveTime;
+  else if (timeLeft[pos.currentSide]>=0) {
+    const TimeBudget budget=allocateTime(timeLeft[pos.currentSide],increment[pos.currentSide],
+                                         movesToGo,moveOverheadMs);
+    searchSeconds=budget.hardSeconds;
+    softSeconds=budget.softSeconds;
+  }
+
+  // While pondering we search until told (the clock starts on "ponderhit").
+  // NOTE: After the "ponderhit" it just runs for the soft limit.
+  if (ponder) {
+    limits.infinite=true;
+    limits.timeSeconds=INFINITE_TIME;
+  }
+  else if (!limits.infinite) {
+    limits.timeSeconds=searchSeconds;
+    limits.softTimeSeconds=softSeconds;
+  }
+
+  {
+    lock_guard<mutex> lock(stateMutex);
+    stopSearch=false;
+    pondering=ponder;
+    infiniteSearch=limits.infinite && !ponder;
+    searchDone=false;
+    ponderSeconds=(softSeconds!=INFINITE_TIME) ? softSeconds : searchSeconds;
+  }
+  {
+    lock_guard<mutex> lock(outputMutex);
+    pvBestMove=pvPonderMove=MoveStruct{NONE,NONE,NORMAL_MOVE,NO_PROMOTION};
+  }
+  searchThread=thread(searchWorker,std::cref(pos),limits,std::cref(evalParams));
+
+} // End uciGo.
+
+// =============================================================================
+
+static void uciPosition(Position &pos,istringstream &args)
+{ // Parse "position [startpos | fen <fen>] [moves <m1> ...]".
+
+  string token,fen;
+  args >> token;
+  if (token=="startpos") {
+    fen=UCI_START_FEN;
+    args >> token;                               // "moves" (if any).
+  }
+  else if (token=="fen") {
+    while (args >> token && token!="moves")
+      fen+=token+' ';
+  }
+  else {
+    return;
+  }
+
+  if (setupFromFEN(pos,fen)) {
+    sendLine("info string invalid fen: "+fen);
+    initAll(pos);
+    return;
+  }
+
+  // Play the moves (the game history is kept for the repetition tests).
+  if (token!="moves")
+    return;
+  // NOTE: The search needs room for its own plies after the game's.
+  while (args >> token) {
+    if (static_cast<size_t>(pos.moveNum)+g_searchConfig.maxQuiesceDepth+1>=pos.maxPlys) {
+      sendLine("info string game too long, ignoring the rest of the moves");
+      return;
+    }
+    MoveStruct move;
+    if (convertFromUCI(pos,token,move) || !makeMove(pos,move)) {
+      sendLine("info string illegal move: "+token);
+      return;
+    }
+  }
+
+} // End uciPosition.
+
+// =============================================================================
+
+static void uciSetOption(istringstream &args,EvaluationParameters &evalParams,string &evalSetFile)
+{ // Parse "setoption name <id> [value <x>]" (the id/value may have spaces).
+
+  string token,name,value;
+  args >> token;                                 // "name".
+  while (args >> token && token!="value")
+    name+=(name.empty() ? "" : " ")+token;
+  while (args >> token)
+    value+=(value.empty() ? "" : " ")+token;
+
+  if (name=="Hash") {
+    const int hashSizeMb=std::clamp(atoi(value.c_str()),MIN_HASH_SIZE_MB,MAX_HASH_SIZE_MB);
+    g_searchConfig.hashSizeMB=static_cast<size_t>(hashSizeMb);
+    g_searchConfig.computeHashSize();            // Allocated on "isready"/"go".
+  }
+  else if (name=="Pawn Hash") {
+    const int pawnHashSizeMb=std::clamp(atoi(value.c_str()),1,
+                                        static_cast<int>(SearchConfig::MAX_PAWN_HASH_SIZE_MB));
+    g_searchConfig.pawnHashSizeMB=static_cast<size_t>(pawnHashSizeMb);  // Resized on "go".
+  }
+  else if (name=="Eval Cache") {
+    const int evalCacheSizeMb=std::clamp(atoi(value.c_str()),0,
+                                         static_cast<int>(SearchConfig::MAX_EVAL_CACHE_SIZE_MB));
+    g_searchConfig.evalCacheSizeMB=static_cast<size_t>(evalCacheSizeMb);  // Resized on "go".
+  }
+  else if (name=="Threads") {
+    const int numThreads=std::clamp(atoi(value.c_str()),1,
+                                    static_cast<int>(SearchConfig::MAX_NUM_THREADS_LIMIT));
+    g_searchConfig.numThreads=static_cast<size_t>(numThreads);
+  }
+  else if (name=="Move Overhead") {
+    moveOverheadMs=std::clamp(atoi(value.c_str()),0,MAX_MOVE_OVERHEAD_MS);
+  }
+  else if (name=="Clear Hash") {
+    newGame();
+  }
+  else if (name=="EvalFile") {
+    EvaluationParameters newParams;
+    if (newParams.load(value.c_str())==true) {
+      sendLine("info string could not load evaluation set: "+value);
+    }
+    else {
+      evalParams=newParams;
+      evalSetFile=value;
+    }
+  }
+  else if (name!="Ponder") {                    // Ponder just tells us we may.
+    sendLine("info string unknown option: "+name);
+  }
+
+} // End uciSetOption.
+
+// =============================================================================
+
+void uciLoop(EvaluationParameters &evalParams,const char* evalSetFile)
+{ // Read and answer UCI commands until "quit" (or the end of the input).
+
+  Position pos(g_searchConfig);
+  string evalFile=evalSetFile;
+  string line;
+
+  initAll(pos);
+
+  while (getline(cin,line)) {
+    istringstream args(line);
+    string command;
+    args >> command;
+
+    if (command=="uci") {
+      ostringstream reply;
+      reply << "id name " << UCI_ENGINE_NAME << ' ' << VERSION << '\n'
+            << "id author " << UCI_ENGINE_AUTHOR << '\n'
+            << "option name Hash type spin default " << g_searchConfig.hashSizeMB
+            << " min " << MIN_HASH_SIZE_MB << " max " << MAX_HASH_SIZE_MB << '\n'
+            << "option name Pawn Hash type spin default " << g_searchConfig.pawnHashSizeMB
+            << " min 1 max " << SearchConfig::MAX_PAWN_HASH_SIZE_MB << '\n'
+            << "option name Eval Cache type spin default " << g_searchConfig.evalCacheSizeMB
+            << " min 0 max " << SearchConfig::MAX_EVAL_CACHE_SIZE_MB << '\n'
+            << "option name Threads type spin default " << g_searchConfig.numThreads
+            << " min 1 max " << SearchConfig::MAX_NUM_THREADS_LIMIT << '\n'
+            << "option name Ponder type check default false\n"
+            << "option name Move Overhead type spin default " << DEFAULT_MOVE_OVERHEAD_MS
+            << " min 0 max " << MAX_MOVE_OVERHEAD_MS << '\n'
+            << "option name Clear Hash type button\n"
+            << "option name EvalFile type string default " << evalFile << '\n'
+            << "uciok";
+      sendLine(reply.str());
+    }
+    else if (command=="isready") {
+      bool searching;
+      {
+        lock_guard<mutex> lock(stateMutex);
+        searching=!searchDone;
+      }
+      if (!searching)
+        ttAllocate();                            // Do any resize now, not on "go".
+      sendLine("readyok");
+    }
+    else if (command=="setoption") {
+      stopAndWait();
+      uciSetOption(args,evalParams,evalFile);
+    }
+    else if (command=="ucinewgame") {
+      stopAndWait();
+      newGame();
+    }
+    else if (command=="position") {
+      stopAndWait();
+      uciPosition(pos,args);
+    }
+    else if (command=="go") {
+      stopAndWait();
+      uciGo(pos,args,evalParams);
+    }
+    else if (command=="stop") {
+      {
+        lock_guard<mutex> lock(stateMutex);
+        stopSearch=true;
+      }
+      stateChanged.notify_all();
+    }
+    else if (command=="ponderhit") {
+      {
+        lock_guard<mutex> lock(stateMutex);
+        if (pondering) {
+          pondering=false;
+          if (!searchDone)
+            startTimer(ponderSeconds);
+        }
+      }
+      stateChanged.notify_all();
+    }
+    else if (command=="quit") {
+      break;
+    }
+    // NOTE: Anything else (eg: "debug", "register") is ignored, as UCI says.
+  }
+
+  stopAndWait();
+
+} // End uciLoop.
@@ -34,7 +34,7 @@ using namespace std;
 // How long to search each move.
 constexpr double DEFAULT_SEARCH_TIME = 10.0;
 
-bool loadNextPosition(ifstream &inFile,std::array<MoveStruct, 100>& desiredMoves,
+bool loadNextPosition(Position &pos,ifstream &inFile,std::array<MoveStruct, 100>& desiredMoves,
                       int &numDesired,bool &unDesired)
 { // Loads the next position from the file.
   // Returns true if no more exist in the file, else false.
@@ -72,8 +72,8 @@ bool loadNextPosition(ifstream &inFile,std::array<MoveStruct, 100>& desiredMoves
   } while (numSlashes<8);
 
   // Assume certain things to be overrided later in function.
-  g_gameHistory[0].castlePerm=0;         // No castling yet.
-  g_gameHistory[0].enPass=NO_EN_PASSANT; // En-Pasent is NOT allowed yet.
+  pos.gameHistory[0].castlePerm=0;         // No castling yet.
+  pos.gameHistory[0].enPass=NO_EN_PASSANT; // En-Pasent is NOT allowed yet.
 
   // We have a valid line, so lets parse it.
   bufferIndex=0;
@@ -87,10 +87,10 @@ bool loadNextPosition(ifstream &inFile,std::array<MoveStruct, 100>& desiredMoves
       }
       else {
         if (buffer[bufferIndex+1]=='w') {
-          g_currentSide=WHITE;
+          pos.currentSide=WHITE;
         }
         else if (buffer[bufferIndex+1]=='b') {
-          g_currentSide=BLACK;
+          pos.currentSide=BLACK;
         }
         else {
           LOG_WARNING("Invalid first player.");
@@ -107,106 +107,106 @@ bool loadNextPosition(ifstream &inFile,std::array<MoveStruct, 100>& desiredMoves
     // Is it a number - ie: Blank spaces.
     if (buffer[bufferIndex]>='1' && buffer[bufferIndex]<='8') {
       for (int j=0;j<(buffer[bufferIndex]-'0');j++) {
-        g_gameHistory[0].piece[i]=NONE;
-        g_gameHistory[0].colour[i++]=NONE;
+        pos.gameHistory[0].piece[i]=NONE;
+        pos.gameHistory[0].colour[i++]=NONE;
       }
     }
 
     // Is it a white pawn.
     else if (buffer[bufferIndex]=='P') {
-      g_gameHistory[0].piece[i]=PAWN;
-      g_gameHistory[0].colour[i++]=WHITE;
+      pos.gameHistory[0].piece[i]=PAWN;
+      pos.gameHistory[0].colour[i++]=WHITE;
     }
     // Is it a black pawn.
     else if (buffer[bufferIndex]=='p') {
-      g_gameHistory[0].piece[i]=PAWN;
-      g_gameHistory[0].colour[i++]=BLACK;
+      pos.gameHistory[0].piece[i]=PAWN;
+      pos.gameHistory[0].colour[i++]=BLACK;
     }
     // Is it a white knight.
     else if (buffer[bufferIndex]=='N') {
-      g_gameHistory[0].piece[i]=KNIGHT;
-      g_gameHistory[0].colour[i++]=WHITE;
+      pos.gameHistory[0].piece[i]=KNIGHT;
+      pos.gameHistory[0].colour[i++]=WHITE;
     }
     // Is it a black knight.
     else if (buffer[bufferIndex]=='n') {
-      g_gameHistory[0].piece[i]=KNIGHT;
-      g_gameHistory[0].colour[i++]=BLACK;
+      pos.gameHistory[0].piece[i]=KNIGHT;
+      pos.gameHistory[0].colour[i++]=BLACK;
     }
     // Is it a white bishop.
     else if (buffer[bufferIndex]=='B') {
-      g_gameHistory[0].piece[i]=BISHOP;
-      g_gameHistory[0].colour[i++]=WHITE;
+      pos.gameHistory[0].piece[i]=BISHOP;
+      pos.gameHistory[0].colour[i++]=WHITE;
     }
     // Is it a black bishop.
     else if (buffer[bufferIndex]=='b') {
-      g_gameHistory[0].piece[i]=BISHOP;
-      g_gameHistory[0].colour[i++]=BLACK;
+      pos.gameHistory[0].piece[i]=BISHOP;
+      pos.gameHistory[0].colour[i++]=BLACK;
     }
     // Is it a white rook.
     else if (buffer[bufferIndex]=='R') {
       if (i==63)
-        g_gameHistory[0].castlePerm|=WHITE_KING_SIDE;
+        pos.gameHistory[0].castlePerm|=WHITE_KING_SIDE;
       else if (i==56)
-        g_gameHistory[0].castlePerm|=WHITE_QUEEN_SIDE;
-      g_gameHistory[0].piece[i]=ROOK;
-      g_gameHistory[0].colour[i++]=WHITE;
+        pos.gameHistory[0].castlePerm|=WHITE_QUEEN_SIDE;
+      pos.gameHistory[0].piece[i]=ROOK;
+      pos.gameHistory[0].colour[i++]=WHITE;
     }
     // Is it a black rook.
     else if (buffer[bufferIndex]=='r') {
       if (i==7)
-        g_gameHistory[0].castlePerm|=BLACK_KING_SIDE;
+        pos.gameHistory[0].castlePerm|=BLACK_KING_SIDE;
       else if (i==0)
-        g_gameHistory[0].castlePerm|=BLACK_QUEEN_SIDE;
-      g_gameHistory[0].piece[i]=ROOK;
-      g_gameHistory[0].colour[i++]=BLACK;
+        pos.gameHistory[0].castlePerm|=BLACK_QUEEN_SIDE;
+      pos.gameHistory[0].piece[i]=ROOK;
+      pos.gameHistory[0].colour[i++]=BLACK;
     }
     // Is it a white queen.
     else if (buffer[bufferIndex]=='Q') {
-      g_gameHistory[0].piece[i]=QUEEN;
-      g_gameHistory[0].colour[i++]=WHITE;
+      pos.gameHistory[0].piece[i]=QUEEN;
+      pos.gameHistory[0].colour[i++]=WHITE;
     }
     // Is it a black queen.
     else if (buffer[bufferIndex]=='q') {
-      g_gameHistory[0].piece[i]=QUEEN;
-      g_gameHistory[0].colour[i++]=BLACK;
+      pos.gameHistory[0].piece[i]=QUEEN;
+      pos.gameHistory[0].colour[i++]=BLACK;
     }
     // Is it a white king.
     else if (buffer[bufferIndex]=='K') {
-      g_gameHistory[0].kingSquare[WHITE]=i; // Set to start position.
-      g_gameHistory[0].piece[i]=KING;
-      g_gameHistory[0].colour[i++]=WHITE;
+      pos.gameHistory[0].kingSquare[WHITE]=i; // Set to start position.
+      pos.gameHistory[0].piece[i]=KING;
+      pos.gameHistory[0].colour[i++]=WHITE;
     }
     // Is it a black king.
     else if (buffer[bufferIndex]=='k') {
-      g_gameHistory[0].kingSquare[BLACK]=i;  // Set to start position.
-      g_gameHistory[0].piece[i]=KING;
-      g_gameHistory[0].colour[i++]=BLACK;
+      pos.gameHistory[0].kingSquare[BLACK]=i;  // Set to start position.
+      pos.gameHistory[0].piece[i]=KING;
+      pos.gameHistory[0].colour[i++]=BLACK;
     }
 
     // Special case characters.
 
     // Is it a white rook (moved, but on orig square).
     else if (buffer[bufferIndex]=='S') {
-      g_gameHistory[0].piece[i]=ROOK;
-      g_gameHistory[0].colour[i++]=WHITE;
+      pos.gameHistory[0].piece[i]=ROOK;
+      pos.gameHistory[0].colour[i++]=WHITE;
     }
     // Is it a black rook (moved, but on orig square).
     else if (buffer[bufferIndex]=='s') {
-      g_gameHistory[0].piece[i]=ROOK;
-      g_gameHistory[0].colour[i++]=BLACK;
+      pos.gameHistory[0].piece[i]=ROOK;
+      pos.gameHistory[0].colour[i++]=BLACK;
     }
 
     // Set up en-passent pawn.
     else if (buffer[bufferIndex]=='O') {
-      g_gameHistory[0].enPass=i+8; // En-Pass target square.
-      g_gameHistory[0].piece[i]=PAWN;
-      g_gameHistory[0].colour[i++]=WHITE;
+      pos.gameHistory[0].enPass=i+8; // En-Pass target square.
+      pos.gameHistory[0].piece[i]=PAWN;
+      pos.gameHistory[0].colour[i++]=WHITE;
     }
     // Is it a black rook (moved, but on orig square).
     else if (buffer[bufferIndex]=='o') {
-      g_gameHistory[0].enPass=i-8; // En-Pass target square.
-      g_gameHistory[0].piece[i]=PAWN;
-      g_gameHistory[0].colour[i++]=BLACK;
+      pos.gameHistory[0].enPass=i-8; // En-Pass target square.
+      pos.gameHistory[0].piece[i]=PAWN;
+      pos.gameHistory[0].colour[i++]=BLACK;
     }
 
     else {
@@ -217,33 +217,38 @@ bool loadNextPosition(ifstream &inFile,std::array<MoveStruct, 100>& desiredMoves
   }
 
   // See if the king positions allow castling.
-  if (g_gameHistory[0].kingSquare[WHITE]!=60)
-    g_gameHistory[0].castlePerm&=~(WHITE_KING_SIDE|WHITE_QUEEN_SIDE);
-  if (g_gameHistory[0].kingSquare[BLACK]!=4)
-    g_gameHistory[0].castlePerm&=~(BLACK_KING_SIDE|BLACK_QUEEN_SIDE);
+  if (pos.gameHistory[0].kingSquare[WHITE]!=60)
+    pos.gameHistory[0].castlePerm&=~(WHITE_KING_SIDE|WHITE_QUEEN_SIDE);
+  if (pos.gameHistory[0].kingSquare[BLACK]!=4)
+    pos.gameHistory[0].castlePerm&=~(BLACK_KING_SIDE|BLACK_QUEEN_SIDE);
 
   // Start on move 0.
-  g_moveNum=0;                           // Now on move 0.
+  pos.moveNum=0;                           // Now on move 0.
 
   // Init fifty move counter to 0.
-  g_gameHistory[0].fiftyCounter=0;       // Reset the first-move-rule counter.
+  pos.gameHistory[0].fiftyCounter=0;       // Reset the first-move-rule counter.
 
   // Can't (shouldn't!) be a draw on the first move.
-  g_gameHistory[0].isDraw=false;
+  pos.gameHistory[0].isDraw=false;
 
   // Set the pointer to the first state.
-  g_currentState=&g_gameHistory[0];
+  pos.currentState=&pos.gameHistory[0];
 
   // Set up the pointer to the current board.
-  g_currentColour=g_currentState->colour;
-  g_currentPiece=g_currentState->piece;
+  pos.currentColour=pos.currentState->colour;
+  pos.currentPiece=pos.currentState->piece;
+
+  // Build the bitboards from the board.
+  initBitboards(pos.gameHistory[0]);
 
   // See if the current side is in check to start with.
-  g_gameHistory[0].inCheck=isAttacked(g_gameHistory[0].kingSquare[g_currentSide],
-                                getOtherSide(g_currentSide));
+  pos.gameHistory[0].inCheck=isAttacked(pos,pos.gameHistory[0].kingSquare[pos.currentSide],
+                                getOtherSide(pos.currentSide));
 
   // Set the currect Hash key up.
-  g_gameHistory[0].key=currentKey();
+  pos.gameHistory[0].key=currentKey(pos);
+  pos.gameHistory[0].pawnKey=currentPawnKey(pos);
+  storeRepetitionKey(pos);
 
   // Parse the list of moves we must (or must not!) choose.
   // Get the source and target square first.
@@ -392,6 +397,16 @@ int main(int argc, char** argv)
                    CliParser::OptionType::BOOL, nullptr);
   parser.addOption("hash-size", 'H', "Hash table size in MB (default: 512)",
                    CliParser::OptionType::INT, "512");
+  parser.addOption("threads", 'T', "Number of search threads (default: 1)",
+                   CliParser::OptionType::INT, "1");
+  parser.addOption("numa", '\0', "Interleave the hash table across NUMA nodes",
+                   CliParser::OptionType::BOOL, nullptr);
+  parser.addOption("pawn-hash", '\0', "Pawn hash table size in MB per thread (default: 2)",
+                   CliParser::OptionType::INT, "2");
+  parser.addOption("eval-cache", '\0', "Eval cache size in MB, 0 = none (default: 0)",
+                   CliParser::OptionType::INT, "0");
+  parser.addOption("json-stats", '\0', "Also print each search's stats as a JSON line",
+                   CliParser::OptionType::BOOL, nullptr);
 
   if (!parser.parse(argc, argv)) {
     const char* error = parser.getError();
@@ -424,9 +439,39 @@ int main(int argc, char** argv)
     cerr << "ChessTest: hash-size must be between 1 and 4096 MB" << endl;
     return 1;
   }
+  g_searchConfig.computeHashSize();
+
+  // Set the number of search threads.
+  int numThreads = parser.getInt("threads");
+  if (numThreads < 1 || numThreads > static_cast<int>(SearchConfig::MAX_NUM_THREADS_LIMIT)) {
+    cerr << "ChessTest: threads must be between 1 and "
+         << SearchConfig::MAX_NUM_THREADS_LIMIT << endl;
+    return 1;
+  }
+  g_searchConfig.numThreads = static_cast<size_t>(numThreads);
+  g_searchConfig.numaInterleave = parser.getBool("numa");
+
+  // Set the pawn hash table size (per thread).
+  int pawnHashSizeMb = parser.getInt("pawn-hash");
+  if (pawnHashSizeMb < 1 || pawnHashSizeMb > static_cast<int>(SearchConfig::MAX_PAWN_HASH_SIZE_MB)) {
+    cerr << "ChessTest: pawn-hash must be between 1 and "
+         << SearchConfig::MAX_PAWN_HASH_SIZE_MB << " MB" << endl;
+    return 1;
+  }
+  g_searchConfig.pawnHashSizeMB = static_cast<size_t>(pawnHashSizeMb);
+
+  // Set the eval cache size (shared by the threads).
+  int evalCacheSizeMb = parser.getInt("eval-cache");
+  if (evalCacheSizeMb < 0 || evalCacheSizeMb > static_cast<int>(SearchConfig::MAX_EVAL_CACHE_SIZE_MB)) {
+    cerr << "ChessTest: eval-cache must be between 0 and "
+         << SearchConfig::MAX_EVAL_CACHE_SIZE_MB << " MB" << endl;
+    return 1;
+  }
+  g_searchConfig.evalCacheSizeMB = static_cast<size_t>(evalCacheSizeMb);
+  const bool jsonStats = parser.getBool("json-stats");
 
-  // Initialize global resources with search configuration
-  initGlobals(g_searchConfig);
+  // The position the tests are loaded into (sized by the search configuration).
+  Position pos(g_searchConfig);
 
   // First cearte the lookup tables from own program (to make hybrid)
   generateMoveTables();                // Create the move lookup tables.
@@ -434,8 +479,8 @@ int main(int argc, char** argv)
   // Generate the exposed attack table.
   generateExposedAttackTable();        // MUST BE DONE AFTER MOVE TABLES.
 
-  // Generate the g_posData tables.
-  initPosData();
+  // Generate the bitboard attack tables.
+  generateBitboardTables();            // MUST BE DONE AFTER MOVE TABLES.
 
   // Init the hash codes.
   initHashCodes();
@@ -450,16 +495,21 @@ int main(int argc, char** argv)
   if (inFile.fail())
     FATAL_ERROR("Could not open input file.");
 
-  while (loadNextPosition(inFile,desiredMoves,numDesired,unDesired)==false)  {
-    genMoves(moves);
+  while (loadNextPosition(pos,inFile,desiredMoves,numDesired,unDesired)==false)  {
+    genMoves(pos,moves);
     cout << "File: " << testFile << " / Position: " << count << endl;
-    printBoard(g_currentSide);
+    printBoard(pos,pos.currentSide);
     count++;
-    if (g_currentSide==WHITE)
+    if (pos.currentSide==WHITE)
       cout << "WHITE to move." << endl << endl;
     else
       cout << "BLACK to move." << endl << endl;
-    chosenMove=think(INFINITE_DEPTH,searchTime,true,true,0.0,evalParams);
+    newGame();                         // Each test position is a new game.
+    chosenMove=think(pos,INFINITE_DEPTH,searchTime,true,true,0.0,evalParams);
+    if (jsonStats) {
+      cout << "Stats: ";
+      printSearchStats(getLastSearchStats(),cout,true);
+    }
     cout << endl;
 
     // Print the move chosen and the desired move.
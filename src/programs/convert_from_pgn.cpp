@@ -110,6 +110,9 @@ int main(int argc, char** argv)
   // The (Binary) ouput file.
   ofstream outFile;
 
+  // The position the games are replayed on.
+  Position pos(g_searchConfig);
+
   // Have we found a fen tagg before this game?
   bool fenTaggFound;
 
@@ -156,13 +159,13 @@ int main(int argc, char** argv)
   // Generate the exposed attack table.
   generateExposedAttackTable();        // MUST BE DONE AFTER MOVE TABLES.
 
-  // Generate the g_posData tables.
-  initPosData();
+  // Generate the bitboard attack tables.
+  generateBitboardTables();            // MUST BE DONE AFTER MOVE TABLES.
 
   // Init the hash codes.
   initHashCodes();
 
-  initAll();
+  initAll(pos);
 
   numGames=0;
   numErrors=0;
@@ -218,7 +221,7 @@ int main(int argc, char** argv)
 
     // If this is now the first move, then skip it.
     if (buffer[0]!='1' || buffer[1]!='.') {
-        initAll();
+        initAll(pos);
         numTries=2;
         fenTaggFound=false;
         continue;
@@ -291,7 +294,7 @@ int main(int argc, char** argv)
           inFile.get(ch);
           if (static_cast<int>(inFile.tellg())==fileLen) {
             cout << "Unterminated ()'s/{}'s. Found EOF." << endl;
-            initAll();
+            initAll(pos);
             fenTaggFound=false;
             numTries++;                          // Try again...
             inFile.seekg(movesStartAt,ios::beg); // Seek to start.
@@ -340,7 +343,7 @@ int main(int argc, char** argv)
         // Was it an, unterminated comment?
         if (eventTextIndex==6) {
           cout << "Unterminated ()'s/{}'s. Found '[Event' (PGN tag?)." << endl;
-          initAll();
+          initAll(pos);
           fenTaggFound=false;
           numTries++;                          // Try again...
           inFile.seekg(movesStartAt,ios::beg); // Seek to start.
@@ -387,7 +390,7 @@ int main(int argc, char** argv)
         }
       }
       if (numTries==2) {                    // 2003: BUG, must check...
-        initAll();
+        initAll(pos);
         fenTaggFound=false;
         continue;
       }
@@ -397,7 +400,7 @@ int main(int argc, char** argv)
           if (buffer[0]=='[' || buffer.compare(0, 7, "ABORTED")==0
               || buffer.compare(0, 7, "Aborted")==0
               || buffer.compare(0, 7, "aborted")==0) {
-            initAll();
+            initAll(pos);
             numTries=2;
             fenTaggFound=false;
             continue;
@@ -434,24 +437,24 @@ int main(int argc, char** argv)
 
         // First check to see if their is a sensible number of moves in game.
         // ALSO: Is the fen tagg set, if so then just ignore the game.
-        if (fenTaggFound==true || g_moveNum<3 || g_moveNum>800) {
-          initAll();
+        if (fenTaggFound==true || pos.moveNum<3 || pos.moveNum>800) {
+          initAll(pos);
           numTries=2;
           fenTaggFound=false;
           continue;
         }
 
         // Print the header (Binary).
-        writeMinimalHeader(g_moveNum,result,outFile);
+        writeMinimalHeader(pos.moveNum,result,outFile);
 
         // Print the moves in minimal format (Binary).
-        for (int i=0;i<g_moveNum;i++)
-          writeMinimalMove(g_movesMade[i],moveIsQuiescent[i],outFile);
+        for (int i=0;i<pos.moveNum;i++)
+          writeMinimalMove(pos.movesMade[i],moveIsQuiescent[i],outFile);
 
         // Print the null terminator (for sort to use).
         outFile << '\0';
 
-        initAll();
+        initAll(pos);
         numGames++;
         numTries=2;
         fenTaggFound=false;
@@ -478,9 +481,9 @@ int main(int argc, char** argv)
       // Create a mutable buffer for convertFromSAN
       std::vector<char> moveBuffer(buffer.begin(), buffer.end());
       moveBuffer.push_back('\0');
-      if (convertFromSAN(moveBuffer.data(),moveChosen)==true) {
+      if (convertFromSAN(pos,moveBuffer.data(),moveChosen)==true) {
         cout << "Bad move found: " << buffer << endl;
-        initAll();
+        initAll(pos);
         numErrors++;
         numTries=2;
         fenTaggFound=false;
@@ -490,9 +493,9 @@ int main(int argc, char** argv)
         // The move is OK, so use it.
 
         // Make the move now (The validity of the move is checked before).
-        if (makeMove(moveChosen)==false) {
+        if (makeMove(pos,moveChosen)==false) {
           cout << "Bad move found(???): " << buffer << endl;
-          initAll();
+          initAll(pos);
           numErrors++;
           fenTaggFound=false;
           numTries=2;
@@ -502,7 +505,7 @@ int main(int argc, char** argv)
 
         // Find out if the move *LEADS TO* A Quiescent position.
 #ifdef REAL_QUIESCENCE
-        isQuiescentResult=isQuiescent();
+        isQuiescentResult=isQuiescent(pos);
 #else
         isQuiescentResult=1;
 #endif
@@ -510,7 +513,7 @@ int main(int argc, char** argv)
         // See if the search timed-out, if so skip this game...
         if (isQuiescentResult==-1) {
           cout << "IsQuiescent() - Timed out..." << endl;
-          initAll();
+          initAll(pos);
           numErrors++;
           numTries=2;
           fenTaggFound=false;
@@ -520,9 +523,9 @@ int main(int argc, char** argv)
 
         // If not timed out, then set the value.
         if (isQuiescentResult==true)
-          moveIsQuiescent[g_moveNum-1]=true;
+          moveIsQuiescent[pos.moveNum-1]=true;
         else
-          moveIsQuiescent[g_moveNum-1]=false;
+          moveIsQuiescent[pos.moveNum-1]=false;
 
         numPos++;
 
@@ -0,0 +1,261 @@
+// perft.cpp
+// =========
+// Counts the leaf nodes of the legal move tree to a fixed depth (perft), to
+// check genLegalMoves() and makeMoveInPlace()/unmakeMove() against known
+// counts and to time them without any search on top.
+// The positions can be "startpos", a FEN, or a file of FEN/EPD lines or .fin
+// test positions. An EPD line can give the expected counts as ";D<depth>
+// <nodes>" (eg: data/test_positions/perft.epd), and any that don't match are
+// reported (and the exit code is 1), so it can be used as a regression test.
+// - divide:  Prints the count under each root move (to find a bug).
+// - bulk:    Counts the legal moves at the last ply without making them.
+// - threads: Splits the root moves between this many threads.
+
+// Include headers only - implementations linked separately
+#include "../chess_engine/chess_engine.h"
+#include "../search_engine/search_engine.h"
+#include "../search_engine/search_config.h"
+#include "../interface/interface.h"
+#include "../core/cli_parser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// The deepest perft we allow (the tree is far too big well before this).
+constexpr int MAX_PERFT_DEPTH = 20;
+
+// A position to test, and the counts it should give (by depth) if known.
+struct PerftPosition {
+  string fen;
+  map<int,uint64_t> expected;
+};
+
+// =============================================================================
+
+static uint64_t perft(Position &pos,int depth,bool bulkCount)
+{ // Returns the number of leaf nodes depth plies (>=1) below pos.
+
+  MoveList moves;
+  uint64_t nodes=0;
+
+  genLegalMoves(pos,moves);
+
+  // Bulk counting: the leaves are just the legal moves here.
+  if (bulkCount && depth==1)
+    return moves.numMoves;
+
+  // NOTE: The moves are all legal, so makeMoveInPlace() can't fail.
+  for (int i=0;i<moves.numMoves;i++) {
+    makeMoveInPlace(pos,moves.moves[i]);
+    nodes+=(depth==1) ? 1 : perft(pos,depth-1,bulkCount);
+    unmakeMove(pos);
+  }
+
+  return nodes;
+
+} // End perft.
+
+// =============================================================================
+
+static uint64_t perftRoot(Position &pos,int depth,bool bulkCount,bool divide,int numThreads)
+{ // Runs perft, with the root moves shared out between the threads.
+
+  // The legal root moves.
+  MoveList moves;
+  genLegalMoves(pos,moves);
+  vector<MoveStruct> rootMoves(moves.moves,moves.moves+moves.numMoves);
+
+  // Each thread takes the next root move until there are none left.
+  vector<uint64_t> counts(rootMoves.size(),0);
+  atomic<size_t> nextMove{0};
+  auto worker=[&](Position &threadPos) {
+    for (size_t i=nextMove++;i<rootMoves.size();i=nextMove++) {
+      makeMoveInPlace(threadPos,rootMoves[i]);
+      counts[i]=(depth==1) ? 1 : perft(threadPos,depth-1,bulkCount);
+      unmakeMove(threadPos);
+    }
+  };
+
+  if (numThreads==1)
+    worker(pos);
+  else {
+    vector<unique_ptr<Position>> threadPositions;
+    vector<thread> threads;
+    for (int t=0;t<numThreads;t++) {
+      threadPositions.push_back(make_unique<Position>(g_searchConfig));
+      threadPositions.back()->copyFrom(pos);
+    }
+    for (int t=0;t<numThreads;t++)
+      threads.emplace_back(worker,ref(*threadPositions[t]));
+    for (thread &t : threads)
+      t.join();
+  }
+
+  uint64_t nodes=0;
+  for (size_t i=0;i<rootMoves.size();i++) {
+    if (divide)
+      cout << "  " << moveToUCI(rootMoves[i]) << ": " << counts[i] << endl;
+    nodes+=counts[i];
+  }
+
+  return nodes;
+
+} // End perftRoot.
+
+// =============================================================================
+
+static bool parsePositionLine(const string &line,PerftPosition &position)
+{ // Reads a FEN/EPD line (with any ";D<depth> <nodes>" counts) or a .fin test
+  // position. Returns true if the line doesn't hold a position.
+
+  istringstream fields(line.substr(0,line.find(';')));
+  string board;
+  if (!(fields >> board))
+    return true;
+
+  // .fin positions are "<board>/<side> <moves>" with castling taken from
+  // where the kings and rooks stand (setupFromFEN() drops any that can't be).
+  if (count(board.begin(),board.end(),'/')==8) {
+    if (board.size()<2 || (board.back()!='w' && board.back()!='b'))
+      return true;
+    position.fen=board.substr(0,board.size()-2)+" "+board.back()+" KQkq -";
+  }
+  else {
+    position.fen=line.substr(0,line.find(';'));
+    position.fen.erase(position.fen.find_last_not_of(" \t\r")+1);
+  }
+
+  // The expected counts.
+  position.expected.clear();
+  for (size_t i=line.find(';');i!=string::npos;i=line.find(';',i+1)) {
+    istringstream entry(line.substr(i+1));
+    string tag;
+    uint64_t nodes;
+    if (entry >> tag >> nodes && tag.size()>1 && tag[0]=='D')
+      position.expected[atoi(tag.c_str()+1)]=nodes;
+  }
+
+  return false;
+
+} // End parsePositionLine.
+
+// =============================================================================
+
+int main(int argc,char** argv)
+{
+  // Setup CLI parser
+  CliParser parser("Perft", "Count (and time) the move tree to a fixed depth");
+  parser.addPositional("positions", "\"startpos\", a FEN or a file of FEN/EPD/.fin positions");
+  parser.addOption("depth", 'd', "Perft depth in plies (default: 5)",
+                   CliParser::OptionType::INT, "5");
+  parser.addOption("divide", 'D', "Print the count under each root move",
+                   CliParser::OptionType::BOOL, nullptr);
+  parser.addOption("bulk", 'b', "Count the last ply's legal moves without making them",
+                   CliParser::OptionType::BOOL, nullptr);
+  parser.addOption("threads", 'T', "Number of threads to share the root moves (default: 1)",
+                   CliParser::OptionType::INT, "1");
+
+  if (!parser.parse(argc, argv)) {
+    const char* error = parser.getError();
+    if (error && error[0]) {
+      cerr << error << endl << endl;
+    }
+    parser.printHelp();
+    return 1;
+  }
+
+  const int depth = parser.getInt("depth");
+  if (depth < 1 || depth > MAX_PERFT_DEPTH) {
+    cerr << "Perft: depth must be between 1 and " << MAX_PERFT_DEPTH << endl;
+    return 1;
+  }
+  const int numThreads = parser.getInt("threads");
+  if (numThreads < 1 || numThreads > static_cast<int>(SearchConfig::MAX_NUM_THREADS_LIMIT)) {
+    cerr << "Perft: threads must be between 1 and "
+         << SearchConfig::MAX_NUM_THREADS_LIMIT << endl;
+    return 1;
+  }
+  const bool divide = parser.getBool("divide");
+  const bool bulkCount = parser.getBool("bulk");
+
+  // Get the positions (from a file if there is one of that name).
+  vector<PerftPosition> positions;
+  const string source = parser.getPositional(0);
+  ifstream inFile(source);
+  if (source == "startpos") {
+    positions.push_back({START_FEN, {}});
+  }
+  else if (inFile) {
+    string line;
+    PerftPosition position;
+    while (getline(inFile, line)) {
+      if (!parsePositionLine(line, position))
+        positions.push_back(position);
+    }
+  }
+  else {
+    positions.push_back({source, {}});
+  }
+
+  Position pos(g_searchConfig);
+  initAll(pos);
+
+  uint64_t totalNodes = 0;
+  double totalSeconds = 0.0;
+  int numTested = 0, numFailed = 0;
+
+  for (const PerftPosition &position : positions) {
+
+    // A file may have the odd line that isn't really a position.
+    if (setupFromFEN(pos, position.fen)) {
+      if (positions.size() == 1) {
+        cerr << "Perft: invalid FEN: " << position.fen << endl;
+        return 1;
+      }
+      continue;
+    }
+    numTested++;
+    cout << "Position " << numTested << ": " << position.fen << endl;
+
+    const auto start = chrono::steady_clock::now();
+    const uint64_t nodes = perftRoot(pos, depth, bulkCount, divide, numThreads);
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    totalNodes += nodes;
+    totalSeconds += seconds;
+
+    cout << "  perft(" << depth << ") = " << nodes << "  ("
+         << fixed << setprecision(3) << seconds << " s, "
+         << setprecision(0) << nodes / max(seconds, 1e-9) << " nodes/s)";
+    const auto expected = position.expected.find(depth);
+    if (expected != position.expected.end()) {
+      if (expected->second == nodes)
+        cout << "  OK";
+      else {
+        cout << "  FAILED (expected " << expected->second << ")";
+        numFailed++;
+      }
+    }
+    cout << endl;
+
+  }
+
+  cout << endl;
+  cout << "Positions      : " << numTested << endl;
+  cout << "Total Nodes    : " << totalNodes << endl;
+  cout << "Total Time     : " << fixed << setprecision(3) << totalSeconds << " s" << endl;
+  cout << "Nodes/Second   : " << setprecision(0) << totalNodes / max(totalSeconds, 1e-9) << endl;
+  if (numFailed > 0)
+    cout << "FAILED         : " << numFailed << endl;
+
+  return (numFailed > 0) ? 1 : 0;
+}
@@ -14,6 +14,9 @@ constexpr double DEFAULT_SEARCH_TIME = 1.0;   // Can stll be changed in program.
 // To be used if no filename is specified on the command line.
 constexpr const char* DEFAULT_SET = "./evaluation_sets/best_so_far.set";
 
+// Depth for --bench if no --depth is given.
+constexpr int DEFAULT_BENCH_DEPTH = 9;
+
 int main(int argc,char** argv)
 {
   int    gameMode=COMPUTER_BLACK;           // Mode to play in.
@@ -70,6 +73,18 @@ int main(int argc,char** argv)
                    CliParser::OptionType::BOOL, nullptr);
   parser.addOption("hash-size", 'H', "Hash table size in MB (default: 512)",
                    CliParser::OptionType::INT, "512");
+  parser.addOption("threads", 'T', "Number of search threads (default: 1)",
+                   CliParser::OptionType::INT, "1");
+  parser.addOption("numa", '\0', "Interleave the hash table across NUMA nodes",
+                   CliParser::OptionType::BOOL, nullptr);
+  parser.addOption("pawn-hash", '\0', "Pawn hash table size in MB per thread (default: 2)",
+                   CliParser::OptionType::INT, "2");
+  parser.addOption("eval-cache", '\0', "Eval cache size in MB, 0 = none (default: 0)",
+                   CliParser::OptionType::INT, "0");
+  parser.addOption("bench", '\0', "Search the built-in bench positions to a fixed depth and exit",
+                   CliParser::OptionType::BOOL, nullptr);
+  parser.addOption("json", '\0', "Print the bench results as JSON",
+                   CliParser::OptionType::BOOL, nullptr);
 
   if (!parser.parse(argc, argv)) {
     const char* error = parser.getError();
@@ -137,17 +152,45 @@ int main(int argc,char** argv)
     return 1;
   }
 
-  // Configure hash table size (other parameters use defaults)
+  // Validate pawn hash size
+  int pawnHashSizeMb = parser.getInt("pawn-hash");
+  if (pawnHashSizeMb < 1 || pawnHashSizeMb > static_cast<int>(SearchConfig::MAX_PAWN_HASH_SIZE_MB)) {
+    cerr << "PlayChess: pawn-hash must be between 1 and "
+         << SearchConfig::MAX_PAWN_HASH_SIZE_MB << " MB" << endl;
+    return 1;
+  }
+
+  // Validate eval cache size
+  int evalCacheSizeMb = parser.getInt("eval-cache");
+  if (evalCacheSizeMb < 0 || evalCacheSizeMb > static_cast<int>(SearchConfig::MAX_EVAL_CACHE_SIZE_MB)) {
+    cerr << "PlayChess: eval-cache must be between 0 and "
+         << SearchConfig::MAX_EVAL_CACHE_SIZE_MB << " MB" << endl;
+    return 1;
+  }
+
+  // Parse and validate the number of search threads
+  int numThreads = parser.getInt("threads");
+  if (numThreads < 1 || numThreads > static_cast<int>(SearchConfig::MAX_NUM_THREADS_LIMIT)) {
+    cerr << "PlayChess: threads must be between 1 and "
+         << SearchConfig::MAX_NUM_THREADS_LIMIT << endl;
+    return 1;
+  }
+
+  // Configure hash table size and threads (other parameters use defaults)
   g_searchConfig.hashSizeMB = static_cast<size_t>(hashSizeMb);
   g_searchConfig.computeHashSize();
+  g_searchConfig.numThreads = static_cast<size_t>(numThreads);
+  g_searchConfig.numaInterleave = parser.getBool("numa");
+  g_searchConfig.pawnHashSizeMB = static_cast<size_t>(pawnHashSizeMb);
+  g_searchConfig.evalCacheSizeMB = static_cast<size_t>(evalCacheSizeMb);
 
   if (!g_searchConfig.validate()) {
     cerr << "PlayChess: invalid search configuration" << endl;
     return 1;
   }
 
-  // Initialize global arrays with the configured parameters
-  initGlobals(g_searchConfig);
+  // The game position (history arrays sized by the configured parameters).
+  Position pos(g_searchConfig);
 
   // Get boolean flags
   showThinking = parser.getBool("thinking");
@@ -165,6 +208,13 @@ int main(int argc,char** argv)
   // NOTE: A random one will be created in can't load.
   if (epw.load(whiteSet)==true)
     FATAL_ERROR("Could not load WHITE set.");
+
+  // Run the benchmark instead of playing (on the white set).
+  if (parser.getBool("bench")) {
+    const int benchDepth = (searchTime == INFINITE_TIME) ? searchDepth : DEFAULT_BENCH_DEPTH;
+    return runBench(benchDepth, parser.getBool("json"), epw);
+  }
+
   if (epb.load(blackSet)==true)
     FATAL_ERROR("Could not load Black set.");
 
@@ -200,7 +250,14 @@ int main(int argc,char** argv)
     cout << "Move Bell     : OFF" << endl;
   else
     cout << "Move Bell     : ON" << endl;
-  cout << "Hash Memory   : " << g_searchConfig.getHashMemoryMB() << " MB (" << g_searchConfig.numHashSlots << " slots)" << endl;
+  cout << "Hash Memory   : " << g_searchConfig.getHashMemoryMB() << " MB (" << g_searchConfig.numHashSlots << " buckets)" << endl;
+  cout << "Threads       : " << g_searchConfig.numThreads << endl;
+  cout << "Pawn Hash     : " << g_searchConfig.pawnHashSizeMB << " MB per thread" << endl;
+  cout << "Eval Cache    : " << g_searchConfig.evalCacheSizeMB << " MB" << endl;
+  if (g_searchConfig.numaInterleave==false)
+    cout << "NUMA Hash     : OFF" << endl;
+  else
+    cout << "NUMA Hash     : ON (interleaved)" << endl;
   cout << "Games to Play : " << numGamesToPlay << endl;
 
   // Print multigame header.
@@ -219,7 +276,7 @@ int main(int argc,char** argv)
     }
 
     // Play the game.
-    gameResult=playGame(gameMode,searchDepth,searchTime,useBell,showOutput,
+    gameResult=playGame(pos,gameMode,searchDepth,searchTime,useBell,showOutput,
                         showThinking,randomSwing,epw,epb);
 
     // See why the game ended -if showOutput is off then this show also.
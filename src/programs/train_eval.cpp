@@ -109,6 +109,9 @@ int main(int argc,char** argv)
   // Evaluation sets (First is actual, second is temporary).
   EvaluationParameters evalParams;
 
+  // The position the games are replayed on.
+  Position pos(g_searchConfig);
+
   // For setting expected reward.
   double firstEval;                     // Target Eval of last position.
   double nextEval;                      // What we got from current eval.
@@ -302,7 +305,7 @@ int main(int argc,char** argv)
       readMinimalHeader(numMovesInGame,gameResult,inFile);
 
       // Init all a data to a new game.
-      initAll();
+      initAll(pos);
 
       // Count draws.
       if (gameResult==0)
@@ -313,7 +316,7 @@ int main(int argc,char** argv)
       // Read and make all the moves.
       for (int i=0;i<numMovesInGame;i++) {
         readMinimalMove(moveLoaded,positionIsQuiescent[i+1],inFile);
-        if (!makeMove(moveLoaded))
+        if (!makeMove(pos,moveLoaded))
             FATAL_ERROR("Move in the database is invalid(?).");
       }
 
@@ -325,7 +328,7 @@ int main(int argc,char** argv)
         firstEval=0;
       }
       else if (gameResult==1) {
-        if (g_currentSide==WHITE) {
+        if (pos.currentSide==WHITE) {
           firstEval=NN_TARGET;
         }
         else {
@@ -333,7 +336,7 @@ int main(int argc,char** argv)
         }
       }
       else {
-        if (g_currentSide==BLACK) {
+        if (pos.currentSide==BLACK) {
           firstEval=NN_TARGET;
         }
         else {
@@ -343,13 +346,13 @@ int main(int argc,char** argv)
 
       // Learn weights for the final state (Only if Quiescent!).
 	  // NOTE: We now makes sure that the material is even too.
-      if (positionIsQuiescent[numMovesInGame]==true && basicMaterialEval()==0) {
+      if (positionIsQuiescent[numMovesInGame]==true && basicMaterialEval(pos)==0) {
 
         // Set output.
         desiredOutput=firstEval;
 
         // Train (Quick version can't use momentums!).
-        totalSquaredError+=evalParams.train(desiredOutput,learningRate*MAGNIFY,
+        totalSquaredError+=evalParams.train(pos,desiredOutput,learningRate*MAGNIFY,
                                     actualOutput);
 
         // Find total (linear) error.
@@ -371,7 +374,7 @@ int main(int argc,char** argv)
       for (int i=numMovesInGame-1;i>=0;i--) {
 
         // Take the move back.
-        takeMoveBack();
+        takeMoveBack(pos);
 
         // Next player now.
         mul=-mul;
@@ -381,7 +384,7 @@ int main(int argc,char** argv)
 
         // Learn weights for the this state (Only if Quiescent!).
 		// NOTE: We now makes sure that the material is even too.
-        if (positionIsQuiescent[i]==true && basicMaterialEval()==0) {
+        if (positionIsQuiescent[i]==true && basicMaterialEval(pos)==0) {
 
           // TD-LAMBDA.
           proportion=pow(lambda,numMovesInGame-i);
@@ -389,7 +392,7 @@ int main(int argc,char** argv)
                            +(DISCOUNT*(1.0-proportion)*(-nextEval)));
 
           // Train (Quick version can't use momentums!).
-          totalSquaredError+=evalParams.train(desiredOutput,learningRate,actualOutput);
+          totalSquaredError+=evalParams.train(pos,desiredOutput,learningRate,actualOutput);
 
           // Find total (linear) error.
           totalError+=fabs(desiredOutput-actualOutput);
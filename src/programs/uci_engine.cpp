@@ -0,0 +1,102 @@
+// uci_engine.cpp
+// ==============
+// The engine as a UCI program, for use with chess GUIs and tournament
+// managers. All the protocol handling is in interface/uci.cpp, this just sets
+// the search up from the command line and hands over to uciLoop().
+
+// Include headers only - implementations linked separately
+#include "../chess_engine/chess_engine.h"
+#include "../search_engine/search_engine.h"
+#include "../search_engine/search_config.h"
+#include "../interface/interface.h"
+#include "../core/cli_parser.h"
+
+using namespace std;
+
+// To be used if no filename is specified on the command line.
+constexpr const char* DEFAULT_SET = "./evaluation_sets/best_so_far.set";
+
+int main(int argc,char** argv)
+{
+  // The evaluation parameters to use.
+  EvaluationParameters evalParams;
+
+  // Setup CLI parser
+  CliParser parser("UciChess", "Run the chess engine as a UCI engine");
+  parser.addOption("eval-set", 'e', "Evaluation set file (also the EvalFile option)",
+                   CliParser::OptionType::STRING, DEFAULT_SET);
+  parser.addOption("hash-size", 'H', "Hash table size in MB (default: 512)",
+                   CliParser::OptionType::INT, "512");
+  parser.addOption("threads", 'T', "Number of search threads (default: 1)",
+                   CliParser::OptionType::INT, "1");
+  parser.addOption("numa", '\0', "Interleave the hash table across NUMA nodes",
+                   CliParser::OptionType::BOOL, nullptr);
+  parser.addOption("pawn-hash", '\0', "Pawn hash table size in MB per thread (default: 2)",
+                   CliParser::OptionType::INT, "2");
+  parser.addOption("eval-cache", '\0', "Eval cache size in MB, 0 = none (default: 0)",
+                   CliParser::OptionType::INT, "0");
+
+  if (!parser.parse(argc, argv)) {
+    const char* error = parser.getError();
+    if (error && error[0]) {
+      cerr << error << endl << endl;
+    }
+    parser.printHelp();
+    return 1;
+  }
+
+  // Validate hash size
+  int hashSizeMb = parser.getInt("hash-size");
+  if (hashSizeMb < 1 || hashSizeMb > 65536) {
+    cerr << "UciChess: hash-size must be between 1 and 65536 MB" << endl;
+    return 1;
+  }
+
+  // Validate pawn hash size
+  int pawnHashSizeMb = parser.getInt("pawn-hash");
+  if (pawnHashSizeMb < 1 || pawnHashSizeMb > static_cast<int>(SearchConfig::MAX_PAWN_HASH_SIZE_MB)) {
+    cerr << "UciChess: pawn-hash must be between 1 and "
+         << SearchConfig::MAX_PAWN_HASH_SIZE_MB << " MB" << endl;
+    return 1;
+  }
+
+  // Validate eval cache size
+  int evalCacheSizeMb = parser.getInt("eval-cache");
+  if (evalCacheSizeMb < 0 || evalCacheSizeMb > static_cast<int>(SearchConfig::MAX_EVAL_CACHE_SIZE_MB)) {
+    cerr << "UciChess: eval-cache must be between 0 and "
+         << SearchConfig::MAX_EVAL_CACHE_SIZE_MB << " MB" << endl;
+    return 1;
+  }
+
+  // Parse and validate the number of search threads
+  int numThreads = parser.getInt("threads");
+  if (numThreads < 1 || numThreads > static_cast<int>(SearchConfig::MAX_NUM_THREADS_LIMIT)) {
+    cerr << "UciChess: threads must be between 1 and "
+         << SearchConfig::MAX_NUM_THREADS_LIMIT << endl;
+    return 1;
+  }
+
+  // Configure the search (the GUI may change hash/threads with setoption).
+  g_searchConfig.hashSizeMB = static_cast<size_t>(hashSizeMb);
+  g_searchConfig.computeHashSize();
+  g_searchConfig.numThreads = static_cast<size_t>(numThreads);
+  g_searchConfig.numaInterleave = parser.getBool("numa");
+  g_searchConfig.pawnHashSizeMB = static_cast<size_t>(pawnHashSizeMb);
+  g_searchConfig.evalCacheSizeMB = static_cast<size_t>(evalCacheSizeMb);
+
+  if (!g_searchConfig.validate()) {
+    cerr << "UciChess: invalid search configuration" << endl;
+    return 1;
+  }
+
+  // Load the evaluation set.
+  // NOTE: Don't print anything to stdout, as that is the GUI's.
+  const char* evalSet = parser.getString("eval-set");
+  if (evalParams.load(evalSet)==true)
+    FATAL_ERROR("Could not load the evaluation set.");
+
+  // Answer the GUI until it quits.
+  uciLoop(evalParams,evalSet);
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+// **************************************************************************
+// *                            EVALUATION CACHE                            *
+// **************************************************************************
+// Transpositions and re-searches reach the same positions again and again in
+// the quiescent search, which would each need a (slow) full eval. So the evals
+// are kept in a fixed size table, shared by all the search threads, with each
+// entry one 64-bit word: the top half of the key and the (32-bit) score. As an
+// entry is read and written in one go it can never be torn, so there's no
+// locking, and a slot is just overwritten by the next position to use it.
+// NOTE: The key includes a key of the evaluation set's weights (see think()),
+//       so the entries of another set (or a mutated one) never match and the
+//       cache never needs clearing.
+
+#include "search_engine.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+// The cache (nullptr if its size is 0).
+static std::unique_ptr<std::atomic<uint64_t>[]> evalCache;
+static size_t evalCachePow2=0;
+static size_t evalCacheSizeMB=0;
+
+// ==========================================================================
+
+static inline HashKey evalCacheKey(const SearchData &searchData)
+{ // The key: the position's key (which has the side to move in, as the eval
+  // is from its point of view) and the evaluation set's key.
+
+  return searchData.pos.currentState->key^searchData.evalWeightsKey;
+
+} // End evalCacheKey.
+
+// ==========================================================================
+
+void evalCacheAllocate(void)
+{ // (Re)allocate the cache, empty, if the configured size has changed.
+
+  if (evalCacheSizeMB==g_searchConfig.evalCacheSizeMB)
+    return;
+
+  evalCache.reset();
+  evalCachePow2=0;
+  evalCacheSizeMB=g_searchConfig.evalCacheSizeMB;
+  if (evalCacheSizeMB==0)
+    return;
+
+  // The largest power of 2 entries that fits.
+  size_t pow2=0;
+  while ((size_t(2)<<pow2)*sizeof(uint64_t)<=evalCacheSizeMB*1024*1024)
+    pow2++;
+  const size_t numEntries=size_t(1)<<pow2;
+
+  evalCache.reset(new (std::nothrow) std::atomic<uint64_t>[numEntries]);
+  if (!evalCache)
+    FATAL_ERROR("Failed to allocate eval cache ("+std::to_string(numEntries*sizeof(uint64_t))+" bytes)");
+  for (size_t i=0;i<numEntries;i++)
+    evalCache[i].store(0,std::memory_order_relaxed);
+  evalCachePow2=pow2;
+
+} // End evalCacheAllocate.
+
+// ==========================================================================
+
+bool evalCacheGet(SearchData &searchData,int &score)
+{ // Get the eval of the current position if the cache has it.
+
+  if (!evalCache)
+    return false;
+
+  const HashKey key=evalCacheKey(searchData);
+  const uint64_t entry=evalCache[foldHashKey(key,evalCachePow2)].load(std::memory_order_relaxed);
+  if ((entry>>32)!=(key>>32)) {
+    searchData.stats.evalCacheMisses++;
+    return false;
+  }
+
+  searchData.stats.evalCacheHits++;
+  score=static_cast<int32_t>(static_cast<uint32_t>(entry));
+  return true;
+
+} // End evalCacheGet.
+
+// ==========================================================================
+
+void evalCachePut(SearchData &searchData,int score)
+{ // Put the eval of the current position in the cache.
+
+  if (!evalCache)
+    return;
+
+  const HashKey key=evalCacheKey(searchData);
+  evalCache[foldHashKey(key,evalCachePow2)].store((key&0xFFFFFFFF00000000ULL)|static_cast<uint32_t>(score),
+                                                       std::memory_order_relaxed);
+
+} // End evalCachePut.
+
+// ==========================================================================
@@ -5,9 +5,14 @@
 #include "evaluation.h"
 #include "search_engine.h"
 #include "../chess_engine/constants.h"
+#include "../chess_engine/bitboards.h"
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <random>
 
+#include <immintrin.h>
+
 using namespace std;
 
 // Static member definitions - initialized from global config
@@ -15,6 +20,7 @@ bool EvaluationParameters::useLinearTraining = g_evaluationConfig.useLinearTrain
 bool EvaluationParameters::useKingDistanceFeatures = g_evaluationConfig.useKingDistanceFeatures;
 bool EvaluationParameters::useEmptySquareFeatures = g_evaluationConfig.useEmptySquareFeatures;
 bool EvaluationParameters::useSuperFastEval = g_evaluationConfig.useSuperFastEval;
+unsigned EvaluationParameters::evalFeatures = EvaluationParameters::getEvalFeatures();
 
 // #############################################################################
 // #                      PUBLIC (USER) MEMBER FUNCTIONS                       #
@@ -46,6 +52,8 @@ void EvaluationParameters::randomize(double maxInit)
       for (int k=0;k<2;k++)
         weights[i][j][k]=dist(rng);
 
+  compiled.valid=false;
+
 } // End EvaluationParameters::randomize.
 
 // -----------------------------------------------------------------------------
@@ -76,6 +84,8 @@ void EvaluationParameters::mutate(const double randomSwing)
       for (int k=0;k<2;k++)
         weights[i][j][k]+=dist(rng);
 
+  compiled.valid=false;
+
 } // End EvaluationParameters::mutate.
 
 // -----------------------------------------------------------------------------
@@ -113,6 +123,7 @@ bool EvaluationParameters::load(const char* fileName)
 
   // Close the file.
   inFile.close();
+  compiled.valid=false;
 
   // All O.k.
   return false;
@@ -248,6 +259,8 @@ void EvaluationParameters::normalize(void)
 
   }
 
+  compiled.valid=false;
+
 } // End EvaluationParameters::normalize.
 
 // -----------------------------------------------------------------------------
@@ -275,24 +288,27 @@ void EvaluationParameters::scale(double scaleFactor)
       for (int k=0;k<2;k++)
         weights[i][j][k]*=scaleFactor;
 
+  compiled.valid=false;
+
 } // End EvaluationParameters::scale.
 
 // -----------------------------------------------------------------------------
 
-double EvaluationParameters::train(double desiredOutput,double learningRate,
-                                   double &output)
+double EvaluationParameters::train(const Position &pos,double desiredOutput,
+                                   double learningRate,double &output)
 { // Train the evaluation set, and return the output after training.
   // NOTE: Now uses the generalised delta-rule, to use a sigmoid activation.
 
   // First fire the network to find it's output.
-  output=evalAndLearn(0.0);
+  output=evaluateWith<EvalMode::PRECISE>(pos);
 
   // Find the offset needed from the error (2003: Use derivative of bipol sig)..
   double error=(desiredOutput-activation(output));
-  double offset=learningRate*error*gradient(output);
+  offset=learningRate*error*gradient(output);
 
   // Alter the weights now.
-  output=activation(evalAndLearn(offset));
+  output=activation(evaluateWith<EvalMode::LEARN>(pos));
+  compiled.valid=false;
 
   // Return the squared error.
   return error*error;
@@ -301,42 +317,168 @@ double EvaluationParameters::train(double desiredOutput,double learningRate,
 
 // -----------------------------------------------------------------------------
 
-inline double EvaluationParameters::evalPrecise(void)
+HashKey EvaluationParameters::getWeightsKey(void) const
+{ // A 64-bit key (FNV-1a) of all the weights, so that two sets give the same
+  // evals if (and only if, barring a collision) they have the same key.
+
+  HashKey key=0xcbf29ce484222325ULL;
+  auto addBytes=[&key](const void* data,size_t numBytes) {
+    const unsigned char* bytes=static_cast<const unsigned char*>(data);
+    for (size_t i=0;i<numBytes;i++)
+      key=(key^bytes[i])*0x100000001b3ULL;
+  };
+
+  addBytes(psValues,sizeof(psValues));
+  addBytes(kingDistanceOwn.data(),sizeof(kingDistanceOwn));
+  addBytes(kingDistanceOther.data(),sizeof(kingDistanceOther));
+  addBytes(weights,sizeof(weights));
+  return key;
+
+} // End EvaluationParameters::getWeightsKey.
+
+// -----------------------------------------------------------------------------
+
+inline double EvaluationParameters::evalPrecise(const Position &pos)
 { // Get float eval.
-  return evalAndLearn(0.0);                         // Just call with no offset.
+  return evaluateWith<EvalMode::PRECISE>(pos);
 } // End EvaluationParameters::evalPrecise.
 
 // -----------------------------------------------------------------------------
 
-int EvaluationParameters::eval(void)
+int EvaluationParameters::eval(const Position &pos)
 { // Get (scaled by PAWN_VALUE) Interger eval.
   // NOTE: This is the function to call from Search(), as it multiplies the
   //       small value up by the (internal) value of a pawn.
-  //return (int)(evalAndLearn(0.0)*(double)PIECE_VALUE[PAWN]);
-  //return (((int)(evalAndLearn(0.0)*(double)PIECE_VALUE[PAWN]))/250)*250;
-  //return (((int)((evalAndLearn(0.0)/3.0)*(double)PIECE_VALUE[PAWN]))/200)*200;
+  //return (int)(evalAndLearn(pos,0.0)*(double)PIECE_VALUE[PAWN]);
+  //return (((int)(evalAndLearn(pos,0.0)*(double)PIECE_VALUE[PAWN]))/250)*250;
+  //return (((int)((evalAndLearn(pos,0.0)/3.0)*(double)PIECE_VALUE[PAWN]))/200)*200;
+
+  //return (((int)((evalAndLearn(pos,0.0))*(double)PIECE_VALUE[PAWN]))/100)*100;
+  return static_cast<int>(evaluateWith<EvalMode::PRECISE>(pos) * static_cast<double>(PIECE_VALUE[PAWN]));
+} // End EvaluationParameters::eval.
 
-  //return (((int)((evalAndLearn(0.0))*(double)PIECE_VALUE[PAWN]))/100)*100;
-  return static_cast<int>(evalAndLearn(0.0) * static_cast<double>(PIECE_VALUE[PAWN]));
+// -----------------------------------------------------------------------------
+
+int EvaluationParameters::eval(const Position &pos,const PieceSquareSums &sums,
+                               PawnHashTable &pawnTable)
+{ // As above, but the piece-square part is taken from the running sums (see
+  // updatePieceSquareSums()), and the pawns' part from the pawn hash table,
+  // so mostly only the other features are worked out here.
+  // NOTE: This uses the compiled weights, so may differ from the above by
+  //       the rounding (see CompiledWeights).
+  return evaluateWith<EvalMode::COMPILED>(pos,&sums,&pawnTable);
 } // End EvaluationParameters::eval.
 
+// -----------------------------------------------------------------------------
+
+void EvaluationParameters::initPieceSquareSums(const Position &pos,PieceSquareSums &sums)
+{ // Work out the piece-square sums from scratch (for the current stage).
+
+  if (!compiled.valid)
+    compileWeights();
+
+  sums.stage=getStage(pos);
+  for (int side=WHITE;side<=BLACK;side++) {
+    const bool flipBoard=(side==BLACK);
+    int32_t score=0;
+    for (int i=0;i<BOARD_SQUARES;i++) {
+      if (pos.currentColour[i]==side)
+        score+=compiled.psValues[sums.stage][pos.currentPiece[i]][flipIfNeeded(flipBoard,i)];
+      else if (pos.currentColour[i]==getOtherSide(side))
+        score+=compiled.psValues[sums.stage][pos.currentPiece[i]+6][flipIfNeeded(flipBoard,i)];
+      else if (useEmptySquareFeatures)
+        score+=compiled.psValues[sums.stage][12][flipIfNeeded(flipBoard,i)];
+    }
+    sums.score[side]=score;
+  }
+
+} // End EvaluationParameters::initPieceSquareSums.
+
+// -----------------------------------------------------------------------------
+
+void EvaluationParameters::updatePieceSquareSums(const Position &pos,const PieceSquareSums &before,
+                                                 PieceSquareSums &after,const MoveStruct &moveMade)
+{ // Update the piece-square sums for the move just made (the sums before it
+  // are kept, so taking the move back needs nothing doing).
+  // NOTE: If the move changed the stage (a capture), they are worked out again.
+
+  if (getStage(pos)!=before.stage) {
+    initPieceSquareSums(pos,after);
+    return;
+  }
+  after=before;
+
+  const int side=getOtherSide(pos.currentSide);           // Who moved.
+  const int piece=(moveMade.type&PROMOTION) ? PAWN : pos.currentPiece[moveMade.target];
+
+  // The piece leaves its square...
+  togglePieceSquare(after,side,piece,moveMade.source,-1);
+
+  // ...any piece taken goes (see the undo record)...
+  if (moveMade.type&EN_PASSANT)
+    togglePieceSquare(after,pos.currentSide,PAWN,moveMade.target+(side==WHITE ? 8 : -8),-1);
+  else if (moveMade.type&CAPTURE)
+    togglePieceSquare(after,pos.currentSide,pos.undoHistory[pos.moveNum-1].captured,
+                      moveMade.target,-1);
+
+  // ...and it (or what it promoted to) arrives.
+  togglePieceSquare(after,side,pos.currentPiece[moveMade.target],moveMade.target,1);
+
+  // Castling moves the rook too.
+  if (moveMade.type&CASTLE) {
+    const int rookFrom=(getFile(moveMade.target)==6) ? moveMade.target+1 : moveMade.target-2;
+    const int rookTo=(getFile(moveMade.target)==6) ? moveMade.target-1 : moveMade.target+1;
+    togglePieceSquare(after,side,ROOK,rookFrom,-1);
+    togglePieceSquare(after,side,ROOK,rookTo,1);
+  }
+
+} // End EvaluationParameters::updatePieceSquareSums.
+
+// #############################################################################
+// #                           PAWN HASH TABLE                                 #
+// #############################################################################
+
+void PawnHashTable::resize(size_t sizeMB)
+{ // Size the table to the largest power of 2 entries that fits in sizeMB,
+  // and clear it (a default entry is that for no pawns, so is valid).
+
+  size_t numEntries=1;
+  while (numEntries*2*sizeof(PawnHashEntry)<=sizeMB*1024*1024)
+    numEntries*=2;
+
+  entries.assign(numEntries,PawnHashEntry());
+  mask=numEntries-1;
+  this->sizeMB=sizeMB;
+  resetCounters();
+
+} // End PawnHashTable::resize.
+
 // #############################################################################
 // #                     PRIVATE (CLASS) MEMBER FUNCTIONS                      #
 // #############################################################################
 
-int EvaluationParameters::getStage(void) noexcept
+unsigned EvaluationParameters::getEvalFeatures(void) noexcept
+{ // The optional eval features in use (from the runtime flags), as EVAL_* bits.
+  // NOTE: Worked out once at start up, into evalFeatures.
+
+  return (useKingDistanceFeatures ? EVAL_KING_DISTANCE : 0)
+         |(useEmptySquareFeatures ? EVAL_EMPTY_SQUARES : 0)
+         |(useSuperFastEval ? EVAL_SUPER_FAST : 0);
+
+} // End EvaluationParameters::getEvalFeatures.
+
+// -----------------------------------------------------------------------------
+
+int EvaluationParameters::getStage(const Position &pos) noexcept
 { // This returns what stage the current position is (one of 3!).
   // clean_up15b: Now works on 3 stages, and only uses total *PIECES*.
 
   // The total number of pieces (not pawns/Kings) on board (Max=14) .
+  const GameState &state=*pos.currentState;
   int numPieces=0;
-
-  // First find the total pieces (not pawns or kings) on the board.
-  for (int i=0;i<BOARD_SQUARES;i++) {
-    if (g_currentPiece[i]!=NONE && g_currentPiece[i]!=PAWN
-        && g_currentPiece[i]!=KING)
-      numPieces++;
-  }
+  for (int side=WHITE;side<=BLACK;side++)
+    numPieces+=state.pieceCount[side][KNIGHT]+state.pieceCount[side][BISHOP]
+               +state.pieceCount[side][ROOK]+state.pieceCount[side][QUEEN];
 
   // Are we in the opening?
   if (numPieces>MIDDLE_GAME_PIECES)
@@ -372,177 +514,357 @@ inline double EvaluationParameters::gradient([[maybe_unused]] double value) noex
     return (2.0*exp(-value))/((1.0+exp(-value))*(1.0+exp(-value)));
 } // End EvaluationParameters::gradient.
 
+// -----------------------------------------------------------------------------
+
+void EvaluationParameters::togglePieceSquare(PieceSquareSums &sums,int colour,int piece,
+                                             int square,int sign)
+{ // Put a piece on a square (sign=1) or take it off (sign=-1) in both sides'
+  // sums, along with taking off/putting back the empty square's value.
+
+  for (int side=WHITE;side<=BLACK;side++) {
+    const int i=flipIfNeeded(side==BLACK,square);
+    int32_t value=compiled.psValues[sums.stage][(colour==side) ? piece : piece+6][i];
+    if (useEmptySquareFeatures)
+      value-=compiled.psValues[sums.stage][12][i];
+    sums.score[side]+=sign*value;
+  }
+
+} // End EvaluationParameters::togglePieceSquare.
+
 // =============================================================================
 
 // Note: Weight access functions have been converted to inline methods in the
 // EvaluationParameters class. See evaluation.h for addWeight(), addWeightScaled(),
-// addWeightSingular(), addWeightSingularScaled(), and flipIfNeeded().
+// addFeature() and flipIfNeeded().
+
+void EvaluationParameters::setupPawnsAndMinors(const Position &pos,PawnHashTable *pawnTable,
+                                               PawnHashEntry &localEntry,
+                                               const PawnHashEntry *&pawnEntry)
+{ // The 1st pass of the eval: Set up pawnCount and pawnRank + Minor peice flags.
+  // NOTE: The pawns' entry is taken from the pawn hash table if we have one,
+  //       else it is worked out in localEntry.
+
+  if (pawnTable!=nullptr) {
+    bool found;
+    PawnHashEntry &entry=pawnTable->probe(pos.currentState->pawnKey,found);
+    if (!found)
+      setupPawnEntry(pos,entry);
+    pawnEntry=&entry;
+  }
+  else {
+    setupPawnEntry(pos,localEntry);
+    pawnEntry=&localEntry;
+  }
+  pawnCount=pawnEntry->pawnCount;
+  pawnRank=pawnEntry->pawnRank;
+
+  // Setup the Minor Piece flags (forepost checks, bishop avoidance, etc).
+  const GameState &state=*pos.currentState;
+  for (int side=WHITE;side<=BLACK;side++) {
+    hasKnights[side]=((state.pieceBB[KNIGHT]&state.colourBB[side])!=0);
+    hasWhiteSquareBishop[side]=((state.pieceBB[BISHOP]&state.colourBB[side]&LIGHT_SQUARES_BB)!=0);
+    hasBlackSquareBishop[side]=((state.pieceBB[BISHOP]&state.colourBB[side]&~LIGHT_SQUARES_BB)!=0);
+  }
 
-double EvaluationParameters::evalAndLearn(double offsetValue)
-{ // Eval and/or update weights at the same time.
+} // End EvaluationParameters::setupPawnsAndMinors.
 
-  // This is the score to be returned for the position.
-  double score=0.0; 
+// =============================================================================
+// COMPILED (SEARCH) EVAL
+// =============================================================================
 
-  // First find what stage we are on (Save this outside, so function can see).
-  stage=getStage();
+static inline int32_t dotProduct(const int16_t* a,const int16_t* b,int n)
+{ // The dot product of two (32 byte aligned) vectors, n a multiple of 16.
+  // NOTE: Uses AVX2 or SSE2 if the build has them, else plain C++.
 
-  // Save the offsetValue locally, so other function can see.
-  offset=offsetValue;
+#if defined(__AVX2__)
+  __m256i sum=_mm256_setzero_si256();
+  for (int i=0;i<n;i+=16) {
+    const __m256i x=_mm256_load_si256(reinterpret_cast<const __m256i*>(a+i));
+    const __m256i y=_mm256_load_si256(reinterpret_cast<const __m256i*>(b+i));
+    sum=_mm256_add_epi32(sum,_mm256_madd_epi16(x,y));
+  }
+  __m128i sum128=_mm_add_epi32(_mm256_castsi256_si128(sum),_mm256_extracti128_si256(sum,1));
+  sum128=_mm_add_epi32(sum128,_mm_shuffle_epi32(sum128,_MM_SHUFFLE(1,0,3,2)));
+  sum128=_mm_add_epi32(sum128,_mm_shuffle_epi32(sum128,_MM_SHUFFLE(2,3,0,1)));
+  return _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE2__)
+  __m128i sum=_mm_setzero_si128();
+  for (int i=0;i<n;i+=8) {
+    const __m128i x=_mm_load_si128(reinterpret_cast<const __m128i*>(a+i));
+    const __m128i y=_mm_load_si128(reinterpret_cast<const __m128i*>(b+i));
+    sum=_mm_add_epi32(sum,_mm_madd_epi16(x,y));
+  }
+  sum=_mm_add_epi32(sum,_mm_shuffle_epi32(sum,_MM_SHUFFLE(1,0,3,2)));
+  sum=_mm_add_epi32(sum,_mm_shuffle_epi32(sum,_MM_SHUFFLE(2,3,0,1)));
+  return _mm_cvtsi128_si32(sum);
+#else
+  int32_t sum=0;
+  for (int i=0;i<n;i++)
+    sum+=static_cast<int32_t>(a[i])*static_cast<int32_t>(b[i]);
+  return sum;
+#endif
+
+} // End dotProduct.
 
-  // See if we are looking from white or black perspective and decide to flip.
-  bool flipBoard=(g_currentSide==WHITE?false:true);
+// -----------------------------------------------------------------------------
 
-  // 1st PASS: Set up pawnCount and pawnRank + Minor peice flags.
-  if (!useSuperFastEval) {
-    for (int i=0;i<10;i++) {
-      pawnCount[WHITE][i]=0;
-      pawnCount[BLACK][i]=0;
-      pawnRank[WHITE][i]=-1; 
-      pawnRank[BLACK][i]=8;
-    }
-    for (int i=0;i<2;i++) {
-      hasKnights[i]=false;
-      hasWhiteSquareBishop[i]=false;
-      hasBlackSquareBishop[i]=false;
+void EvaluationParameters::compileWeights(void)
+{ // Compile the weights for the search (see CompiledWeights).
+  // NOTE: A 'singular' weight too big for 16 bits (over 3 pawns) is capped.
+
+  const double unit=static_cast<double>(PIECE_VALUE[PAWN]);
+  auto toScore=[unit](double weight) {
+    return static_cast<int32_t>(lround(weight*unit));
+  };
+
+  bool capped=false;
+  for (int i=0;i<NUM_STAGES;i++) {
+    for (int j=0;j<13;j++)
+      for (int k=0;k<BOARD_SQUARES;k++)
+        compiled.psValues[i][j][k]=toScore(psValues[i][j][k]);
+    for (int j=0;j<12;j++) {
+      compiled.kingDistanceOwn[i][j]=toScore(kingDistanceOwn[i][j]);
+      compiled.kingDistanceOther[i][j]=toScore(kingDistanceOther[i][j]);
     }
-    for (int i=0;i<64;i++) {
-
-      // Setup the pawnCount and pawnRank arrays.
-      if (g_currentPiece[i]==PAWN) {
-        pawnCount[g_currentColour[i]][getFile(i)+1]++;
-        if (g_currentColour[i]==WHITE) {
-          if (pawnRank[WHITE][getFile(i)+1]<getRank(i))
-            pawnRank[WHITE][getFile(i)+1]=getRank(i);
-        }
-        else {
-          if (pawnRank[BLACK][getFile(i)+1]>getRank(i))
-            pawnRank[BLACK][getFile(i)+1]=getRank(i);
-        }
+    for (int k=0;k<2;k++) {
+      for (int j=0;j<FEATURE_STRIDE;j++) {
+        const int32_t value=(j<NUM_WEIGHTS) ? toScore(weights[i][j][k]) : 0;
+        const int32_t cappedValue=clamp<int32_t>(value,INT16_MIN,INT16_MAX);
+        capped|=(cappedValue!=value);
+        compiled.features[i][k][j]=static_cast<int16_t>(cappedValue);
       }
+    }
+  }
+  if (capped)
+    LOG_WARNING("Evaluation weight(s) too big for the compiled eval have been capped");
 
-      // Setup the Minor Piece flags (forepost checks, bishop avoidance, etc).
-      else if (g_currentPiece[i]==KNIGHT) {
-        hasKnights[g_currentColour[i]]=true;
-      }
-      else if (g_currentPiece[i]==BISHOP) {
-
-        // Find out if bihops is on black or white square.
-        if ((i/8)%2==0) {
-          if (i%2==0)
-            hasWhiteSquareBishop[g_currentColour[i]]=true;
-          else
-            hasBlackSquareBishop[g_currentColour[i]]=true;
-        }
-        else {
-          if (i%2==0)
-            hasBlackSquareBishop[g_currentColour[i]]=true;
-          else
-            hasWhiteSquareBishop[g_currentColour[i]]=true;
-        }
+  compiled.valid=true;
 
-      }
+} // End EvaluationParameters::compileWeights.
+
+// -----------------------------------------------------------------------------
+
+template <EvalMode Mode>
+EvalScore<Mode> EvaluationParameters::evaluateWith(const Position &pos,const PieceSquareSums *sums,
+                                                   PawnHashTable *pawnTable)
+{ // Call the instantiation of evaluate() for the eval features in use (see
+  // getEvalFeatures()), so none of the flags are looked at inside the eval.
+
+  switch (evalFeatures) {
+    case 0:  return evaluate<Mode,0>(pos,sums,pawnTable);
+    case 1:  return evaluate<Mode,1>(pos,sums,pawnTable);
+    case 2:  return evaluate<Mode,2>(pos,sums,pawnTable);
+    case 3:  return evaluate<Mode,3>(pos,sums,pawnTable);
+    case 4:  return evaluate<Mode,4>(pos,sums,pawnTable);
+    case 5:  return evaluate<Mode,5>(pos,sums,pawnTable);
+    case 6:  return evaluate<Mode,6>(pos,sums,pawnTable);
+    default: return evaluate<Mode,7>(pos,sums,pawnTable);
+  }
+
+} // End EvaluationParameters::evaluateWith.
+
+// -----------------------------------------------------------------------------
+
+template <EvalMode Mode,unsigned Features>
+EvalScore<Mode> EvaluationParameters::evaluate(const Position &pos,const PieceSquareSums *sums,
+                                               PawnHashTable *pawnTable)
+{ // Eval and/or update weights at the same time (as per Mode, see EvalMode),
+  // with the optional features in Features (EVAL_* bits).
+  // NOTE: With the compiled weights the piece-square part is taken from the
+  //       running sums (so only the occupied squares are visited), and the
+  //       'singular' features are just counted by the functions for each
+  //       piece, and dotted with their weights at the end.
+  // NOTE: When learning the offset must already be set (see train()).
+
+  constexpr bool compiledWeights=(Mode==EvalMode::COMPILED);
+  constexpr bool kingDistanceFeatures=((Features&EVAL_KING_DISTANCE)!=0);
+  constexpr bool emptySquareFeatures=((Features&EVAL_EMPTY_SQUARES)!=0);
+  constexpr bool superFastEval=((Features&EVAL_SUPER_FAST)!=0);
 
-    } // End 1st PASS.
+  // This is the score to be returned for the position.
+  EvalScore<Mode> score=0;
+
+  // First find what stage we are on (Save this outside, so function can see).
+  stage=getStage(pos);
+
+  // Start from the running piece-square sums (worked out now if for another stage).
+  if constexpr (compiledWeights) {
+    if (!compiled.valid)
+      compileWeights();
+    std::fill(&featureCounts[0][0],&featureCounts[0][0]+2*FEATURE_STRIDE,int16_t(0));
+    if (sums!=nullptr && sums->stage==stage)
+      score=sums->score[pos.currentSide];
+    else {
+      PieceSquareSums stageSums;
+      initPieceSquareSums(pos,stageSums);
+      score=stageSums.score[pos.currentSide];
+    }
   }
 
+  // See if we are looking from white or black perspective and decide to flip.
+  bool flipBoard=(pos.currentSide==WHITE?false:true);
+
+  // 1st PASS: Set up pawnCount and pawnRank + Minor peice flags.
+  PawnHashEntry localPawnEntry;
+  const PawnHashEntry *pawnEntry=&localPawnEntry;
+  if constexpr (!superFastEval)
+    setupPawnsAndMinors(pos,pawnTable,localPawnEntry,pawnEntry);
+
   // 2nd PASS: For each square, activate the corresponding feature.
-  for (int i=0;i<BOARD_SQUARES;i++) {
+  Bitboard squares=compiledWeights ? (pos.currentState->colourBB[WHITE]|pos.currentState->colourBB[BLACK])
+                                   : ~Bitboard(0);
+  while (squares) {
+    const int i=popFirstSquare(squares);
 
     // Is it one of our peices?
-    if (g_currentColour[i]==g_currentSide) {
+    if (pos.currentColour[i]==pos.currentSide) {
 
       // Add the piece-square score.
-      score+=addWeight(psValues[stage][g_currentPiece[i]][flipIfNeeded(flipBoard,i)]);
+      if constexpr (!compiledWeights)
+        score+=addWeight<Mode>(psValues[stage][pos.currentPiece[i]][flipIfNeeded(flipBoard,i)]);
 
       // Add the king-distance scores.
-      if (useKingDistanceFeatures) {
-        score+=addWeightScaled(kingDistanceOwn[stage][g_currentPiece[i]],
-                        getDistanceToOwnKingManhattan(i));
-        score+=addWeightScaled(kingDistanceOther[stage][g_currentPiece[i]],
-                        getDistanceToOtherKingManhattan(i));
+      if constexpr (kingDistanceFeatures) {
+        if constexpr (compiledWeights) {
+          score+=compiled.kingDistanceOwn[stage][pos.currentPiece[i]]*getDistanceToOwnKingManhattan(pos,i);
+          score+=compiled.kingDistanceOther[stage][pos.currentPiece[i]]*getDistanceToOtherKingManhattan(pos,i);
+        }
+        else {
+          score+=addWeightScaled<Mode>(kingDistanceOwn[stage][pos.currentPiece[i]],
+                                       getDistanceToOwnKingManhattan(pos,i));
+          score+=addWeightScaled<Mode>(kingDistanceOther[stage][pos.currentPiece[i]],
+                                       getDistanceToOtherKingManhattan(pos,i));
+        }
       }
 
     }
 
     // Is it our opponents peice?
-    else if (g_currentColour[i]==getOtherSide(g_currentSide)) {
+    else if (pos.currentColour[i]==getOtherSide(pos.currentSide)) {
 
       // Add the piece-square score.
-      score+=addWeight(psValues[stage][g_currentPiece[i]+6][flipIfNeeded(flipBoard,i)]);
+      if constexpr (!compiledWeights)
+        score+=addWeight<Mode>(psValues[stage][pos.currentPiece[i]+6][flipIfNeeded(flipBoard,i)]);
 
       // Add the king-distance scores.
-      if (useKingDistanceFeatures) {
-        score+=addWeightScaled(kingDistanceOwn[stage][g_currentPiece[i]+6],
-                        getDistanceToOwnKingManhattan(i));
-        score+=addWeightScaled(kingDistanceOther[stage][g_currentPiece[i]+6],
-                        getDistanceToOtherKingManhattan(i));
+      if constexpr (kingDistanceFeatures) {
+        if constexpr (compiledWeights) {
+          score+=compiled.kingDistanceOwn[stage][pos.currentPiece[i]+6]*getDistanceToOwnKingManhattan(pos,i);
+          score+=compiled.kingDistanceOther[stage][pos.currentPiece[i]+6]*getDistanceToOtherKingManhattan(pos,i);
+        }
+        else {
+          score+=addWeightScaled<Mode>(kingDistanceOwn[stage][pos.currentPiece[i]+6],
+                                       getDistanceToOwnKingManhattan(pos,i));
+          score+=addWeightScaled<Mode>(kingDistanceOther[stage][pos.currentPiece[i]+6],
+                                       getDistanceToOtherKingManhattan(pos,i));
+        }
       }
 
     }
 
-    // Must be an empty square then.
-    else if (useEmptySquareFeatures) {
+    // Must be an empty square then (only visited without the running sums).
+    else if constexpr (emptySquareFeatures && !compiledWeights) {
 
       // Add the piece-square score.
-      score+=addWeight(psValues[stage][12][flipIfNeeded(flipBoard,i)]);
+      score+=addWeight<Mode>(psValues[stage][12][flipIfNeeded(flipBoard,i)]);
 
     }
 
-    // Call the function for the peice to evaluate it.
-    if (!useSuperFastEval) {
-      if (g_currentPiece[i]==PAWN)
-        score+=evalPawn(i);
-      else if (g_currentPiece[i]==KNIGHT)
-        score+=evalKnight(i);
-      else if (g_currentPiece[i]==BISHOP)
-        score+=evalBishop(i);
-      else if (g_currentPiece[i]==ROOK)
-        score+=evalRook(i);
-      else if (g_currentPiece[i]==QUEEN)
-        score+=evalQueen(i);
-      else if (g_currentPiece[i]==KING)
-        score+=evalKing(i);
+    // Call the function for the peice to evaluate it (pawns are done below).
+    if constexpr (!superFastEval) {
+      double pieceScore=0.0;
+      if (pos.currentPiece[i]==KNIGHT)
+        pieceScore=evalKnight<Mode>(pos,i);
+      else if (pos.currentPiece[i]==BISHOP)
+        pieceScore=evalBishop<Mode>(pos,i);
+      else if (pos.currentPiece[i]==ROOK)
+        pieceScore=evalRook<Mode>(pos,i);
+      else if (pos.currentPiece[i]==QUEEN)
+        pieceScore=evalQueen<Mode>(pos,i);
+      else if (pos.currentPiece[i]==KING)
+        pieceScore=evalKing<Mode>(pos,i);
+      if constexpr (!compiledWeights)
+        score+=pieceScore;
     }
 
   } // End for each square.
 
+  // Add all the pawns' features (then, with the compiled weights, all the counts).
+  if constexpr (!superFastEval) {
+    if constexpr (compiledWeights) {
+      evalPawns<Mode>(pos,*pawnEntry);
+      score+=dotProduct(&compiled.features[stage][0][0],&featureCounts[0][0],2*FEATURE_STRIDE);
+    }
+    else
+      score+=evalPawns<Mode>(pos,*pawnEntry);
+  }
+
   // Return the score.
   return score;
 
-} // End EvaluationParameters::evalAndLearn.
+} // End EvaluationParameters::evaluate.
 
 // -----------------------------------------------------------------------------
 
-double EvaluationParameters::evalPawn(int square)
-{ // Eval the pawn at square.
+void EvaluationParameters::setupPawnEntry(const Position &pos,PawnHashEntry &entry)
+{ // Work out the pawns' entry from scratch (see PawnHashEntry).
 
-  // This is the score to be returned for the knight.
-  double score=0.0;
+  entry=PawnHashEntry();
+  entry.key=pos.currentState->pawnKey;
 
-  // Is this feature for our side or the opponets ([0]=us, [1]=Opponent)?
-  int sideIndex=(g_currentColour[square]==g_currentSide?0:1);
+  // Setup the pawnCount and pawnRank arrays.
+  Bitboard pawns=pos.currentState->pieceBB[PAWN];
+  while (pawns) {
+    const int i=popFirstSquare(pawns);
+    entry.pawnCount[pos.currentColour[i]][getFile(i)+1]++;
+    if (pos.currentColour[i]==WHITE) {
+      if (entry.pawnRank[WHITE][getFile(i)+1]<getRank(i))
+        entry.pawnRank[WHITE][getFile(i)+1]=static_cast<int8_t>(getRank(i));
+    }
+    else {
+      if (entry.pawnRank[BLACK][getFile(i)+1]>getRank(i))
+        entry.pawnRank[BLACK][getFile(i)+1]=static_cast<int8_t>(getRank(i));
+    }
+  }
+
+  // Then each pawn's features (which need the arrays).
+  pawns=pos.currentState->pieceBB[PAWN];
+  while (pawns)
+    countPawnFeatures(pos,popFirstSquare(pawns),entry);
+
+} // End EvaluationParameters::setupPawnEntry.
+
+// -----------------------------------------------------------------------------
+
+void EvaluationParameters::countPawnFeatures(const Position &pos,int square,PawnHashEntry &entry)
+{ // Add the features of the pawn at square to the entry (see evalPawns()).
+  // NOTE: Only looks at the pawns, so the entry can be kept in the pawn hash.
 
   int file=getFile(square)+1;    // The pawn's file.
   int protectedBy=0;              // How may freindly pawns protect us (0/1/2),
-  int side=g_currentColour[square]; // The side we are on for this piece.
+  int side=pos.currentColour[square]; // The side we are on for this piece.
+
+  // Turn a feature on for this side (times times).
+  auto count=[&entry,side](int feature,int times=1) {
+    entry.features[side][feature-FIRST_PAWN_FEATURE]+=static_cast<int8_t>(times);
+  };
 
   // If there's a pawn behind this one, it's doubled.
   // Also if there are 3 or more pawns of a colour on a file the value is
   // multplied N-1 times (ie a trippled pawn is twice as bad!).
   if (side==WHITE) {
-    if (pawnRank[side][file]>getRank(square))
-      score+=addWeightSingular(weights[stage][DOUBLED_PAWN],sideIndex);
+    if (entry.pawnRank[side][file]>getRank(square))
+      count(DOUBLED_PAWN);
   }
   else {
-    if (pawnRank[side][file]<getRank(square))
-      score+=addWeightSingular(weights[stage][DOUBLED_PAWN],sideIndex);
+    if (entry.pawnRank[side][file]<getRank(square))
+      count(DOUBLED_PAWN);
   }
 
   // If there aren't any friendly pawns on either side of this one, it's
   // isolated.
-  if ((!pawnCount[side][file-1]) && (!pawnCount[side][file+1]))
-    score+=addWeightSingular(weights[stage][ISOLATED_PAWN],sideIndex);
+  if ((!entry.pawnCount[side][file-1]) && (!entry.pawnCount[side][file+1]))
+    count(ISOLATED_PAWN);
 
   // If it's not isolated, it might be backwards.
   // JUK: Added the fact that a backward pawn must have no hostile pawn
@@ -551,53 +873,53 @@ double EvaluationParameters::evalPawn(int square)
   // clean_up6: Fixed bug where a pawn was backward on it's first rank,
   //            if it's neighbour had only moved 1 square - now it's 2 squares!
   else if (side==WHITE) {
-    if ((getRank(square)==6 && pawnRank[side][file-1]<(getRank(square)-1)
-         && pawnRank[side][file+1]<(getRank(square)-1))
-        || (getRank(square)<6 && pawnRank[side][file-1]<getRank(square)
-            && pawnRank[side][file+1]<getRank(square))) {
+    if ((getRank(square)==6 && entry.pawnRank[side][file-1]<(getRank(square)-1)
+         && entry.pawnRank[side][file+1]<(getRank(square)-1))
+        || (getRank(square)<6 && entry.pawnRank[side][file-1]<getRank(square)
+            && entry.pawnRank[side][file+1]<getRank(square))) {
 
       // See if it's backward or semi-backward.
-      if (pawnCount[BLACK][file]==0)
-        score+=addWeightSingular(weights[stage][BACKWARD_PAWN],sideIndex);
+      if (entry.pawnCount[BLACK][file]==0)
+        count(BACKWARD_PAWN);
       else
-        score+=addWeightSingular(weights[stage][SEMI_BACKWARD_PAWN],sideIndex);
+        count(SEMI_BACKWARD_PAWN);
 
       // See if the backward Pawn's square in front is attacked by pawn(s).
       if (getFile(square)>0 && getRank(square)>2
-          && g_currentPiece[square-17]==PAWN
-          && g_currentColour[square-17]==getOtherSide(side)) {
-        score+=addWeightSingular(weights[stage][BACKWARD_ATTACK],sideIndex);
+          && pos.currentPiece[square-17]==PAWN
+          && pos.currentColour[square-17]==getOtherSide(side)) {
+        count(BACKWARD_ATTACK);
       }
       if (getFile(square)<7 && getRank(square)>2
-          && g_currentPiece[square-15]==PAWN
-          && g_currentColour[square-15]==getOtherSide(side)) {
-        score+=addWeightSingular(weights[stage][BACKWARD_ATTACK],sideIndex);
+          && pos.currentPiece[square-15]==PAWN
+          && pos.currentColour[square-15]==getOtherSide(side)) {
+        count(BACKWARD_ATTACK);
       }
 
     }
   }
   else {
-    if ((getRank(square)==1 && pawnRank[side][file-1]>(getRank(square)+1)
-         && pawnRank[side][file+1]>(getRank(square)+1))
-        || (getRank(square)>1 && pawnRank[side][file-1]>getRank(square)
-        && pawnRank[side][file+1]>getRank(square))) {
+    if ((getRank(square)==1 && entry.pawnRank[side][file-1]>(getRank(square)+1)
+         && entry.pawnRank[side][file+1]>(getRank(square)+1))
+        || (getRank(square)>1 && entry.pawnRank[side][file-1]>getRank(square)
+        && entry.pawnRank[side][file+1]>getRank(square))) {
 
       // See if it's backward or semi-backward.
-      if (pawnCount[WHITE][file]==0)
-        score+=addWeightSingular(weights[stage][BACKWARD_PAWN],sideIndex);
+      if (entry.pawnCount[WHITE][file]==0)
+        count(BACKWARD_PAWN);
       else
-        score+=addWeightSingular(weights[stage][SEMI_BACKWARD_PAWN],sideIndex);
+        count(SEMI_BACKWARD_PAWN);
 
       // See if the backward Pawn's square in front is attacked by pawn(s).
       if (getFile(square)>0 && getRank(square)<5
-          && g_currentPiece[square+15]==PAWN
-          && g_currentColour[square+15]==getOtherSide(side)) {
-        score+=addWeightSingular(weights[stage][BACKWARD_ATTACK],sideIndex);
+          && pos.currentPiece[square+15]==PAWN
+          && pos.currentColour[square+15]==getOtherSide(side)) {
+        count(BACKWARD_ATTACK);
       }
       if (getFile(square)<7 && getRank(square)<5
-          && g_currentPiece[square+17]==PAWN
-          && g_currentColour[square+17]==getOtherSide(side)) {
-        score+=addWeightSingular(weights[stage][BACKWARD_ATTACK],sideIndex);
+          && pos.currentPiece[square+17]==PAWN
+          && pos.currentColour[square+17]==getOtherSide(side)) {
+        count(BACKWARD_ATTACK);
       }
 
     }
@@ -605,39 +927,39 @@ double EvaluationParameters::evalPawn(int square)
 
   // See if the pawn if adjacent to other pawns (left or right).
   if (getFile(square)>0
-      && g_currentPiece[square-1]==PAWN && g_currentColour[square-1]==side) {
-    score+=addWeightSingular(weights[stage][ADJACENT_PAWNS],sideIndex);
+      && pos.currentPiece[square-1]==PAWN && pos.currentColour[square-1]==side) {
+    count(ADJACENT_PAWNS);
   }
   if (getFile(square)<7
-      && g_currentPiece[square+1]==PAWN && g_currentColour[square+1]==side) {
-     score+=addWeightSingular(weights[stage][ADJACENT_PAWNS],sideIndex);
+      && pos.currentPiece[square+1]==PAWN && pos.currentColour[square+1]==side) {
+     count(ADJACENT_PAWNS);
   }
 
   // See if the pawn if protected (ie: Chained) by other pawns (SE,SW).
   if (getFile(square)>0) {
     if (side==WHITE) {
-      if (g_currentPiece[square+7]==PAWN && g_currentColour[square+7]==side) {
-        score+=addWeightSingular(weights[stage][PAWN_CHAIN],sideIndex);
+      if (pos.currentPiece[square+7]==PAWN && pos.currentColour[square+7]==side) {
+        count(PAWN_CHAIN);
         protectedBy++;
       }
     }
     else {
-      if (g_currentPiece[square-9]==PAWN && g_currentColour[square-9]==side) {
-        score+=addWeightSingular(weights[stage][PAWN_CHAIN],sideIndex);
+      if (pos.currentPiece[square-9]==PAWN && pos.currentColour[square-9]==side) {
+        count(PAWN_CHAIN);
         protectedBy++;
       }
     }
   }
   if (getFile(square)<7) {
     if (side==WHITE) {
-      if (g_currentPiece[square+9]==PAWN && g_currentColour[square+9]==side) {
-        score+=addWeightSingular(weights[stage][PAWN_CHAIN],sideIndex);
+      if (pos.currentPiece[square+9]==PAWN && pos.currentColour[square+9]==side) {
+        count(PAWN_CHAIN);
         protectedBy++;
       }
     }
     else {
-      if (g_currentPiece[square-7]==PAWN && g_currentColour[square-7]==side) {
-        score+=addWeightSingular(weights[stage][PAWN_CHAIN],sideIndex);
+      if (pos.currentPiece[square-7]==PAWN && pos.currentColour[square-7]==side) {
+        count(PAWN_CHAIN);
         protectedBy++;
       }
     }
@@ -646,82 +968,114 @@ double EvaluationParameters::evalPawn(int square)
   // Past pawns.
   // clean_up6: Fixed another bug here, where the portected bit was being
   //            executed even if the pawn wasn't past!!!
-  if (side==WHITE && pawnRank[1-side][file-1]>=getRank(square)
-      && pawnRank[1-side][file]>=getRank(square)
-      && pawnRank[1-side][file+1]>=getRank(square)) {
+  if (side==WHITE && entry.pawnRank[1-side][file-1]>=getRank(square)
+      && entry.pawnRank[1-side][file]>=getRank(square)
+      && entry.pawnRank[1-side][file+1]>=getRank(square)) {
 
     // Multiply by how far up we are.
-    score+=addWeightSingularScaled(weights[stage][PASSED_PAWN],sideIndex,(7-getRank(square)));
+    count(PASSED_PAWN,(7-getRank(square)));
 
     // See if it's protected (from earlier).
     if (protectedBy>0)
-      score+=addWeightSingularScaled(weights[stage][PROT_PASSED_PAWN],sideIndex,(protectedBy));
+      count(PROT_PASSED_PAWN,protectedBy);
 
-    // See if it's blocked.
-    if (g_currentPiece[square-8]!=NONE)
-      score+=addWeightSingular(weights[stage][BLOCKED_PASSED_PAWN],sideIndex);
+    // See if it's blocked (done by evalPawns(), as any piece can block it).
+    entry.passedPawns[side]|=squareBB(square);
 
   }
-  else if (side==BLACK && pawnRank[1-side][file-1]<=getRank(square)
-           && pawnRank[1-side][file]<=getRank(square)
-           && pawnRank[1-side][file+1]<=getRank(square)) {
+  else if (side==BLACK && entry.pawnRank[1-side][file-1]<=getRank(square)
+           && entry.pawnRank[1-side][file]<=getRank(square)
+           && entry.pawnRank[1-side][file+1]<=getRank(square)) {
 
     // Multiply by how far up we are.
-    score+=addWeightSingularScaled(weights[stage][PASSED_PAWN],sideIndex,getRank(square));
+    count(PASSED_PAWN,getRank(square));
 
     // See if it's protected (from earlier).
     if (protectedBy>0)
-      score+=addWeightSingularScaled(weights[stage][PROT_PASSED_PAWN],sideIndex,(protectedBy));
+      count(PROT_PASSED_PAWN,protectedBy);
 
-    // See if it's blocked.
-    if (g_currentPiece[square+8]!=NONE)
-      score+=addWeightSingular(weights[stage][BLOCKED_PASSED_PAWN],sideIndex);
+    // See if it's blocked (done by evalPawns(), as any piece can block it).
+    entry.passedPawns[side]|=squareBB(square);
 
   }
 
   // Finally see if the pawn is in a local (ie: 3 window) majority.
-  if ((pawnCount[side][file-1]+pawnCount[side][file]+pawnCount[side][file+1])
-      >(pawnCount[1-side][file-1]+pawnCount[1-side][file]
-        +pawnCount[1-side][file+1])) {
-    score+=addWeightSingular(weights[stage][PAWN_MAJORITY],sideIndex);
+  if ((entry.pawnCount[side][file-1]+entry.pawnCount[side][file]+entry.pawnCount[side][file+1])
+      >(entry.pawnCount[1-side][file-1]+entry.pawnCount[1-side][file]
+        +entry.pawnCount[1-side][file+1])) {
+    count(PAWN_MAJORITY);
+  }
+
+} // End EvaluationParameters::countPawnFeatures.
+
+// -----------------------------------------------------------------------------
+
+template <EvalMode Mode>
+double EvaluationParameters::evalPawns(const Position &pos,const PawnHashEntry &entry)
+{ // Eval all the pawns, from the features in their entry.
+
+  // This is the score to be returned for the pawns.
+  double score=0.0;
+
+  const GameState &state=*pos.currentState;
+  const Bitboard occupied=state.colourBB[WHITE]|state.colourBB[BLACK];
+
+  for (int side=WHITE;side<=BLACK;side++) {
+
+    // Is this feature for our side or the opponets ([0]=us, [1]=Opponent)?
+    int sideIndex=(side==pos.currentSide?0:1);
+
+    // Each feature, as many times as it was turned on.
+    for (int i=0;i<NUM_PAWN_FEATURES;i++) {
+      if (entry.features[side][i]!=0)
+        score+=addFeature<Mode>(FIRST_PAWN_FEATURE+i,sideIndex,entry.features[side][i]);
+    }
+
+    // See if any passed pawns are blocked (by anything).
+    const Bitboard blocked=occupied&(side==WHITE ? entry.passedPawns[side]>>8
+                                                 : entry.passedPawns[side]<<8);
+    if (blocked)
+      score+=addFeature<Mode>(BLOCKED_PASSED_PAWN,sideIndex,countSquares(blocked));
+
   }
 
   return score;
 
-} // End EvaluationParameters::evalPawn.
+} // End EvaluationParameters::evalPawns.
 
 // -----------------------------------------------------------------------------
 
-double EvaluationParameters::evalKnight(int square)
+template <EvalMode Mode>
+double EvaluationParameters::evalKnight(const Position &pos,int square)
 { // Eval the knight at square.
 
   // This is the score to be returned for the knight.
   double score=0.0;
 
   // First see if we are looking at a black or white peice, and decide to flip.
-  bool flipBoard=(g_currentColour[square]==WHITE?false:true);
+  bool flipBoard=(pos.currentColour[square]==WHITE?false:true);
 
   // Is this feature for our side or the opponets ([0]=us, [1]=Opponent)?
-  int sideIndex=(g_currentColour[square]==g_currentSide?0:1);
+  int sideIndex=(pos.currentColour[square]==pos.currentSide?0:1);
 
   // Test to see if it's a f3/c3 knight with pawn above it and not below.
   if (flipIfNeeded(flipBoard,square)==C3
-      && g_currentPiece[flipIfNeeded(flipBoard,C4)]==PAWN
-      && g_currentColour[flipIfNeeded(flipBoard,C4)]==g_currentColour[square]
-      && !(g_currentPiece[flipIfNeeded(flipBoard,C2)]==PAWN
-           && g_currentColour[flipIfNeeded(flipBoard,C2)]==g_currentColour[square])) {
-    score+=addWeightSingular(weights[stage][NO_BLOCK_KNIGHT],sideIndex);
+      && pos.currentPiece[flipIfNeeded(flipBoard,C4)]==PAWN
+      && pos.currentColour[flipIfNeeded(flipBoard,C4)]==pos.currentColour[square]
+      && !(pos.currentPiece[flipIfNeeded(flipBoard,C2)]==PAWN
+           && pos.currentColour[flipIfNeeded(flipBoard,C2)]==pos.currentColour[square])) {
+    score+=addFeature<Mode>(NO_BLOCK_KNIGHT,sideIndex);
   }
   else if (flipIfNeeded(flipBoard,square)==F3
-           && g_currentPiece[flipIfNeeded(flipBoard,F4)]==PAWN
-           && g_currentColour[flipIfNeeded(flipBoard,F4)]==g_currentColour[square]
-           && !(g_currentPiece[flipIfNeeded(flipBoard,F2)]==PAWN
-                && g_currentColour[flipIfNeeded(flipBoard,F2)]==g_currentColour[square])) {
-    score+=addWeightSingular(weights[stage][NO_BLOCK_KNIGHT],sideIndex);
+           && pos.currentPiece[flipIfNeeded(flipBoard,F4)]==PAWN
+           && pos.currentColour[flipIfNeeded(flipBoard,F4)]==pos.currentColour[square]
+           && !(pos.currentPiece[flipIfNeeded(flipBoard,F2)]==PAWN
+                && pos.currentColour[flipIfNeeded(flipBoard,F2)]==pos.currentColour[square])) {
+    score+=addFeature<Mode>(NO_BLOCK_KNIGHT,sideIndex);
   }
 
   // Add forepost bonuses (if it is on a forepost).
-  score+=forepostBonus(square);
+  score+=forepostBonus<Mode>(pos,square);
 
   return score;
 
@@ -729,37 +1083,38 @@ double EvaluationParameters::evalKnight(int square)
 
 // -----------------------------------------------------------------------------
 
-double EvaluationParameters::evalBishop(int square)
+template <EvalMode Mode>
+double EvaluationParameters::evalBishop(const Position &pos,int square)
 { // Eval the bishiop at square.
 
   // This is the score to be returned for the rook.
   double score=0.0;
 
   // First see if we are looking at a black or white peice, and decide to flip.
-  bool flipBoard=(g_currentColour[square]==WHITE?false:true);
+  bool flipBoard=(pos.currentColour[square]==WHITE?false:true);
 
   // Is this feature for our side or the opponets ([0]=us, [1]=Opponent)?
-  int sideIndex=(g_currentColour[square]==g_currentSide?0:1);
+  int sideIndex=(pos.currentColour[square]==pos.currentSide?0:1);
 
   // Test to see if it's a fienchetto.
   // NOTE: Must have pawn to edge and above...
   if (flipIfNeeded(flipBoard,square)==B2
-      && g_currentPiece[flipIfNeeded(flipBoard,B3)]==PAWN
-      && g_currentColour[flipIfNeeded(flipBoard,B3)]==g_currentColour[square]
-      && g_currentPiece[flipIfNeeded(flipBoard,A2)]==PAWN
-      && g_currentColour[flipIfNeeded(flipBoard,A2)]==g_currentColour[square]) {
-    score+=addWeightSingular(weights[stage][FIENCHETTO],sideIndex);
+      && pos.currentPiece[flipIfNeeded(flipBoard,B3)]==PAWN
+      && pos.currentColour[flipIfNeeded(flipBoard,B3)]==pos.currentColour[square]
+      && pos.currentPiece[flipIfNeeded(flipBoard,A2)]==PAWN
+      && pos.currentColour[flipIfNeeded(flipBoard,A2)]==pos.currentColour[square]) {
+    score+=addFeature<Mode>(FIENCHETTO,sideIndex);
   }
   else if (flipIfNeeded(flipBoard,square)==G2
-           && g_currentPiece[flipIfNeeded(flipBoard,G3)]==PAWN
-           && g_currentColour[flipIfNeeded(flipBoard,G3)]==g_currentColour[square]
-           && g_currentPiece[flipIfNeeded(flipBoard,H2)]==PAWN
-           && g_currentColour[flipIfNeeded(flipBoard,H2)]==g_currentColour[square]) {
-    score+=addWeightSingular(weights[stage][FIENCHETTO],sideIndex);
+           && pos.currentPiece[flipIfNeeded(flipBoard,G3)]==PAWN
+           && pos.currentColour[flipIfNeeded(flipBoard,G3)]==pos.currentColour[square]
+           && pos.currentPiece[flipIfNeeded(flipBoard,H2)]==PAWN
+           && pos.currentColour[flipIfNeeded(flipBoard,H2)]==pos.currentColour[square]) {
+    score+=addFeature<Mode>(FIENCHETTO,sideIndex);
   }
 
   // Add forepost bonuses (if it is on a forepost).
-  score+=forepostBonus(square);
+  score+=forepostBonus<Mode>(pos,square);
 
   return score;
 
@@ -767,32 +1122,33 @@ double EvaluationParameters::evalBishop(int square)
 
 // -----------------------------------------------------------------------------
 
-double EvaluationParameters::evalRook(int square)
+template <EvalMode Mode>
+double EvaluationParameters::evalRook(const Position &pos,int square)
 { // Eval the rook at square.
 
   // This is the score to be returned for the rook.
   double score=0.0;
 
   // First see if we are looking at a black or white peice, and decide to flip.
-  bool flipBoard=(g_currentColour[square]==WHITE?false:true);
+  bool flipBoard=(pos.currentColour[square]==WHITE?false:true);
 
   // Is this feature for our side or the opponets ([0]=us, [1]=Opponent)?
-  int sideIndex=(g_currentColour[square]==g_currentSide?0:1);
+  int sideIndex=(pos.currentColour[square]==pos.currentSide?0:1);
 
   // Give bonus for not moving before the king has.
-  if (getFile(g_currentState->kingSquare[g_currentColour[square]])==4) {
+  if (getFile(pos.currentState->kingSquare[pos.currentColour[square]])==4) {
     if (flipIfNeeded(flipBoard,square)==A1)
-      score+=addWeightSingular(weights[stage][ROOK_NO_MOVE],sideIndex);
+      score+=addFeature<Mode>(ROOK_NO_MOVE,sideIndex);
     else if (flipIfNeeded(flipBoard,square)==H1)
-      score+=addWeightSingular(weights[stage][ROOK_NO_MOVE],sideIndex);
+      score+=addFeature<Mode>(ROOK_NO_MOVE,sideIndex);
   }
 
   // Test for Rook being on a semi-open or open file.
-  if (pawnCount[g_currentColour[square]][getFile(square)+1]==0) {
-    if (pawnCount[1-g_currentColour[square]][getFile(square)+1]==0)
-      score+=addWeightSingular(weights[stage][ROOK_OPEN_FILE],sideIndex);
+  if (pawnCount[pos.currentColour[square]][getFile(square)+1]==0) {
+    if (pawnCount[1-pos.currentColour[square]][getFile(square)+1]==0)
+      score+=addFeature<Mode>(ROOK_OPEN_FILE,sideIndex);
     else
-      score+=addWeightSingular(weights[stage][ROOK_SEMI_OPEN_FILE],sideIndex);
+      score+=addFeature<Mode>(ROOK_SEMI_OPEN_FILE,sideIndex);
   }
 
   // Find out if there is another rook(s) or queen(s) on this file (Battery(s)).
@@ -800,9 +1156,9 @@ double EvaluationParameters::evalRook(int square)
   //       as this means the feature is only activated once.
   // NOTE: It not matter this way if we are white or black!
   for (int i=getRank(square)+8;i<64;i+=8) {
-    if (g_currentColour[i]==g_currentColour[square]
-        && (g_currentPiece[i]==ROOK || g_currentPiece[i]==QUEEN)) {
-      score+=addWeightSingular(weights[stage][BATTERY_BONUS],sideIndex);
+    if (pos.currentColour[i]==pos.currentColour[square]
+        && (pos.currentPiece[i]==ROOK || pos.currentPiece[i]==QUEEN)) {
+      score+=addFeature<Mode>(BATTERY_BONUS,sideIndex);
       break;  // Break so that the one behind can test for a 3rd one of file.
     }
   }
@@ -813,21 +1169,22 @@ double EvaluationParameters::evalRook(int square)
 
 // -----------------------------------------------------------------------------
 
-double EvaluationParameters::evalQueen(int square)
+template <EvalMode Mode>
+double EvaluationParameters::evalQueen(const Position &pos,int square)
 { // Eval the queen at square.
 
   // This is the score to be returned for the queen.
   double score=0.0;
 
   // Is this feature for our side or the opponets ([0]=us, [1]=Opponent)?
-  int sideIndex=(g_currentColour[square]==g_currentSide?0:1);
+  int sideIndex=(pos.currentColour[square]==pos.currentSide?0:1);
 
   // Test for Queen being on a semi-open or open file.
-  if (pawnCount[g_currentColour[square]][getFile(square)+1]==0) {
-    if (pawnCount[1-g_currentColour[square]][getFile(square)+1]==0)
-      score+=addWeightSingular(weights[stage][QUEEN_OPEN_FILE],sideIndex);
+  if (pawnCount[pos.currentColour[square]][getFile(square)+1]==0) {
+    if (pawnCount[1-pos.currentColour[square]][getFile(square)+1]==0)
+      score+=addFeature<Mode>(QUEEN_OPEN_FILE,sideIndex);
     else
-      score+=addWeightSingular(weights[stage][QUEEN_SEMI_OPEN_FILE],sideIndex);
+      score+=addFeature<Mode>(QUEEN_SEMI_OPEN_FILE,sideIndex);
   }
 
   // Find out if there is another rook(s) or queen(s) on this file (Battery(s)).
@@ -835,9 +1192,9 @@ double EvaluationParameters::evalQueen(int square)
   //       as this means the feature is only activated once.
   // NOTE: It not matter this way if we are white or black!
   for (int i=getRank(square)+8;i<64;i+=8) {
-    if (g_currentColour[i]==g_currentColour[square]
-        && (g_currentPiece[i]==ROOK || g_currentPiece[i]==QUEEN)) {
-      score+=addWeightSingular(weights[stage][BATTERY_BONUS],sideIndex);
+    if (pos.currentColour[i]==pos.currentColour[square]
+        && (pos.currentPiece[i]==ROOK || pos.currentPiece[i]==QUEEN)) {
+      score+=addFeature<Mode>(BATTERY_BONUS,sideIndex);
       break;  // Break so that the one behind can test for a 3rd one of file.
     }
   }
@@ -848,72 +1205,73 @@ double EvaluationParameters::evalQueen(int square)
 
 // -----------------------------------------------------------------------------
 
-double EvaluationParameters::evalKing(int square)
+template <EvalMode Mode>
+double EvaluationParameters::evalKing(const Position &pos,int square)
 { // Eval the king at square.
 
   // This is the score to be returned for the king.
   double score=0.0;
 
   // First see if we are looking at a black or white peice, and decide to flip.
-  bool flipBoard=(g_currentColour[square]==WHITE?false:true);
+  bool flipBoard=(pos.currentColour[square]==WHITE?false:true);
 
   // Is this feature for our side or the opponets ([0]=us, [1]=Opponent)?
-  int sideIndex=(g_currentColour[square]==g_currentSide?0:1);
+  int sideIndex=(pos.currentColour[square]==pos.currentSide?0:1);
 
   // Now check for a pawn storm, infront of castled king.
   if (flipIfNeeded(flipBoard,square)==A1 || flipIfNeeded(flipBoard,square)==B1 || flipIfNeeded(flipBoard,square)==C1
       || flipIfNeeded(flipBoard,square)==A2 || flipIfNeeded(flipBoard,square)==B2 || flipIfNeeded(flipBoard,square)==C2) {
-    if (g_currentColour[flipIfNeeded(flipBoard,A2)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,A2)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,A2)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,A2)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,B2)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,B2)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,B2)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,B2)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,C2)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,C2)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,C2)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,C2)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,A3)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,A3)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,A3)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,A3)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,B3)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,B3)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,B3)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,B3)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,C3)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,C3)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,C3)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,C3)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
 
   }
   else if (flipIfNeeded(flipBoard,square)==F1 || flipIfNeeded(flipBoard,square)==G1 || flipIfNeeded(flipBoard,square)==H1
            || flipIfNeeded(flipBoard,square)==F2 || flipIfNeeded(flipBoard,square)==G2 || flipIfNeeded(flipBoard,square)==H2) {
-    if (g_currentColour[flipIfNeeded(flipBoard,F2)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,F2)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,F2)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,F2)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,G2)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,G2)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,G2)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,G2)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,H2)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,H2)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,H2)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,H2)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,F3)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,F3)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,F3)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,F3)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,G3)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,G3)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,G3)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,G3)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
-    if (g_currentColour[flipIfNeeded(flipBoard,H3)]==(1-g_currentColour[square])
-        && g_currentPiece[flipIfNeeded(flipBoard,H3)]==PAWN) {
-      score+=addWeightSingular(weights[stage][PAWN_STORM],sideIndex);
+    if (pos.currentColour[flipIfNeeded(flipBoard,H3)]==(1-pos.currentColour[square])
+        && pos.currentPiece[flipIfNeeded(flipBoard,H3)]==PAWN) {
+      score+=addFeature<Mode>(PAWN_STORM,sideIndex);
     }
 
   } // End Test for pawn storm.
@@ -922,126 +1280,126 @@ double EvaluationParameters::evalKing(int square)
   // Test for King on a1/b1/c1 or f1/g1/h1 + no rook on a1/a2 or h1/h2.
   if ((flipIfNeeded(flipBoard,square)==A1
        || (flipIfNeeded(flipBoard,square)==B1
-           && !(g_currentPiece[flipIfNeeded(flipBoard,A1)]==ROOK
-                && g_currentColour[flipIfNeeded(flipBoard,A1)]==g_currentColour[square]))
+           && !(pos.currentPiece[flipIfNeeded(flipBoard,A1)]==ROOK
+                && pos.currentColour[flipIfNeeded(flipBoard,A1)]==pos.currentColour[square]))
        || (flipIfNeeded(flipBoard,square)==C1
-          && !(g_currentPiece[flipIfNeeded(flipBoard,A1)]==ROOK
-                && g_currentColour[flipIfNeeded(flipBoard,A1)]==g_currentColour[square])
-           && !(g_currentPiece[flipIfNeeded(flipBoard,B1)]==ROOK
-                && g_currentColour[flipIfNeeded(flipBoard,B1)]==g_currentColour[square])))) {
+          && !(pos.currentPiece[flipIfNeeded(flipBoard,A1)]==ROOK
+                && pos.currentColour[flipIfNeeded(flipBoard,A1)]==pos.currentColour[square])
+           && !(pos.currentPiece[flipIfNeeded(flipBoard,B1)]==ROOK
+                && pos.currentColour[flipIfNeeded(flipBoard,B1)]==pos.currentColour[square])))) {
 
     // Give the bonus for castling then.
-    score+=addWeightSingular(weights[stage][CASTLE_BONUS],sideIndex);
+    score+=addFeature<Mode>(CASTLE_BONUS,sideIndex);
 
     // Now check for a good pawn defence, infront of castled king.
-    if (!(g_currentPiece[flipIfNeeded(flipBoard,A2)]==PAWN
-          && g_currentColour[flipIfNeeded(flipBoard,A2)]==g_currentColour[square])) {
-      score+=addWeightSingular(weights[stage][CASTLE_MISSING_PAWN],sideIndex);
+    if (!(pos.currentPiece[flipIfNeeded(flipBoard,A2)]==PAWN
+          && pos.currentColour[flipIfNeeded(flipBoard,A2)]==pos.currentColour[square])) {
+      score+=addFeature<Mode>(CASTLE_MISSING_PAWN,sideIndex);
     }
-    if (!(g_currentPiece[flipIfNeeded(flipBoard,B2)]==PAWN
-          && g_currentColour[flipIfNeeded(flipBoard,B2)]==g_currentColour[square])) {
+    if (!(pos.currentPiece[flipIfNeeded(flipBoard,B2)]==PAWN
+          && pos.currentColour[flipIfNeeded(flipBoard,B2)]==pos.currentColour[square])) {
 
       // Check first to see if we have a fiencheto defence.
-      if (g_currentPiece[flipIfNeeded(flipBoard,B3)]==PAWN
-          && g_currentColour[flipIfNeeded(flipBoard,B3)]==g_currentColour[square]
-          && g_currentPiece[flipIfNeeded(flipBoard,B2)]==BISHOP
-          && g_currentColour[flipIfNeeded(flipBoard,B2)]==g_currentColour[square]) {
-        score+=addWeightSingular(weights[stage][CASTLE_FIENCHETTO],sideIndex);
+      if (pos.currentPiece[flipIfNeeded(flipBoard,B3)]==PAWN
+          && pos.currentColour[flipIfNeeded(flipBoard,B3)]==pos.currentColour[square]
+          && pos.currentPiece[flipIfNeeded(flipBoard,B2)]==BISHOP
+          && pos.currentColour[flipIfNeeded(flipBoard,B2)]==pos.currentColour[square]) {
+        score+=addFeature<Mode>(CASTLE_FIENCHETTO,sideIndex);
       }
       else {
-        score+=addWeightSingular(weights[stage][CASTLE_MISSING_PAWN],sideIndex);
+        score+=addFeature<Mode>(CASTLE_MISSING_PAWN,sideIndex);
       }
 
     }
-    if (!(g_currentPiece[flipIfNeeded(flipBoard,C2)]==PAWN
-          && g_currentColour[flipIfNeeded(flipBoard,C2)]==g_currentColour[square])) {
-      score+=addWeightSingular(weights[stage][CASTLE_MISSING_PAWN],sideIndex);
+    if (!(pos.currentPiece[flipIfNeeded(flipBoard,C2)]==PAWN
+          && pos.currentColour[flipIfNeeded(flipBoard,C2)]==pos.currentColour[square])) {
+      score+=addFeature<Mode>(CASTLE_MISSING_PAWN,sideIndex);
     }
 
     // Do we have a propective knight at C3?
-    if (g_currentPiece[flipIfNeeded(flipBoard,C3)]==KNIGHT
-        && g_currentColour[flipIfNeeded(flipBoard,C3)]==g_currentColour[square]) {
-      score+=addWeightSingular(weights[stage][CASTLE_KNIGHT_PROT],sideIndex);
+    if (pos.currentPiece[flipIfNeeded(flipBoard,C3)]==KNIGHT
+        && pos.currentColour[flipIfNeeded(flipBoard,C3)]==pos.currentColour[square]) {
+      score+=addFeature<Mode>(CASTLE_KNIGHT_PROT,sideIndex);
     }
 
   }
   else if ((flipIfNeeded(flipBoard,square)==H1
            || (flipIfNeeded(flipBoard,square)==G1
-               && !(g_currentPiece[flipIfNeeded(flipBoard,H1)]==ROOK
-                    && g_currentColour[flipIfNeeded(flipBoard,H1)]==g_currentColour[square]))
+               && !(pos.currentPiece[flipIfNeeded(flipBoard,H1)]==ROOK
+                    && pos.currentColour[flipIfNeeded(flipBoard,H1)]==pos.currentColour[square]))
            || (flipIfNeeded(flipBoard,square)==F1
-               && !(g_currentPiece[flipIfNeeded(flipBoard,H1)]==ROOK
-                    && g_currentColour[flipIfNeeded(flipBoard,H1)]==g_currentColour[square])
-               && !(g_currentPiece[flipIfNeeded(flipBoard,G1)]==ROOK
-                    && g_currentColour[flipIfNeeded(flipBoard,G1)]==g_currentColour[square])))) {
+               && !(pos.currentPiece[flipIfNeeded(flipBoard,H1)]==ROOK
+                    && pos.currentColour[flipIfNeeded(flipBoard,H1)]==pos.currentColour[square])
+               && !(pos.currentPiece[flipIfNeeded(flipBoard,G1)]==ROOK
+                    && pos.currentColour[flipIfNeeded(flipBoard,G1)]==pos.currentColour[square])))) {
 
     // Give the bonus for castling then.
-    score+=addWeightSingular(weights[stage][CASTLE_BONUS],sideIndex);
+    score+=addFeature<Mode>(CASTLE_BONUS,sideIndex);
 
     // Now check for a good pawn defence, infront of castled king.
-    if (!(g_currentPiece[flipIfNeeded(flipBoard,F2)]==PAWN
-          && g_currentColour[flipIfNeeded(flipBoard,F2)]==g_currentColour[square])) {
-      score+=addWeightSingular(weights[stage][CASTLE_MISSING_PAWN],sideIndex);
+    if (!(pos.currentPiece[flipIfNeeded(flipBoard,F2)]==PAWN
+          && pos.currentColour[flipIfNeeded(flipBoard,F2)]==pos.currentColour[square])) {
+      score+=addFeature<Mode>(CASTLE_MISSING_PAWN,sideIndex);
     }
-    if (!(g_currentPiece[flipIfNeeded(flipBoard,G2)]==PAWN
-          && g_currentColour[flipIfNeeded(flipBoard,G2)]==g_currentColour[square])) {
+    if (!(pos.currentPiece[flipIfNeeded(flipBoard,G2)]==PAWN
+          && pos.currentColour[flipIfNeeded(flipBoard,G2)]==pos.currentColour[square])) {
 
       // Check first to see if we have a fiencheto defence.
-      if (g_currentPiece[flipIfNeeded(flipBoard,G3)]==PAWN
-          && g_currentColour[flipIfNeeded(flipBoard,G3)]==g_currentColour[square]
-          && g_currentPiece[flipIfNeeded(flipBoard,G2)]==BISHOP
-          && g_currentColour[flipIfNeeded(flipBoard,G2)]==g_currentColour[square]) {
-        score+=addWeightSingular(weights[stage][CASTLE_FIENCHETTO],sideIndex);
+      if (pos.currentPiece[flipIfNeeded(flipBoard,G3)]==PAWN
+          && pos.currentColour[flipIfNeeded(flipBoard,G3)]==pos.currentColour[square]
+          && pos.currentPiece[flipIfNeeded(flipBoard,G2)]==BISHOP
+          && pos.currentColour[flipIfNeeded(flipBoard,G2)]==pos.currentColour[square]) {
+        score+=addFeature<Mode>(CASTLE_FIENCHETTO,sideIndex);
       }
       else {
-        score+=addWeightSingular(weights[stage][CASTLE_MISSING_PAWN],sideIndex);
+        score+=addFeature<Mode>(CASTLE_MISSING_PAWN,sideIndex);
       }
 
     }
-    if (!(g_currentPiece[flipIfNeeded(flipBoard,H2)]==PAWN
-          && g_currentColour[flipIfNeeded(flipBoard,H2)]==g_currentColour[square])) {
-      score+=addWeightSingular(weights[stage][CASTLE_MISSING_PAWN],sideIndex);
+    if (!(pos.currentPiece[flipIfNeeded(flipBoard,H2)]==PAWN
+          && pos.currentColour[flipIfNeeded(flipBoard,H2)]==pos.currentColour[square])) {
+      score+=addFeature<Mode>(CASTLE_MISSING_PAWN,sideIndex);
     }
 
     // Do we have a propective knight at F3?
-    if (g_currentPiece[flipIfNeeded(flipBoard,F3)]==KNIGHT
-        && g_currentColour[flipIfNeeded(flipBoard,F3)]==g_currentColour[square]) {
-      score+=addWeightSingular(weights[stage][CASTLE_KNIGHT_PROT],sideIndex);
+    if (pos.currentPiece[flipIfNeeded(flipBoard,F3)]==KNIGHT
+        && pos.currentColour[flipIfNeeded(flipBoard,F3)]==pos.currentColour[square]) {
+      score+=addFeature<Mode>(CASTLE_KNIGHT_PROT,sideIndex);
     }
 
   }
 
   // Test for King being on a semi-open or open file.
-  if (pawnCount[g_currentColour[square]][getFile(square)+1]==0) {
-    if (pawnCount[1-g_currentColour[square]][getFile(square)+1]==0)
-      score+=addWeightSingular(weights[stage][KING_OPEN_FILE],sideIndex);
+  if (pawnCount[pos.currentColour[square]][getFile(square)+1]==0) {
+    if (pawnCount[1-pos.currentColour[square]][getFile(square)+1]==0)
+      score+=addFeature<Mode>(KING_OPEN_FILE,sideIndex);
     else
-      score+=addWeightSingular(weights[stage][KING_SEMI_OPEN_FILE],sideIndex);
+      score+=addFeature<Mode>(KING_SEMI_OPEN_FILE,sideIndex);
   }
 
   // Test for the king having semi-open or open files to its left and right.
   if (getFile(square)>0
-      && pawnCount[g_currentColour[square]][getFile(square)]==0) {
-    if (pawnCount[1-g_currentColour[square]][getFile(square)]==0)
-      score+=addWeightSingular(weights[stage][KING_OPEN_FILE_SIDE],sideIndex);
+      && pawnCount[pos.currentColour[square]][getFile(square)]==0) {
+    if (pawnCount[1-pos.currentColour[square]][getFile(square)]==0)
+      score+=addFeature<Mode>(KING_OPEN_FILE_SIDE,sideIndex);
     else
-      score+=addWeightSingular(weights[stage][KING_SEMI_OPEN_FILE_SIDE],sideIndex);
+      score+=addFeature<Mode>(KING_SEMI_OPEN_FILE_SIDE,sideIndex);
   }
   if (getFile(square)<7
-      && pawnCount[g_currentColour[square]][getFile(square)+2]==0) {
-    if (pawnCount[1-g_currentColour[square]][getFile(square)+2]==0)
-      score+=addWeightSingular(weights[stage][KING_OPEN_FILE_SIDE],sideIndex);
+      && pawnCount[pos.currentColour[square]][getFile(square)+2]==0) {
+    if (pawnCount[1-pos.currentColour[square]][getFile(square)+2]==0)
+      score+=addFeature<Mode>(KING_OPEN_FILE_SIDE,sideIndex);
     else
-      score+=addWeightSingular(weights[stage][KING_SEMI_OPEN_FILE_SIDE],sideIndex);
+      score+=addFeature<Mode>(KING_SEMI_OPEN_FILE_SIDE,sideIndex);
   }
 
   // Find out if there is an opposing rook(s) or queen(s) on file/rank.
   for (int i=0;i<64;i++) {
     if (getFile(i)==getFile(square) || getRank(i)==getRank(square)) {
-      if (g_currentPiece[i]==ROOK && g_currentColour[i]==(1-g_currentColour[square]))
-        score+=addWeightSingular(weights[stage][KING_ROOK_XRAY],sideIndex);
-      if (g_currentPiece[i]==QUEEN && g_currentColour[i]==(1-g_currentColour[square]))
-        score+=addWeightSingular(weights[stage][KING_QUEEN_XRAY],sideIndex);
+      if (pos.currentPiece[i]==ROOK && pos.currentColour[i]==(1-pos.currentColour[square]))
+        score+=addFeature<Mode>(KING_ROOK_XRAY,sideIndex);
+      if (pos.currentPiece[i]==QUEEN && pos.currentColour[i]==(1-pos.currentColour[square]))
+        score+=addFeature<Mode>(KING_QUEEN_XRAY,sideIndex);
     }
   }
 
@@ -1052,7 +1410,8 @@ double EvaluationParameters::evalKing(int square)
 
 // =============================================================================
 
-double EvaluationParameters::forepostBonus(int square)
+template <EvalMode Mode>
+double EvaluationParameters::forepostBonus(const Position &pos,int square)
 { // This function checks if the piece on the square is on a forepost, and
   // returns any bonuses for it (ie: basic, absolute, protected, ...).
   // NOTE: It would be better later on to have the protection test not use
@@ -1065,13 +1424,13 @@ double EvaluationParameters::forepostBonus(int square)
   int file=getFile(square)+1;     // Add 1 because of the extra file in array.
 
   // Is this feature for our side or the opponets ([0]=us, [1]=Opponent)?
-  int sideIndex=(g_currentColour[square]==g_currentSide?0:1);
+  int sideIndex=(pos.currentColour[square]==pos.currentSide?0:1);
 
   // If it is a Knight use the feature index, if its a bishop add 1 to it.
-  int pieceTypeOffset=(g_currentPiece[square]==KNIGHT?0:1);
+  int pieceTypeOffset=(pos.currentPiece[square]==KNIGHT?0:1);
 
   // Depends on which side we are.
-  if (g_currentColour[square]==WHITE) {
+  if (pos.currentColour[square]==WHITE) {
 
     // Check for forepost (Can't have a forepost on back rank!).
     if (getRank(square)>0
@@ -1079,19 +1438,19 @@ double EvaluationParameters::forepostBonus(int square)
         && (pawnRank[BLACK][file+1]>=getRank(square))) {
 
       // Add the forepost bonus.
-      score+=addWeightSingular(weights[stage][FOREPOST_BONUS+pieceTypeOffset],sideIndex);
+      score+=addFeature<Mode>(FOREPOST_BONUS+pieceTypeOffset,sideIndex);
 
       // See how many pawns protect the forepost.
       // Would be better not to use pawn rank table!!!
       if (pawnRank[WHITE][file-1]==(getRank(square)+1))
-        score+=addWeightSingular(weights[stage][PROTECTED_FOREPOST+pieceTypeOffset],sideIndex);
+        score+=addFeature<Mode>(PROTECTED_FOREPOST+pieceTypeOffset,sideIndex);
       if (pawnRank[WHITE][file+1]==(getRank(square)+1))
-        score+=addWeightSingular(weights[stage][PROTECTED_FOREPOST+pieceTypeOffset],sideIndex);
+        score+=addFeature<Mode>(PROTECTED_FOREPOST+pieceTypeOffset,sideIndex);
 
       // Is there an enemy pawn infront of this square.
-      if (g_currentPiece[square-8]==PAWN
-          && g_currentColour[square-8]==BLACK) {
-        score+=addWeightSingular(weights[stage][PAWN_INFRONT_FOREPOST+pieceTypeOffset],sideIndex);
+      if (pos.currentPiece[square-8]==PAWN
+          && pos.currentColour[square-8]==BLACK) {
+        score+=addFeature<Mode>(PAWN_INFRONT_FOREPOST+pieceTypeOffset,sideIndex);
       }
 
     }
@@ -1106,19 +1465,19 @@ double EvaluationParameters::forepostBonus(int square)
         && (pawnRank[WHITE][file+1]<=getRank(square))) {
 
       // Add the forepost bonus.
-      score+=addWeightSingular(weights[stage][FOREPOST_BONUS+pieceTypeOffset],sideIndex);
+      score+=addFeature<Mode>(FOREPOST_BONUS+pieceTypeOffset,sideIndex);
 
       // See how many pawns protect the forepost.
       // Would be better not to use pawn rank table!!!
       if (pawnRank[BLACK][file-1]==getRank(square)-1)
-        score+=addWeightSingular(weights[stage][PROTECTED_FOREPOST+pieceTypeOffset],sideIndex);
+        score+=addFeature<Mode>(PROTECTED_FOREPOST+pieceTypeOffset,sideIndex);
       if (pawnRank[BLACK][file+1]==getRank(square)-1)
-        score+=addWeightSingular(weights[stage][PROTECTED_FOREPOST+pieceTypeOffset],sideIndex);
+        score+=addFeature<Mode>(PROTECTED_FOREPOST+pieceTypeOffset,sideIndex);
 
       // Is there an enemy pawn infront of this square.
-      if (g_currentPiece[square+8]==PAWN
-          && g_currentColour[square+8]==WHITE) {
-        score+=addWeightSingular(weights[stage][PAWN_INFRONT_FOREPOST+pieceTypeOffset],sideIndex);
+      if (pos.currentPiece[square+8]==PAWN
+          && pos.currentColour[square+8]==WHITE) {
+        score+=addFeature<Mode>(PAWN_INFRONT_FOREPOST+pieceTypeOffset,sideIndex);
       }
 
     }
@@ -1127,23 +1486,23 @@ double EvaluationParameters::forepostBonus(int square)
 
   // Test if the minor peice can actuallt be attacked by opponents minor peice
   // to find out if it is absolute.
-  if (hasKnights[1-g_currentColour[square]]==false) {
+  if (hasKnights[1-pos.currentColour[square]]==false) {
     if ((square/8)%2==0) {
-      if (square%2==0 && hasWhiteSquareBishop[1-g_currentColour[square]]==false) {
-        score+=addWeightSingular(weights[stage][ABSOLUTE_FOREPOST+pieceTypeOffset],sideIndex);
+      if (square%2==0 && hasWhiteSquareBishop[1-pos.currentColour[square]]==false) {
+        score+=addFeature<Mode>(ABSOLUTE_FOREPOST+pieceTypeOffset,sideIndex);
       }
       else if (square%2==1
-               && hasBlackSquareBishop[1-g_currentColour[square]]==false) {
-        score+=addWeightSingular(weights[stage][ABSOLUTE_FOREPOST+pieceTypeOffset],sideIndex);
+               && hasBlackSquareBishop[1-pos.currentColour[square]]==false) {
+        score+=addFeature<Mode>(ABSOLUTE_FOREPOST+pieceTypeOffset,sideIndex);
       }
     }
     else {
-      if (square%2==0 && hasBlackSquareBishop[1-g_currentColour[square]]==false) {
-        score+=addWeightSingular(weights[stage][ABSOLUTE_FOREPOST+pieceTypeOffset],sideIndex);
+      if (square%2==0 && hasBlackSquareBishop[1-pos.currentColour[square]]==false) {
+        score+=addFeature<Mode>(ABSOLUTE_FOREPOST+pieceTypeOffset,sideIndex);
       }
       else if (square%2==1
-               && hasWhiteSquareBishop[1-g_currentColour[square]]==false) {
-        score+=addWeightSingular(weights[stage][ABSOLUTE_FOREPOST+pieceTypeOffset],sideIndex);
+               && hasWhiteSquareBishop[1-pos.currentColour[square]]==false) {
+        score+=addFeature<Mode>(ABSOLUTE_FOREPOST+pieceTypeOffset,sideIndex);
       }
     }
   }
@@ -1159,19 +1518,17 @@ double EvaluationParameters::forepostBonus(int square)
 
 // GLOBAL FUNCTION PROTOTYPES:
 
-int basicMaterialEval(void) noexcept
+int basicMaterialEval(const Position &pos) noexcept
 { // Returns basic material evaluation.
   // NOTE: In search, use the macros that use the running totals.
 
+  const GameState &state=*pos.currentState;
   int retVal=0;
 
-  // Go round all squares.
-  for (int i=0;i<BOARD_SQUARES;i++) {
-    if (g_currentColour[i]==g_currentSide)
-      retVal+=PIECE_VALUE[g_currentPiece[i]];
-    else if (g_currentColour[i]==getOtherSide(g_currentSide))
-      retVal-=PIECE_VALUE[g_currentPiece[i]];
-  }
+  // Each piece type, ours less theirs.
+  for (int piece=PAWN;piece<=QUEEN;piece++)
+    retVal+=PIECE_VALUE[piece]*(state.pieceCount[pos.currentSide][piece]
+                                -state.pieceCount[getOtherSide(pos.currentSide)][piece]);
 
   return retVal;
 
@@ -1179,24 +1536,12 @@ int basicMaterialEval(void) noexcept
 
 // -----------------------------------------------------------------------------
 
-bool materialExactlyEven(void) noexcept
+bool materialExactlyEven(const Position &pos) noexcept
 { // Returns true if both sides have exactly the same material.
   // eg: Same no. of Queens, Rooks, Bishops, Knights and pawns...
+  // NOTE: Each side's half of the material signature holds its counts.
 
-  // This holds how many of each piece each side has.
-  std::array<std::array<int, 6>, 2> numPieces = {};
-
-  // Go round all squares, counting how mnay of each piece, each side has.
-  for (int i=0;i<64;i++)
-    if (g_currentColour[i]!=NONE)
-      numPieces[g_currentColour[i]][g_currentPiece[i]]++;
-
-  // See if they have the same.
-  for (int i=0;i<6;i++)
-    if (numPieces[0][i]!=numPieces[1][i])
-      return false;                     // Not got the same amount of this...
-
-  // If we get here then the position is exactly materially even.
-  return true;
+  const MaterialKey key=pos.currentState->materialKey;
+  return (key&(materialKeyUnit(BLACK,PAWN)-1))==(key>>(4*6));
 
 } // End MaterialExactlyEven.
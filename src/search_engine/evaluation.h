@@ -6,7 +6,10 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <iomanip>
+#include <type_traits>
+#include <vector>
 #include "../chess_engine/types.h"
 #include "../chess_engine/chess_engine.h"
 #include "../chess_engine/globals.h"
@@ -110,6 +113,15 @@ constexpr int PAWN_MAJORITY = 37;
 // The number of 'singular' weight indexes (see above).
 constexpr int NUM_WEIGHTS = 38;
 
+// The pawn features are the last of these (see PawnHashEntry).
+constexpr int FIRST_PAWN_FEATURE = DOUBLED_PAWN;
+constexpr int NUM_PAWN_FEATURES = PAWN_MAJORITY-DOUBLED_PAWN+1;
+
+// The 'singular' weights/feature counts of each side are padded to this (a
+// multiple of 16), so the compiled eval can dot them 16 at a time.
+constexpr int FEATURE_STRIDE = 48;
+static_assert(FEATURE_STRIDE>=NUM_WEIGHTS && FEATURE_STRIDE%16==0);
+
 // =============================================================================
 
 // MODERN INLINE FUNCTIONS:
@@ -142,30 +154,115 @@ constexpr int NUM_WEIGHTS = 38;
 }
 
 // These are used to return distances to own and other king.
-[[nodiscard]] inline int getDistanceToOwnKingManhattan(int square) noexcept {
-  return getManhattanDistance(square, g_currentState->kingSquare[g_currentColour[square]]);
+[[nodiscard]] inline int getDistanceToOwnKingManhattan(const Position &pos,int square) noexcept {
+  return getManhattanDistance(square, pos.currentState->kingSquare[pos.currentColour[square]]);
 }
 
-[[nodiscard]] inline int getDistanceToOwnKingStraight(int square) noexcept {
-  return getStraightDistance(square, g_currentState->kingSquare[g_currentColour[square]]);
+[[nodiscard]] inline int getDistanceToOwnKingStraight(const Position &pos,int square) noexcept {
+  return getStraightDistance(square, pos.currentState->kingSquare[pos.currentColour[square]]);
 }
 
-[[nodiscard]] inline int getDistanceToOwnKingMin(int square) noexcept {
-  return getMinDistance(square, g_currentState->kingSquare[g_currentColour[square]]);
+[[nodiscard]] inline int getDistanceToOwnKingMin(const Position &pos,int square) noexcept {
+  return getMinDistance(square, pos.currentState->kingSquare[pos.currentColour[square]]);
 }
 
-[[nodiscard]] inline int getDistanceToOtherKingManhattan(int square) noexcept {
-  return getManhattanDistance(square, g_currentState->kingSquare[1 - g_currentColour[square]]);
+[[nodiscard]] inline int getDistanceToOtherKingManhattan(const Position &pos,int square) noexcept {
+  return getManhattanDistance(square, pos.currentState->kingSquare[1 - pos.currentColour[square]]);
 }
 
-[[nodiscard]] inline int getDistanceToOtherKingStraight(int square) noexcept {
-  return getStraightDistance(square, g_currentState->kingSquare[1 - g_currentColour[square]]);
+[[nodiscard]] inline int getDistanceToOtherKingStraight(const Position &pos,int square) noexcept {
+  return getStraightDistance(square, pos.currentState->kingSquare[1 - pos.currentColour[square]]);
 }
 
-[[nodiscard]] inline int getDistanceToOtherKingMin(int square) noexcept {
-  return getMinDistance(square, g_currentState->kingSquare[1 - g_currentColour[square]]);
+[[nodiscard]] inline int getDistanceToOtherKingMin(const Position &pos,int square) noexcept {
+  return getMinDistance(square, pos.currentState->kingSquare[1 - pos.currentColour[square]]);
 }
 
+// The piece-square part of the eval (including the empty squares), kept up to
+// date as moves are made (see updatePieceSquareSums()). It is only for one
+// stage, and from each side's point of view (ie: for either side to move).
+// NOTE: They are in score units, from the compiled weights (see CompiledWeights).
+struct PieceSquareSums {
+  int    stage = -1;                      // The stage they are for (-1 = none).
+  std::array<int32_t, 2> score{0, 0};     // [Side to move].
+}; // End PieceSquareSums.
+
+// What the pawns alone give the eval, which is cached in the pawn hash table
+// (see PawnHashTable) as it rarely changes from one eval to the next. This is
+// the pawn-file data and how many times each pawn feature is on (weighted as
+// per evalPawns()), so it doesn't depend on the stage or weights. The only
+// pawn feature that does depend on other pieces (a blocked passed pawn) is
+// worked out from passedPawns on each eval.
+// NOTE: The defaults are what a board without pawns gives (for key 0).
+struct PawnHashEntry {
+  HashKey key = 0;                                        // GameState::pawnKey.
+  std::array<std::array<int8_t, 10>, 2> pawnCount{};      // As per EvaluationParameters.
+  std::array<std::array<int8_t, 10>, 2> pawnRank{{{-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+                                                 {8,8,8,8,8,8,8,8,8,8}}};
+  std::array<std::array<int8_t, NUM_PAWN_FEATURES>, 2> features{}; // [Colour][Feature].
+  std::array<Bitboard, 2> passedPawns{0, 0};               // [Colour].
+}; // End PawnHashEntry.
+
+// The pawn hash table: Each search thread has its own (so no locking), and
+// an entry is just overwritten by the next pawn structure to use its slot.
+class PawnHashTable
+{
+  std::vector<PawnHashEntry> entries;
+  size_t mask = 0;
+  size_t sizeMB = 0;                             // As asked for by resize().
+
+  public:
+
+  int64_t probes = 0;                            // Since the last resetCounters().
+  int64_t hits = 0;
+
+  void resize(size_t sizeMB);                    // Size and clear the table.
+  void resetCounters(void) { probes=hits=0; }
+  [[nodiscard]] size_t getSizeMB(void) const { return sizeMB; }
+
+  // The entry for this pawn key, and if it already holds it.
+  PawnHashEntry& probe(HashKey key,bool &found) {
+    PawnHashEntry &entry=entries[key&mask];
+    probes++;
+    found=(entry.key==key);
+    if (found)
+      hits++;
+    return entry;
+  }
+
+}; // End PawnHashTable.
+
+// The weights as the search's eval uses them (see compileWeights()): Each one
+// rounded to (integer) score units, ie: times PIECE_VALUE[PAWN], so the eval
+// is integer adds, and the 'singular' weights laid out [Side][Feature] (the
+// same as the feature counts) to be dotted with the counts using SIMD.
+// NOTE: Each weight is out by at most half a score unit, so the eval is out
+//       by at most half a unit per term (a pawn is 10000 units).
+struct CompiledWeights {
+  bool valid = false;                                     // Up to date?
+  alignas(32) int16_t features[NUM_STAGES][2][FEATURE_STRIDE]; // [Stage][Side][Feature].
+  int32_t psValues[NUM_STAGES][13][64];
+  int32_t kingDistanceOwn[NUM_STAGES][12];
+  int32_t kingDistanceOther[NUM_STAGES][12];
+}; // End CompiledWeights.
+
+// What an eval is for, which picks the instantiation of evaluate() (so the
+// search's eval has none of the training code in it).
+enum class EvalMode {
+  PRECISE,   // Read-only, with the double weights (eg: training's output).
+  LEARN,     // As PRECISE, but nudges each weight used by the offset (train()).
+  COMPILED   // Read-only, with the compiled weights and running sums (the search).
+};
+
+// The score evaluate() gives: Compiled ones are in (integer) score units.
+template <EvalMode Mode>
+using EvalScore = std::conditional_t<Mode==EvalMode::COMPILED, int32_t, double>;
+
+// The optional eval features (see EvaluationConfig) evaluate() is built for.
+constexpr unsigned EVAL_KING_DISTANCE = 1;
+constexpr unsigned EVAL_EMPTY_SQUARES = 2;
+constexpr unsigned EVAL_SUPER_FAST = 4;
+
 // #############################################################################
 // #                   'EvaluationParameters' CLASS DEFINITION                 #
 // #############################################################################
@@ -181,8 +278,8 @@ class EvaluationParameters
 
   // Note: these two arrays have extra files to simplify checking A/H pawns.
   // Note: If a file has no pawns... pawnRank is as though off edge off board.
-  std::array<std::array<int, 10>, 2> pawnCount;              // Number of [Colour][File] pawns.
-  std::array<std::array<int, 10>, 2> pawnRank;               // Least advanced pawn for [Colour][File].
+  std::array<std::array<int8_t, 10>, 2> pawnCount;           // Number of [Colour][File] pawns.
+  std::array<std::array<int8_t, 10>, 2> pawnRank;            // Least advanced pawn for [Colour][File].
 
   // Used to find what minor peices (Knight, w-sq/bsq B-sg) a player has.
   std::array<bool, 2> hasKnights;
@@ -199,11 +296,17 @@ class EvaluationParameters
   // These are the 'singular' weights (x NUM_STAGES, x2=for asymetry).
   double weights[NUM_STAGES][NUM_WEIGHTS][2];
 
+  // The above compiled for the search (see CompiledWeights), and how many times
+  // each 'singular' feature is on ([0]=us, [1]=Opponent) while using them.
+  CompiledWeights compiled;
+  alignas(32) int16_t featureCounts[2][FEATURE_STRIDE];
+
   // Runtime configuration flags (static - shared across all instances)
   static bool useLinearTraining;
   static bool useKingDistanceFeatures;
   static bool useEmptySquareFeatures;
   static bool useSuperFastEval;
+  static unsigned evalFeatures;                  // The above as EVAL_* bits.
 
   public:
 
@@ -217,43 +320,78 @@ class EvaluationParameters
   [[nodiscard]] bool save(const char* fileName); // Save the values.
   void normalize(void);                          // Normalize the values.
   void scale(double scaleFactor);                // Scale the values.
-  double train(double desiredOutput,double learningRate,double &output);
-  double evalPrecise(void);                      // Get float eval.
-  int eval(void);                                // Get (scaled) INT eval.
+  double train(const Position &pos,double desiredOutput,double learningRate,
+               double &output);
+  [[nodiscard]] HashKey getWeightsKey(void) const;             // Key of all the weights.
+  double evalPrecise(const Position &pos);                     // Get float eval.
+  int eval(const Position &pos);                               // Get (scaled) INT eval.
+  int eval(const Position &pos,const PieceSquareSums &sums,    // Using the running sums
+           PawnHashTable &pawnTable);                          // and the pawn hash.
+
+  // The running piece-square sums (see PieceSquareSums).
+  void initPieceSquareSums(const Position &pos,PieceSquareSums &sums);
+  void updatePieceSquareSums(const Position &pos,const PieceSquareSums &before,
+                             PieceSquareSums &after,const MoveStruct &moveMade);
 
   private:
 
   // PRIVATE (CLASS) MEMEBER FUNCTION PROTOTYPES:
-  [[nodiscard]] int getStage(void) noexcept;                            // Get stage of game we are on.
+  [[nodiscard]] int getStage(const Position &pos) noexcept;    // Get stage of game we are on.
   [[nodiscard]] double activation(double value) noexcept; // Get bipolar-sigmoid act.
   [[nodiscard]] double gradient(double value) noexcept;   // Get bipolar-sigmoid grad.
-  double evalAndLearn(double OffsetValue);       // Eval and/or update weights.
-  double evalPawn(int Square);                   // Eval the pawn at square.
-  double evalKnight(int Square);                 // Eval the knight at square.
-  double evalBishop(int Square);                 // Eval the bishiop at square.
-  double evalRook(int Square);                   // Eval the rook at square.
-  double evalQueen(int Square);                  // Eval the queen at square.
-  double evalKing(int Square);                   // Eval the king at square.
-  double forepostBonus(int Square);              // Add forepost bonuse(s)...
-
-  // Inline helper functions for weight access during training
-  // NOTE: When offset is 0 (normal evaluation), these just return the weight value
-  // without modification. Only during training (offset != 0) do they update weights.
-  inline double addWeight(double& weight) { 
-    if (offset != 0.0) weight += offset;
-    return weight; 
+  [[nodiscard]] static unsigned getEvalFeatures(void) noexcept; // The flags as EVAL_* bits.
+  template <EvalMode Mode>                                     // Call evaluate() for
+  EvalScore<Mode> evaluateWith(const Position &pos,            // evalFeatures.
+                               const PieceSquareSums *sums=nullptr,
+                               PawnHashTable *pawnTable=nullptr);
+  template <EvalMode Mode,unsigned Features>                   // Eval (and/or update
+  EvalScore<Mode> evaluate(const Position &pos,                // weights).
+                           const PieceSquareSums *sums,PawnHashTable *pawnTable);
+  void togglePieceSquare(PieceSquareSums &sums,int colour,int piece,int square,int sign);
+  void setupPawnEntry(const Position &pos,PawnHashEntry &entry); // Work out the pawns' entry.
+  void countPawnFeatures(const Position &pos,int Square,       // Add the pawn at square's
+                         PawnHashEntry &entry);                // features to the entry.
+  template <EvalMode Mode>
+  double evalPawns(const Position &pos,const PawnHashEntry &entry); // Eval all the pawns.
+  template <EvalMode Mode>
+  double evalKnight(const Position &pos,int Square);           // Eval the knight at square.
+  template <EvalMode Mode>
+  double evalBishop(const Position &pos,int Square);           // Eval the bishiop at square.
+  template <EvalMode Mode>
+  double evalRook(const Position &pos,int Square);             // Eval the rook at square.
+  template <EvalMode Mode>
+  double evalQueen(const Position &pos,int Square);            // Eval the queen at square.
+  template <EvalMode Mode>
+  double evalKing(const Position &pos,int Square);             // Eval the king at square.
+  template <EvalMode Mode>
+  double forepostBonus(const Position &pos,int Square);        // Add forepost bonuse(s)...
+
+  void compileWeights(void);                                   // Set up compiled.
+  void setupPawnsAndMinors(const Position &pos,PawnHashTable *pawnTable, // 1st pass.
+                           PawnHashEntry &localEntry,const PawnHashEntry *&pawnEntry);
+
+  // Inline helper functions for weight access: They just return the weight,
+  // except when learning (EvalMode::LEARN), when they first add the offset.
+  template <EvalMode Mode>
+  inline double addWeight(double& weight) {
+    if constexpr (Mode == EvalMode::LEARN) weight += offset;
+    return weight;
   }
+  template <EvalMode Mode>
   inline double addWeightScaled(double& weight, double scaleFactor) {
-    if (offset != 0.0) weight += offset * scaleFactor;
+    if constexpr (Mode == EvalMode::LEARN) weight += offset * scaleFactor;
     return weight * scaleFactor;
   }
-  inline double addWeightSingular(double* weight, int idx) { 
-    if (offset != 0.0) weight[idx] += offset;
-    return weight[idx]; 
-  }
-  inline double addWeightSingularScaled(double* weight, int idx, double scaleFactor) {
-    if (offset != 0.0) weight[idx] += offset * scaleFactor;
-    return weight[idx] * scaleFactor;
+  // The 'singular' features: With the compiled weights they are just counted
+  // (and dotted with the weights at the end), else as above.
+  template <EvalMode Mode>
+  inline double addFeature(int feature, int sideIndex, int times=1) {
+    if constexpr (Mode == EvalMode::COMPILED) {
+      featureCounts[sideIndex][feature] += static_cast<int16_t>(times);
+      return 0.0;
+    }
+    else
+      return addWeightScaled<Mode>(weights[stage][feature][sideIndex], times);
   }
   inline int flipIfNeeded(bool flipFlag, int square) {
     return flipFlag ? flipSquare(square) : square;
@@ -267,6 +405,6 @@ class EvaluationParameters
 
 // GLOBAL FUNCTION PROTOTYPES:
 
-[[nodiscard]] int basicMaterialEval(void) noexcept;    // This just returns a materialistic evaluation.
-[[nodiscard]] bool materialExactlyEven(void) noexcept; // Returns true if both have same pieces...
+[[nodiscard]] int basicMaterialEval(const Position &pos) noexcept;    // This just returns a materialistic evaluation.
+[[nodiscard]] bool materialExactlyEven(const Position &pos) noexcept; // Returns true if both have same pieces...
 
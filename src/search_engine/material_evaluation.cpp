@@ -6,7 +6,7 @@
 
 // ==========================================================================
 
-void updateMaterialEvaluation(RunningMaterial &runningMaterial, int currentPly,
+void updateMaterialEvaluation(const Position &pos,RunningMaterial &runningMaterial, int currentPly,
                               const MoveStruct &moveMade)
 { // This function update the running material evaluation, with the move made.
 
@@ -21,20 +21,20 @@ void updateMaterialEvaluation(RunningMaterial &runningMaterial, int currentPly,
 
     // En passent removes one pawm.
     if (moveMade.type&EN_PASSANT)
-      runningMaterial.pawnMatValue[currentPly+1][g_currentSide]-=PIECE_VALUE[PAWN];
+      runningMaterial.pawnMatValue[currentPly+1][pos.currentSide]-=PIECE_VALUE[PAWN];
 
     // Normal moves remove the piece taken.
     else {
-      runningMaterial.pieceMatValue[currentPly+1][g_currentSide]
-                   -=PIECE_VALUE[g_gameHistory[g_moveNum-1].piece[moveMade.target]];
+      runningMaterial.pieceMatValue[currentPly+1][pos.currentSide]
+                   -=PIECE_VALUE[pos.undoHistory[pos.moveNum-1].captured];
     }
 
   }
 
   // Promotions increase material (and lose a pawn!).
   if (moveMade.type&PROMOTION) {
-    runningMaterial.pieceMatValue[currentPly+1][getOtherSide(g_currentSide)]+=PIECE_VALUE[moveMade.promote];
-    runningMaterial.pawnMatValue[currentPly+1][getOtherSide(g_currentSide)]-=PIECE_VALUE[PAWN];// P gone.
+    runningMaterial.pieceMatValue[currentPly+1][getOtherSide(pos.currentSide)]+=PIECE_VALUE[moveMade.promote];
+    runningMaterial.pawnMatValue[currentPly+1][getOtherSide(pos.currentSide)]-=PIECE_VALUE[PAWN];// P gone.
   }
 
 } // End updateMaterialEvaluation.
@@ -3,106 +3,357 @@
 // **************************************************************************
 
 #include "search_engine.h"
+#include "../chess_engine/bitboards.h"
 
 // ==========================================================================
 
-void scoreMoves(SearchData &searchData,int currentPly,MoveList &moves,
-                int moveScores[MOVELIST_ARRAY_SIZE],bool nullMove)
-{ // This gives a score to each move in the move list.
+static inline bool sameMove(const MoveStruct &a,const MoveStruct &b)
+{ // Returns true if both are the same move (the type follows from these).
 
-  // Rank catures and promotions the highest, then try a killer move if one
-  // exists, else use move history value for a normal move.
-  // 1. Hash move.
-  // 2. Capture of last moved piece.
-  // 3. Other captures (MVV-LVA).
-  // 4. Killer moves (old/new/1st/2nd).
-  // 5. King moves get as score of -1, if not a castle move.
-  // 6. Move History.
+  return a.source==b.source && a.target==b.target && a.promote==b.promote;
 
-  // 2003_v5: Save a local copy to try to speed the code up here.
-  static int8_t source,target;
-  static uint8_t type;
+} // End sameMove.
 
-  // For each move.
-  for (int i=0;i<moves.numMoves;i++) {
+// ==========================================================================
 
-    // 1. Hash table move.
-    if (moves.moves[i].source == searchData.hashMoves[currentPly].source
-        && moves.moves[i].target == searchData.hashMoves[currentPly].target
-        && moves.moves[i].type == searchData.hashMoves[currentPly].type
-        && moves.moves[i].promote == searchData.hashMoves[currentPly].promote) {
-      moveScores[i]=PV_SORT_SCORE;
-      continue;
+int staticExchange(const Position &pos,const MoveStruct &move)
+{ // Static Exchange Evaluation: the material won (in PIECE_VALUE units) by
+  // making the capture and then letting both sides recapture on the target
+  // square, cheapest piece first, each side stopping when it stops paying.
+  // X-rays are found by taking each capturer out of the occupancy and looking
+  // the sliders up again. Pins and checks are ignored (the king only takes
+  // last, when nothing is left to recapture it).
+
+  const GameState &state=*pos.currentState;
+  const int target=move.target;
+  int gain[32];                       // gain[d] = Score for the d'th capturer.
+  int depth=0;
+  int side=pos.currentSide;
+  int onTarget;                       // Piece that would be taken next.
+  Bitboard occupied=state.colourBB[WHITE]|state.colourBB[BLACK];
+
+  // The first capture (always made, even if it loses).
+  if (move.type&EN_PASSANT) {
+    gain[0]=PIECE_VALUE[PAWN];
+    occupied^=squareBB(side==WHITE ? target+8 : target-8);
+  }
+  else
+    gain[0]=(move.type&CAPTURE) ? PIECE_VALUE[pos.currentPiece[target]] : 0;
+  onTarget=pos.currentPiece[move.source];
+  if (move.type&PROMOTION) {
+    gain[0]+=PIECE_VALUE[move.promote]-PIECE_VALUE[PAWN];
+    onTarget=move.promote;
+  }
+  occupied^=squareBB(move.source);
+
+  Bitboard attackers=attackersTo(state,target,occupied)&occupied;
+  const Bitboard diagonalSliders=state.pieceBB[BISHOP]|state.pieceBB[QUEEN];
+  const Bitboard straightSliders=state.pieceBB[ROOK]|state.pieceBB[QUEEN];
+  const bool promotionRank=(squareBB(target)&(RANK_8_BB|RANK_1_BB))!=0;
+
+  for (;;) {
+    side=getOtherSide(side);
+    const Bitboard ours=attackers&state.colourBB[side];
+    if (!ours)
+      break;
+
+    // Find our cheapest attacker.
+    int piece=PAWN;
+    while (!(ours&state.pieceBB[piece]))
+      piece++;
+
+    // The king can't take a defended piece.
+    if (piece==KING && (attackers&state.colourBB[getOtherSide(side)]))
+      break;
+
+    // Score if we take (assuming we get taken back).
+    depth++;
+    gain[depth]=PIECE_VALUE[onTarget]-gain[depth-1];
+    onTarget=piece;
+    if (piece==PAWN && promotionRank) {
+      gain[depth]+=PIECE_VALUE[QUEEN]-PIECE_VALUE[PAWN];
+      onTarget=QUEEN;
     }
 
+    if (depth==31)
+      break;
+
+    // Take the capturer off and add any sliders it was hiding.
+    occupied^=squareBB(getFirstSquare(ours&state.pieceBB[piece]));
+    if (piece==PAWN || piece==BISHOP || piece==QUEEN)
+      attackers|=bishopAttacks(target,occupied)&diagonalSliders;
+    if (piece==ROOK || piece==QUEEN)
+      attackers|=rookAttacks(target,occupied)&straightSliders;
+    attackers&=occupied;
+  }
+
+  // Work back down: each side may choose not to make its capture.
+  while (depth>0) {
+    gain[depth-1]=-std::max(-gain[depth-1],gain[depth]);
+    depth--;
+  }
+
+  return gain[0];
+
+} // End staticExchange.
+
+// ==========================================================================
+
+static void selectBest(MoveList &moves,int moveScores[MOVELIST_ARRAY_SIZE],
+                       int first,int last)
+{ // Like sortMoves(), but only looks at the moves from first to last-1.
+
+  int bestIndex=first;
+  for (int i=first+1;i<last;i++) {
+    if (moveScores[i]>moveScores[bestIndex])
+      bestIndex=i;
+  }
+  std::swap(moves.moves[first],moves.moves[bestIndex]);
+  std::swap(moveScores[first],moveScores[bestIndex]);
+
+} // End selectBest.
+
+// ==========================================================================
+
+static void scoreCaptures(const SearchData &searchData,MoveList &moves,
+                          int moveScores[MOVELIST_ARRAY_SIZE],bool nullMove)
+{ // This gives a score to each capture/promotion in the move list.
+  // 1. Promotions (capturing ones higher).
+  // 2. Captures: Capture of last moved piece, then others (MVV-LVA).
+  // 3. Losing captures (SEE<0) get the (negative) SEE score, so they come
+  //    after all the quiet moves.
+
+  const Position &pos=searchData.pos;
+
+  for (int i=0;i<moves.numMoves;i++) {
+
     // 2003_v5: Save a local copy to try to speed the code up here.
-    source=moves.moves[i].source;
-    target=moves.moves[i].target;
-    type=moves.moves[i].type;
+    const int8_t source=moves.moves[i].source;
+    const int8_t target=moves.moves[i].target;
+    const uint8_t type=moves.moves[i].type;
 
-    // 2. If it's a promotion, rank it high!
+    // If it's a promotion, rank it high!
     if (type&PROMOTION) {
       moveScores[i]=PROMOTION_SORT_SCORE+(moves.moves[i].promote*10);
 
       // Add an even higher score if we capture on the promotion!
       if (type&CAPTURE)
-        moveScores[i]+=g_currentPiece[target]*10;
+        moveScores[i]+=pos.currentPiece[target]*10;
     }
 
-    // 3. Is it a capture, capture the last piece moved first.
-    else if (type&CAPTURE) {
-      moveScores[i]=CAPTURE_SORT_SCORE+((g_currentPiece[target]*10)
-                                        -g_currentPiece[source]);
-
-      // If we are capturing the last piece moved by opponent, make it higher.
-      if (g_moveNum>1 && nullMove==false
-          && (g_gameHistory[g_moveNum-1].piece[target]
-              !=g_gameHistory[g_moveNum-2].piece[target]
-              || g_gameHistory[g_moveNum-1].colour[target]
-                 !=g_gameHistory[g_moveNum-2].colour[target])) {
+    // Is it a capture, capture the last piece moved first.
+    else {
+
+      // Taking a piece worth less than our own may lose material, so see
+      // what the exchange comes to (a losing capture goes after the quiets).
+      if (!(type&EN_PASSANT)
+          && PIECE_VALUE[pos.currentPiece[target]]<PIECE_VALUE[pos.currentPiece[source]]) {
+        const int exchange=staticExchange(pos,moves.moves[i]);
+        if (exchange<0) {
+          moveScores[i]=exchange;
+          continue;
+        }
+      }
+
+      moveScores[i]=CAPTURE_SORT_SCORE+((pos.currentPiece[target]*10)
+                                        -pos.currentPiece[source]);
+
+      // If we are capturing where the exchange is going on, make it higher.
+      if (pos.moveNum>1 && nullMove==false && ourLastMoveChanged(pos,target)) {
         moveScores[i]++;
       }
     }
 
-    // 4. Killer moves.
-    else if (source==searchData.killerMovesOld[currentPly].source
-             && target==searchData.killerMovesOld[currentPly].target) {
-      moveScores[i]=KILLER_SORT_SCORE+(searchData.moveHistory[source][target]<<3);
-    }
-    else if (source==searchData.killerMovesNew[currentPly].source
-             && target==searchData.killerMovesNew[currentPly].target) {
-      moveScores[i]=KILLER_SORT_SCORE+(searchData.moveHistory[source][target]<<3);
-    }
-    else if (currentPly>1
-             && source==searchData.killerMovesOld[currentPly-2].source
-             && target==searchData.killerMovesOld[currentPly-2].target) {
-      moveScores[i]=(KILLER_SORT_SCORE/2)+(searchData.moveHistory[source][target]<<3);
-    }
-    else if (currentPly>1
-             && source==searchData.killerMovesNew[currentPly-2].source
-             && target==searchData.killerMovesNew[currentPly-2].target) {
-      moveScores[i]=(KILLER_SORT_SCORE/2)+(searchData.moveHistory[source][target]<<3);
-    }
+  } // End for each move.
 
-    // 5. Castling is generally good.
-    else if (type&CASTLE) {
-      moveScores[i]=(searchData.moveHistory[source][target]<<3)|7;
-    }
+} // End scoreCaptures.
 
-    // 5. King moves score lower, as are more expensive to test if legal.
-    else if (g_currentPiece[source]==KING) {
-      moveScores[i]=(searchData.moveHistory[source][target]<<3);
-    }
+// ==========================================================================
 
-    // 6. Move history score + add to it the piece moveing (not KINGS!).
-    else {
+static void scoreQuiets(const SearchData &searchData,MoveList &moves,
+                        int moveScores[MOVELIST_ARRAY_SIZE],int first)
+{ // This gives a score to each quiet move in the move list (from first on).
+  // 1. Castling is generally good.
+  // 2. King moves get a lower score, as they are more expensive to make.
+  // 3. Move history + the piece moving.
+
+  const Position &pos=searchData.pos;
+
+  for (int i=first;i<moves.numMoves;i++) {
+
+    const int8_t source=moves.moves[i].source;
+    const int8_t target=moves.moves[i].target;
+
+    if (moves.moves[i].type&CASTLE)
+      moveScores[i]=(searchData.moveHistory[source][target]<<3)|7;
+    else if (pos.currentPiece[source]==KING)
+      moveScores[i]=(searchData.moveHistory[source][target]<<3);
+    else
       moveScores[i]=(searchData.moveHistory[source][target]<<3)
-                    +(g_currentPiece[source]+1);
-    }
+                    +(pos.currentPiece[source]+1);
 
   } // End for each move.
 
-} // End scoreMoves.
+} // End scoreQuiets.
+
+// ==========================================================================
+
+void MovePicker::init(SearchData &sd,int ply,bool isNullMove,bool onlyCaptures)
+{ // Start handing out the moves for a new node.
+
+  const Position &pos=sd.pos;
+  const MoveStruct noMove{NONE, NONE, NORMAL_MOVE, NO_PROMOTION};
+
+  searchData=&sd;
+  currentPly=ply;
+  nullMove=isNullMove;
+  capturesOnly=onlyCaptures;
+  stage=PickStage::HASH_MOVE;
+  index=0;
+  moves.numMoves=0;
+  numKillers=0;
+
+  // The hash move comes from the table, so may not even be pseudo-legal here
+  // (or may be quiet when we only want captures).
+  hashMove=sd.hashMoves[ply];
+  if (hashMove.source==NONE
+      || (capturesOnly && !(hashMove.type&(CAPTURE|PROMOTION)))
+      || !isPseudoLegal(pos,hashMove))
+    hashMove=noMove;
+
+  if (capturesOnly)
+    return;
+
+  // The killers were found in other positions, so test them the same way.
+  // NOTE: Captures and promotions are never killers (see search()), but a
+  //       killer may be a capture here, which the captures stage covers.
+  const MoveStruct candidates[4]={
+    sd.killerMovesOld[ply],sd.killerMovesNew[ply],
+    ply>1 ? sd.killerMovesOld[ply-2] : noMove,
+    ply>1 ? sd.killerMovesNew[ply-2] : noMove
+  };
+  for (const MoveStruct &killer : candidates) {
+    if (killer.source==NONE || (killer.type&(CAPTURE|PROMOTION))
+        || sameMove(killer,hashMove) || !isPseudoLegal(pos,killer))
+      continue;
+    bool seen=false;
+    for (int k=0;k<numKillers;k++)
+      seen|=sameMove(killers[k],killer);
+    if (!seen)
+      killers[numKillers++]=killer;
+  }
+
+} // End MovePicker::init.
+
+// ==========================================================================
+
+bool MovePicker::next(MoveStruct &move,int &score)
+{ // Hand out the next move to try, generating more when we run out.
+
+  SearchData &sd=*searchData;
+
+  for (;;) {
+    switch (stage) {
+
+      // 1. The hash move (no generation needed).
+      case PickStage::HASH_MOVE:
+        stage=PickStage::GEN_CAPTURES;
+        if (hashMove.source!=NONE) {
+          move=hashMove;
+          score=PV_SORT_SCORE;
+          return true;
+        }
+        break;
+
+      // 2. Captures and promotions.
+      case PickStage::GEN_CAPTURES:
+        genCaptures(sd.pos,moves);
+        sd.stats.moveGens++;
+        scoreCaptures(sd,moves,moveScores,nullMove);
+        index=0;
+        stage=PickStage::GOOD_CAPTURES;
+        break;
+
+      case PickStage::GOOD_CAPTURES:
+        while (index<moves.numMoves) {
+          selectBest(moves,moveScores,index,moves.numMoves);
+          if (moveScores[index]<0)
+            break;                       // Only losing captures left.
+          const int i=index++;
+          if (sameMove(moves.moves[i],hashMove))
+            continue;
+          move=moves.moves[i];
+          score=moveScores[i];
+          return true;
+        }
+
+        // The quiescent search doesn't try the losing captures at all.
+        numCaptures=moves.numMoves;
+        badIndex=index;
+        stage=capturesOnly ? PickStage::DONE : PickStage::KILLERS;
+        index=0;
+        break;
+
+      // 3. Killer moves (already tested as pseudo-legal by init()).
+      case PickStage::KILLERS:
+        if (index<numKillers) {
+          move=killers[index];
+          score=(index<2 ? KILLER_SORT_SCORE : KILLER_SORT_SCORE/2)
+                +(sd.moveHistory[move.source][move.target]<<3);
+          index++;
+          return true;
+        }
+        stage=PickStage::GEN_QUIETS;
+        break;
+
+      // 4. Quiet moves, added after the captures.
+      case PickStage::GEN_QUIETS:
+        index=numCaptures;
+        genQuiets(sd.pos,moves);
+        sd.stats.moveGens++;
+        scoreQuiets(sd,moves,moveScores,index);
+        stage=PickStage::QUIETS;
+        break;
+
+      case PickStage::QUIETS:
+        while (index<moves.numMoves) {
+          sortMoves(moves,moveScores,index);
+          const int i=index++;
+          if (sameMove(moves.moves[i],hashMove))
+            continue;
+          bool isKiller=false;
+          for (int k=0;k<numKillers;k++)
+            isKiller|=sameMove(moves.moves[i],killers[k]);
+          if (isKiller)
+            continue;
+          move=moves.moves[i];
+          score=moveScores[i];
+          return true;
+        }
+        stage=PickStage::BAD_CAPTURES;
+        break;
+
+      // 5. Losing captures (left where the captures stage stopped).
+      case PickStage::BAD_CAPTURES:
+        while (badIndex<numCaptures) {
+          selectBest(moves,moveScores,badIndex,numCaptures);
+          const int i=badIndex++;
+          if (sameMove(moves.moves[i],hashMove))
+            continue;
+          move=moves.moves[i];
+          score=moveScores[i];
+          return true;
+        }
+        stage=PickStage::DONE;
+        break;
+
+      case PickStage::DONE:
+        return false;
+
+    }
+  }
+
+} // End MovePicker::next.
 
 // ==========================================================================
 
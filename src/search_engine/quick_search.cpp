@@ -22,7 +22,7 @@ int g_qsNumNodesSearched;
 
 // =========================================================================
 
-int isQuiescent(void)
+int isQuiescent(Position &pos)
 { // This function simply finds if the current position is quiescent.
   // It does this by compareing the reults of GetQuiescentScore, with the
   // current material eval, if they are the same, then the position IS
@@ -44,14 +44,14 @@ int isQuiescent(void)
   for (int i=0;i<64;i++) {
 
     // Don't bother if theres no piece on the square.
-    if (g_currentPiece[i]==NONE)
+    if (pos.currentPiece[i]==NONE)
       continue;
 
     // See if it's a pawn or a piece.
-    if (g_currentPiece[i]==PAWN)
-      sd.pawnMatValue[0][g_currentColour[i]]+=PIECE_VALUE[PAWN];
+    if (pos.currentPiece[i]==PAWN)
+      sd.pawnMatValue[0][pos.currentColour[i]]+=PIECE_VALUE[PAWN];
     else
-      sd.pieceMatValue[0][g_currentColour[i]]+=PIECE_VALUE[g_currentPiece[i]];
+      sd.pieceMatValue[0][pos.currentColour[i]]+=PIECE_VALUE[pos.currentPiece[i]];
 
   }
 
@@ -59,14 +59,14 @@ int isQuiescent(void)
   g_qsNumNodesSearched=0;
 
   // See if quiescent or not.
-  quiescentScore=getQuiescentScore(sd);
+  quiescentScore=getQuiescentScore(pos,sd);
 
   // 2003: Has the search 'timed-out'?
   if (g_qsNumNodesSearched>MAscore_NODES_TO_TRY)
     return -1;                                    // Failed.
 
   // Return true or false.
-  if (quiescentScore==getMaterialEval(sd, g_currentSide, getOtherSide(g_currentSide), currentPly))
+  if (quiescentScore==getMaterialEval(sd, pos.currentSide, getOtherSide(pos.currentSide), currentPly))
     return true;
   else
     return false;
@@ -75,18 +75,18 @@ int isQuiescent(void)
 
 // ==========================================================================
 
-int getQuiescentScore(RunningMaterial &sd)
+int getQuiescentScore(Position &pos,RunningMaterial &sd)
 { // This function returns the quiescent *MATERIAL* score for a position.
   // It calls QuickQuiesceSearch() to do the work.
 
   // Return the value.
-  return quickQuiesceSearch(sd,0,-WIN_SCORE,WIN_SCORE);
+  return quickQuiesceSearch(pos,sd,0,-WIN_SCORE,WIN_SCORE);
 
 } // End getQuiescentScore.
 
 // ============================================================================
 
-int quickQuiesceSearch(RunningMaterial &sd,int currentPly,int alpha,int beta)
+int quickQuiesceSearch(Position &pos,RunningMaterial &sd,int currentPly,int alpha,int beta)
 { // This function simply finds the quiescent *MATERIAL* score for a position.
   // The function calls itself recusively, but uses the minimum code (unlike
   // QuiesceSearch, which has lots of book keeping code).
@@ -113,15 +113,15 @@ int quickQuiesceSearch(RunningMaterial &sd,int currentPly,int alpha,int beta)
     return 0;                    // Search invalid now , leaving recusion.
 
   // Test here so we can cut off the search as pointless to search further.
-  if (g_currentState->isDraw)
+  if (pos.currentState->isDraw)
     return getDrawScore();          // Draw situtaion.
 
   // MATERIAL ONLY!
-  best=getMaterialEval(sd, g_currentSide, getOtherSide(g_currentSide), currentPly);       // Get material eval.
+  best=getMaterialEval(sd, pos.currentSide, getOtherSide(pos.currentSide), currentPly);       // Get material eval.
 
-  // Generate all moves if in check, else just gen captures (if no cut!).
-  if (g_currentState->inCheck) {
-    genMoves(moves);
+  // Generate all (legal) moves if in check, else just gen captures (if no cut!).
+  if (pos.currentState->inCheck) {
+    genLegalMoves(pos,moves);
   }
   else {
 
@@ -130,7 +130,7 @@ int quickQuiesceSearch(RunningMaterial &sd,int currentPly,int alpha,int beta)
       return best;
 
     // Generate only captures and promotions.
-    genCaptures(moves);
+    genCaptures(pos,moves);
 
   }
 
@@ -141,18 +141,14 @@ int quickQuiesceSearch(RunningMaterial &sd,int currentPly,int alpha,int beta)
 
       // Add an even higher score if we capture on the promotion!
       if (moves.moves[i].type&CAPTURE)
-        moveScores[i]+=g_currentPiece[moves.moves[i].target]*10;
+        moveScores[i]+=pos.currentPiece[moves.moves[i].target]*10;
     }
     else if (moves.moves[i].type&CAPTURE) {
-      moveScores[i]=CAPTURE_SORT_SCORE+((g_currentPiece[moves.moves[i].target]*10)
-                                        -g_currentPiece[moves.moves[i].source]);
-
-      // If we are capturing the last piece moved by opponent, make it higher.
-      if (g_moveNum>1
-          && (g_gameHistory[g_moveNum-1].piece[moves.moves[i].target]
-              !=g_gameHistory[g_moveNum-2].piece[moves.moves[i].target]
-              || g_gameHistory[g_moveNum-1].colour[moves.moves[i].target]
-                 !=g_gameHistory[g_moveNum-2].colour[moves.moves[i].target])) {
+      moveScores[i]=CAPTURE_SORT_SCORE+((pos.currentPiece[moves.moves[i].target]*10)
+                                        -pos.currentPiece[moves.moves[i].source]);
+
+      // If we are capturing where the exchange is going on, make it higher.
+      if (pos.moveNum>1 && ourLastMoveChanged(pos,moves.moves[i].target)) {
         moveScores[i]++;
       }
     }
@@ -170,17 +166,17 @@ int quickQuiesceSearch(RunningMaterial &sd,int currentPly,int alpha,int beta)
     // Sort the moves.
     sortMoves(moves,moveScores,i);
 
-    if (!makeMove(moves.moves[i]))
+    if (!makeMoveInPlace(pos,moves.moves[i]))
       continue;
     found=true;                    // We have found a legal move.
 
     // Update the material evaluation.
-    updateMaterialEvaluation(sd,currentPly,moves.moves[i]);
+    updateMaterialEvaluation(pos,sd,currentPly,moves.moves[i]);
 
     // Search the next ply.
-    score=-quickQuiesceSearch(sd,currentPly+1,-beta,-alpha); // Call self.
+    score=-quickQuiesceSearch(pos,sd,currentPly+1,-beta,-alpha); // Call self.
 
-    takeMoveBack();                // Take the move back.
+    unmakeMove(pos);                  // Take the move back.
 
     // Check to see if timed out (To avoid 'silly' exibition games...).
     if (g_qsNumNodesSearched>MAscore_NODES_TO_TRY)
@@ -215,7 +211,7 @@ int quickQuiesceSearch(RunningMaterial &sd,int currentPly,int alpha,int beta)
   // If we're in check and there aren't any legal moves, well, we lost.
   // NOTE: This is not definitely forced and should be extended in Search() to
   //       make sure it realy is a forced mate.
-  if ((!found) && g_currentState->inCheck)
+  if ((!found) && pos.currentState->inCheck)
     best=(-WIN_SCORE)+currentPly; // <*** N moves to go can be worked out!
 
   // Return the best found.
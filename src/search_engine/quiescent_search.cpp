@@ -19,6 +19,8 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
   // (and set alpha). The idea is to find a position where there isn't a 
   // lot going on so the static evaluation function will work.
 
+  Position &pos=searchData.pos;  // The position we are searching.
+
   int score;                     // Returned from Eval() and recursicve call.
   bool found=false;              // true if at least 1 legal move found.
 
@@ -31,25 +33,22 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
   int best;                      // Best score so far.
   int saveAlpha=alpha;           // Value of alpha on entry.
 
-  // The hash key of the move we just made.
-  HashKey nextHashKey;
-
-  // This is the best Next hash key we got.
-  HashKey bestHashKey=0;
 
   // Used to speed up.
   int mEval,pEval;
 
-  // This is the list of moves/Captures generated from this state.
-  MoveList moves;
-  int      moveScores[MOVELIST_ARRAY_SIZE];
+  // Hands out the moves/captures from this state.
+  MovePicker picker;
+  MoveStruct move;               // The move being tried.
+  int        moveScore;          // Its sort score (unused here).
 
   // Check to see if timed out (Time is huge if no time limit!).
   if (shouldTimeOut(searchData)==true)
     return 0;                    // Search invalid now , leaving recusion.
 
   // One more node searched.
-  searchData.totalNodesSearched++;
+  searchData.stats.nodes++;
+  searchData.stats.qsearchNodes++;
 
   // Always push up these values if needed (in case we only have 1 move!).
   if (searchData.minPositionEval[currentPly]<searchData.minPositionEval[currentPly+1])
@@ -61,7 +60,7 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
   bestMove = MoveStruct{NONE, NONE, NORMAL_MOVE, NO_PROMOTION};
 
   // Test here so we can cut off the search as pointless to search further.
-  if (g_currentState->isDraw) {
+  if (pos.currentState->isDraw) {
     best=getDrawScore();               // Draw situtaion.
     goto LeaveQSearch;               // To save in TTable ect.
   }
@@ -72,10 +71,13 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
   // if we now get a cut-off due to the new alpha/beta, return the score.
 
   // See if the states in the hash already.
-  flags=ttGet(searchData,currentPly,0,score,searchData.hashMoves[currentPly],nextHashKey);
-  searchData.totalGetHashCount++;
-  if (flags!=0)
-    searchData.numHashSuccesses++;                      // One more success.
+  flags=ttGet(searchData,currentPly,0,score,searchData.hashMoves[currentPly]);
+  searchData.stats.hashProbes++;
+  searchData.stats.hashProbesByDepth[0]++;
+  if (flags!=0) {
+    searchData.stats.hashHits++;                        // One more success.
+    searchData.stats.hashHitsByDepth[0]++;
+  }
 
   // Is it an exact score, if so leave with it.
   if (flags==EXACTSCORE) {
@@ -100,13 +102,13 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
 
   // Set the initial value of best to the evaluation.
   // Try to use a cheap estimate, if possible (taking 1 pawn as max pos value!).
-  mEval=getMaterialEval(searchData, g_currentSide, getOtherSide(g_currentSide), currentPly);
+  mEval=getMaterialEval(searchData, pos.currentSide, getOtherSide(pos.currentSide), currentPly);
   if (currentPly>0
       && (((mEval-searchData.minPositionEval[currentPly-1])
            +static_cast<int>(EVAL_WINDOW*static_cast<double>(PIECE_VALUE[PAWN])))<alpha
           || ((mEval-searchData.maxPositionEval[currentPly-1])
               -static_cast<int>(EVAL_WINDOW*static_cast<double>(PIECE_VALUE[PAWN])))>beta)) {
-    searchData.numMaterialEvals++;
+    searchData.stats.materialEvals++;
 
     // Set best to a pesimistic value rather than just the material, in case
     // we decide to use htis - in which case it want's re-doing.
@@ -114,9 +116,14 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
     best=mEval;                // Use esitimate.
   }
   else {
-    searchData.numTrueEvals++;
+    searchData.stats.trueEvals++;
 
-    pEval=searchData.evalParams.eval();       // Use real evaulation.
+    // Use real evaulation (unless it's in the eval cache).
+    if (!evalCacheGet(searchData,pEval)) {
+      pEval=searchData.evalParams.eval(pos,searchData.pieceSquareSums[currentPly],
+                                      searchData.pawnTable);
+      evalCachePut(searchData,pEval);
+    }
     best=mEval+pEval; // Use real evaulation.
 
     // Is it as new maximum positional evaluation score for this depth?
@@ -131,23 +138,19 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
   //best=evalParams.Eval();  // Use real evaulation.
 
   // Generate all moves if in check, else just gen captures (if no cut!).
-  if (g_currentState->inCheck) {
-    genMoves(moves);
-    searchData.totalMoveGens++;
-    scoreMoves(searchData,currentPly,moves,moveScores,nullMove);
+  if (pos.currentState->inCheck) {
+    picker.init(searchData,currentPly,nullMove,false);
   }
   else {
 
     // See if we can cut off search here.
     if (best>=beta) {
-      searchData.numBetaCutOffs++;
+      searchData.stats.betaCutoffs++;
       goto LeaveQSearch;
     }
 
     // Generate only captures and promotions.
-    genCaptures(moves);
-    searchData.totalMoveGens++;
-    scoreMoves(searchData,currentPly,moves,moveScores,nullMove);
+    picker.init(searchData,currentPly,nullMove,true);
 
   }
 
@@ -155,25 +158,21 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
   alpha=std::max(best,alpha);
 
   // Loop through the moves.
-  for (int i=0;i<moves.numMoves;i++) {
+  while (picker.next(move,moveScore)) {
 
-    sortMoves(moves,moveScores,i);
-
-    if (!makeMove(moves.moves[i]))
+    if (!makeMoveInPlace(pos,move))
       continue;
+    ttPrefetch(pos);
 
-    // Update the material evaluation.
-    updateMaterialEvaluation(searchData,currentPly,moves.moves[i]);
+    // Update the material and piece-square evaluations.
+    updateRunningEvaluation(searchData,currentPly,move);
 
     found=true;                    // We have found a legal move.
 
     // Search the next ply.
     score=-quiesceSearch(searchData,currentPly+1,-beta,-alpha,nullMove);// Call self.
 
-    // Get the hash key before we take the move back.
-    nextHashKey=g_currentState->key;
-
-    takeMoveBack();                // Take the move back.
+    unmakeMove(pos);                  // Take the move back.
 
     // Check to see if timed out (Time is huge if no time limit!).
     if (shouldTimeOut(searchData)==true)
@@ -182,16 +181,14 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
     // See if score is better than old best.
     if (score>best) {
 
-      bestMove=moves.moves[i];
-
-      bestHashKey=nextHashKey;
+      bestMove=move;
 
       // Save for later.
       best=score;                      // Save the new best score.
 
       // See if it's a beta-cuttoff.
       if (best>=beta) {
-        searchData.numBetaCutOffs++;
+        searchData.stats.betaCutoffs++;
         goto LeaveQSearch;         // For update ect.
       }
 
@@ -203,7 +200,7 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
 
     // See if it's a beta-cuttoff (so we can prune here after avoiding check).
     else if (score>=beta) {
-      searchData.numBetaCutOffs++;
+      searchData.stats.betaCutoffs++;
       best=score;                        // Cuttoff?
       goto LeaveQSearch;             // For update ect.
     }
@@ -218,7 +215,7 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
   // If we're in check and there aren't any legal moves, well, we lost.
   // NOTE: This is not definitely forced and should be extended in Search() to 
   //       make sure it realy is a forced mate.
-  if ((!found) && g_currentState->inCheck)
+  if ((!found) && pos.currentState->inCheck)
     best=(-WIN_SCORE)+currentPly; // <*** N moves to go can be worked out!
 
   // Jump here when a draw if found at the top of function.
@@ -227,12 +224,12 @@ int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
   // Update the TTable here.
   if (g_searchConfig.enableSearchDiagnostics && upperbound<best)
     std::cout << "Inconsistencies UB:" << upperbound << " best:" << best << std::endl;
-  ttPut(searchData,currentPly,0,saveAlpha,beta,best,bestMove,bestHashKey);
+  ttPut(searchData,currentPly,0,saveAlpha,beta,best,bestMove);
 
   // Update the cuttoff totals.
   // NOTE: Don't alter the move history here (ends up slower! - more nodes).
   if (best>saveAlpha && bestMove.source!=-1) {
-    searchData.numAlphaCutOffs++;
+    searchData.stats.alphaUpdates++;
 
     // Move history.
     searchData.moveHistory[bestMove.source][bestMove.target]|=1;
@@ -18,6 +18,8 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
   // Now uses the null move heuristic.
   // NOTE: If StartTime=0, then won't show thinking!
 
+  Position &pos=searchData.pos;  // The position we are searching.
+
   int score;                     // Returned from recursicve call.
    bool found=false;              // true if at least 1 legal move found.
 
@@ -34,16 +36,25 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
    bool banNullForThisCall=false;
    // This is used to store the enpassent/fifty counter info before a null move.
    int oldEnPass,oldFiftyCounter;
-
-   // The hash key of the move we just made.
-   HashKey nextHashKey;
-
-   // This is the best Next hash key we got.
-   HashKey bestHashKey=0;
-
-   // This is the list of moves/Captures generated from this state.
-   MoveList moves;
-   int      moveScores[MOVELIST_ARRAY_SIZE];
+   HashKey oldKey;
+
+
+   // Hands out the moves from this state (generating them in stages).
+   MovePicker picker;
+   MoveStruct move;               // The move being tried.
+   int        moveScore;          // Its sort score.
+
+  // For the shallow depth pruning and late move reductions.
+  const bool inCheck=pos.currentState->inCheck; // Before any move is made.
+  int mEval;                     // Running material score.
+  int staticLow=-WIN_SCORE;      // Pessimistic static score.
+  int staticHigh=WIN_SCORE;      // Optimistic static score.
+  bool futile=false;             // true if quiet moves can't reach alpha.
+  int futileScore=-WIN_SCORE;    // The most a futile move could score.
+  int numLegal=0;                // Legal moves tried so far.
+  int64_t moveStartNodes=0;      // Nodes before the (root) move was made.
+  bool quietMove;                // Not a capture/promotion and not checking.
+  int reduction;                 // Late move reduction for this move.
 
   // Check to see if timed out (Time is huge if no time limit!).
   if (shouldTimeOut(searchData)==true)
@@ -53,8 +64,8 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
   // search depth is not reduced by the opponent checking us again and again.
   // NOTE: Done here - Before Quiesce test!
   // Note: No MAX_SEARCH_DEPTH limit - check extensions allowed at any depth.
-  if (g_currentState->inCheck) {
-    searchData.numCheckExtensions++;
+  if (inCheck) {
+    searchData.stats.checkExtensions++;
     depth++;          // Extend depth.
   }
 
@@ -66,7 +77,7 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
   if (depth<=0) {
     score=quiesceSearch(searchData,currentPly,alpha,beta,nullMove);
     if (isMateScore(score)) {
-      searchData.numMateExtensions++;
+      searchData.stats.mateExtensions++;
       depth++;                    // Extend.
     }
     else {
@@ -75,7 +86,7 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
   }
 
   // One more node searched.
-  searchData.totalNodesSearched++;
+  searchData.stats.nodes++;
 
   // Always push up these values if needed (in case we only have 1 move!).
   if (searchData.minPositionEval[currentPly]<searchData.minPositionEval[currentPly+1])
@@ -87,7 +98,7 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
   bestMove = MoveStruct{NONE, NONE, NORMAL_MOVE, NO_PROMOTION};
 
   // Test here so we can cut off the search as pointless to search further.
-  if (g_currentState->isDraw) {
+  if (pos.currentState->isDraw) {
     best=getDrawScore();               // Draw situtaion.
     goto LeaveSearch;                // To save in TTable ect.
   }
@@ -98,11 +109,19 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
   // if we now get a cut-off due to the new alpha/beta, return the score.
 
   // See if the states in the hash already.
-   flags=ttGet(searchData,currentPly,depth,score,searchData.hashMoves[currentPly],
-              nextHashKey);
-  searchData.totalGetHashCount++;
-  if (flags!=0)
-   searchData.numHashSuccesses++;                      // One more success.
+   flags=ttGet(searchData,currentPly,depth,score,searchData.hashMoves[currentPly]);
+  searchData.stats.hashProbes++;
+  searchData.stats.hashProbesByDepth[std::min(depth,MAX_STATS_DEPTH-1)]++;
+  if (flags!=0) {
+    searchData.stats.hashHits++;                        // One more success.
+    searchData.stats.hashHitsByDepth[std::min(depth,MAX_STATS_DEPTH-1)]++;
+  }
+
+  // Never cut the root with a hash score, as then no move would be chosen.
+  // NOTE: The table is kept between moves (and shared with the helper
+  //       threads), so the root is often already in it deep enough.
+  if (currentPly==0)
+    flags=0;                             // Still use the hash move though.
 
   // Is it an exact score, if so leave with it.
   if (flags==EXACTSCORE) {
@@ -126,6 +145,28 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
      alpha=score;                       // Set alpha (why not like above?).
   }
 
+  // Estimate the static score from the running material, using the last
+  // ply's positional range as quiesceSearch() does for its lazy evaluation.
+  if (currentPly>0) {
+    mEval=getMaterialEval(searchData, pos.currentSide, getOtherSide(pos.currentSide), currentPly);
+    staticLow=(mEval-searchData.maxPositionEval[currentPly-1])
+              -static_cast<int>(EVAL_WINDOW*static_cast<double>(PIECE_VALUE[PAWN]));
+    staticHigh=(mEval-searchData.minPositionEval[currentPly-1])
+               +static_cast<int>(EVAL_WINDOW*static_cast<double>(PIECE_VALUE[PAWN]));
+  }
+
+  // Reverse futility pruning: Near the frontier of a zero window search, if
+  // even the pessimistic score is well above beta then a move will be too.
+  if (currentPly>0
+      && beta-alpha==1
+      && depth<=REVERSE_FUTILITY_DEPTH
+      && !inCheck
+      && !isMateScore(beta)
+      && staticLow-depth*static_cast<int>(REVERSE_FUTILITY_MARGIN*static_cast<double>(PIECE_VALUE[PAWN]))>=beta) {
+    best=staticLow-depth*static_cast<int>(REVERSE_FUTILITY_MARGIN*static_cast<double>(PIECE_VALUE[PAWN]));
+    goto LeaveSearch;                      // For TTable update.
+  }
+
   // Attempt to cut off the search with the (deep) null move heuristic.
   // Not done if any of the following are so:
   // 1. If the current ply is 0, as this always has beta==WIN_SCORE at this
@@ -149,20 +190,26 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
       && banNullForThisCall==false
       && (nullMove==false)
       && depth>1
-      && !g_currentState->inCheck 
-      && (getMaterialEval(searchData, g_currentSide, getOtherSide(g_currentSide), currentPly)+PIECE_VALUE[PAWN])>beta
+      && !inCheck
+      && (getMaterialEval(searchData, pos.currentSide, getOtherSide(pos.currentSide), currentPly)+PIECE_VALUE[PAWN])>beta
       && beta>(-(WIN_SCORE-1))+currentPly
-      && getPieceMaterial(searchData, g_currentSide, currentPly)>PIECE_VALUE[BISHOP]
-      && getPieceMaterial(searchData, getOtherSide(g_currentSide), currentPly)>0) {
+      && getPieceMaterial(searchData, pos.currentSide, currentPly)>PIECE_VALUE[BISHOP]
+      && getPieceMaterial(searchData, getOtherSide(pos.currentSide), currentPly)>0) {
 
     // Make the null move (ie: Simply switch sides!).
-    g_currentSide=getOtherSide(g_currentSide);
+    pos.currentSide=getOtherSide(pos.currentSide);
 
     // Save and clear the old enpassent/fifty counter, in case it was set.
-    oldEnPass=g_currentState->enPass;
-    g_currentState->enPass=NO_EN_PASSANT;
-    oldFiftyCounter=g_currentState->fiftyCounter;
-    g_currentState->fiftyCounter=0; // Init to Zero to stop TestRep from using!
+    // NOTE: And the key, which has the side to move and en-passent in.
+    oldKey=pos.currentState->key;
+    pos.currentState->key^=g_sideHashCode;
+    oldEnPass=pos.currentState->enPass;
+    if (oldEnPass!=NO_EN_PASSANT)
+      pos.currentState->key^=g_enPassantHashCode[oldEnPass];
+    pos.currentState->enPass=NO_EN_PASSANT;
+    oldFiftyCounter=pos.currentState->fiftyCounter;
+    pos.currentState->fiftyCounter=0; // Init to Zero to stop TestRep from using!
+    storeRepetitionKey(pos);
 
     // Call Search() to find score, we use depth -3 as we are expecting to
     // search at least 2 plys further than without it (I think?!). Also Use a 
@@ -171,19 +218,29 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
     score=-search(searchData,currentPly,-beta,(-beta)+1,depth-3,true);
 
     // Take the (null) move back (ie: Simply switch sides!).
-    g_currentSide=getOtherSide(g_currentSide);
+    pos.currentSide=getOtherSide(pos.currentSide);
 
     // Restore the old enpassent/firty counter info.
-    g_currentState->enPass=oldEnPass;
-    g_currentState->fiftyCounter=oldFiftyCounter;
+    pos.currentState->enPass=oldEnPass;
+    pos.currentState->fiftyCounter=oldFiftyCounter;
+    pos.currentState->key=oldKey;
+    storeRepetitionKey(pos);
 
     // Check to see if timed out (Time is huge if no time limit!).
     if (shouldTimeOut(searchData)==true)
       return 0;                    // Search invalid now , leaving recusion.
 
+    // Verify deep null move cutoffs with a reduced search of our own moves
+    // (with no null moves below), so zugzwang doesn't fool us.
+    if (score>=beta && depth>=NULL_VERIFY_DEPTH) {
+      score=search(searchData,currentPly,beta-1,beta,depth-3,true);
+      if (shouldTimeOut(searchData)==true)
+        return 0;                  // Search invalid now , leaving recusion.
+    }
+
     // If score>=beta, then we can cut the node.
     if (score>=beta) {
-      searchData.numNullCutOffs++;                      // One more null cutoff done.
+      searchData.stats.nullCutoffs++;                   // One more null cutoff done.
       best=score;                                // Save as score.
       goto LeaveSearch;                      // For TTable update.
     }
@@ -191,28 +248,48 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
     // Not sure what this extention is for? (cap extention distance in case!)
     // Note: No MAX_SEARCH_DEPTH limit.
     if ((depth-3)>=1 
-             && getMaterialEval(searchData, g_currentSide, getOtherSide(g_currentSide), currentPly)>beta && score<=((-WIN_SCORE)+100)) {
+             && getMaterialEval(searchData, pos.currentSide, getOtherSide(pos.currentSide), currentPly)>beta && score<=((-WIN_SCORE)+100)) {
       depth++;
     }
 
   }
 
-    // Generate all moves.
-  genMoves(moves);
-  searchData.totalMoveGens++;
-   scoreMoves(searchData,currentPly,moves,moveScores,nullMove);
-
-  // Loop through the moves.
-   for (int i=0;i<moves.numMoves;i++) {
+  // Futility pruning: At the frontier, if even the optimistic score can't
+  // reach alpha then only captures, promotions and checks are worth trying.
+  if (currentPly>0
+      && depth<=FUTILITY_DEPTH
+      && !inCheck
+      && !isMateScore(alpha)
+      && staticHigh+depth*static_cast<int>(FUTILITY_MARGIN*static_cast<double>(PIECE_VALUE[PAWN]))<=alpha) {
+    futile=true;
+    futileScore=staticHigh+depth*static_cast<int>(FUTILITY_MARGIN*static_cast<double>(PIECE_VALUE[PAWN]));
+  }
 
-     sortMoves(moves,moveScores,i);
+  // Loop through the moves (generated as they are needed).
+  picker.init(searchData,currentPly,nullMove,false);
+  while (picker.next(move,moveScore)) {
 
     // Try to make the move.
-    if (!makeMove(moves.moves[i]))
+    if (!makeMoveInPlace(pos,move))
       continue;
+    ttPrefetch(pos);
+    numLegal++;
+    if (currentPly==0)
+      moveStartNodes=searchData.stats.nodes;
+
+    // Quiet moves are the ones we prune/reduce.
+    quietMove=!(move.type&(CAPTURE|PROMOTION))
+              && !pos.currentState->inCheck && !pos.currentState->isDraw;
+
+    // Skip futile quiet moves (once we have a legal move for the mate test).
+    if (futile && found && quietMove) {
+      unmakeMove(pos);
+      best=std::max(best,futileScore);  // Fail-soft bound.
+      continue;
+    }
 
-    // Update the material evaluation.
-    updateMaterialEvaluation(searchData,currentPly,moves.moves[i]);
+    // Update the material and piece-square evaluations.
+    updateRunningEvaluation(searchData,currentPly,move);
 
     // Search with a full window for the first branch and zero for others.
     if (found==false) {
@@ -224,8 +301,31 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
       // Fail soft condition.
       alpha=std::max(best,alpha);
 
+      // Late move reductions: Reduce quiet moves sorted after the hash move,
+      // killers and the first few legal moves, by more the later they come.
+      // Moves that have caused a cutoff at this depth before (see moveHistory)
+      // and moves at PV nodes are reduced less.
+      reduction=0;
+      if (depth>=LMR_MIN_DEPTH
+          && numLegal>LMR_FULL_DEPTH_MOVES
+          && quietMove
+          && !inCheck
+          && moveScore<KILLER_SORT_SCORE/2) {
+        reduction=(numLegal>LMR_LATE_MOVES && depth>LMR_MIN_DEPTH) ? 2 : 1;
+        if (searchData.moveHistory[move.source][move.target]
+            >=(1<<std::min(depth,30)))
+          reduction--;
+        if (beta-alpha>1)
+          reduction--;
+        reduction=std::max(reduction,0);
+      }
+
       // Search with a zero window.
-      score=-search(searchData,currentPly+1,(-alpha)-1,-alpha,depth-1,nullMove);
+      score=-search(searchData,currentPly+1,(-alpha)-1,-alpha,depth-1-reduction,nullMove);
+
+      // If a reduced move beats alpha, then search it again at full depth.
+      if (reduction>0 && score>alpha)
+        score=-search(searchData,currentPly+1,(-alpha)-1,-alpha,depth-1,nullMove);
 
       // Do we need to re-search the move.
       if (score>best && score>alpha && score<beta) {
@@ -241,10 +341,7 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
       }
     }
 
-    // Get the hash key before we take the move back.
-    nextHashKey=g_currentState->key;
-
-    takeMoveBack();                 // Take the move back.
+    unmakeMove(pos);                   // Take the move back.
 
     // Check to see if timed out (Time is huge if no time limit!).
     if (shouldTimeOut(searchData)==true)
@@ -253,9 +350,7 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
     // Test aginst best.
     if (score>best) {
 
-      bestMove=moves.moves[i];
-
-      bestHashKey=nextHashKey;
+      bestMove=move;
 
       // Save it for later.
       best=score;                       // Save the new best score.
@@ -276,7 +371,10 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
 
       // See if it's a cuttoff?
       if (best>=beta) {
-        searchData.numBetaCutOffs++;
+        searchData.stats.betaCutoffs++;
+        searchData.stats.moveCutoffs++;
+        if (numLegal==1)
+          searchData.stats.firstMoveCutoffs++;
         goto LeaveSearch;           // So we may update killers ect.
       }
 
@@ -285,6 +383,7 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
        if (currentPly==0 && best>searchData.rootAlpha && best<searchData.rootBeta) {
          searchData.computersMove = bestMove;
          searchData.computersMoveScore=best;    // Save it.
+         searchData.computersMoveNodes=searchData.stats.nodes-moveStartNodes;
          if (searchData.startTime!=0 && searchData.iterDepth>1)
           printLine(searchData,searchData.computersMove,searchData.computersMoveScore,'&');
       }
@@ -301,7 +400,7 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
   // If No legal moves? then we're in checkmate or stalemate.
   // BUG: Set best and then see if it needs storing anywhere (history ect).
   if (!found) {
-    if (g_currentState->inCheck)
+    if (pos.currentState->inCheck)
       best=(-WIN_SCORE)+currentPly;    // Checkmate.
     else
       best=getDrawScore();               // Stalemate.
@@ -313,14 +412,13 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
   // Update the TTable here.
   if (g_searchConfig.enableSearchDiagnostics && upperbound<best)
     std::cout << "Inconsistencies UB:" << upperbound << " best:" << best << std::endl;
-   ttPut(searchData,currentPly,depth,saveAlpha,beta,best,bestMove,
-        bestHashKey);
+   ttPut(searchData,currentPly,depth,saveAlpha,beta,best,bestMove);
 
   // As this move caused a alpha update, it's history value should be 
   // increased. Note, beta cuttoff will get updated here too!
   // Also add it to the killer move vector.
    if (best>saveAlpha && bestMove.source!=-1) {
-     searchData.numAlphaCutOffs++;
+     searchData.stats.alphaUpdates++;
     searchData.moveHistory[bestMove.source][bestMove.target]|=(1<<depth);
 
     // Add this move to a killer move vector for this ply.
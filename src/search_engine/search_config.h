@@ -20,11 +20,18 @@ struct SearchConfig {
   static constexpr size_t DEFAULT_MAX_PLYS_PER_GAME = 1000;
   static constexpr size_t DEFAULT_MAX_QUIESCE_DEPTH = 500;
   static constexpr size_t DEFAULT_HASH_SIZE_MB = 512;  // ~16M entries at default size
+  static constexpr size_t DEFAULT_NUM_THREADS = 1;
+  static constexpr size_t DEFAULT_PAWN_HASH_SIZE_MB = 2;  // Per search thread
+  static constexpr size_t DEFAULT_EVAL_CACHE_SIZE_MB = 0;  // Off (1 MB = 128K entries)
   
   // Maximum allowed values for validation
   static constexpr size_t MAX_PLYS_PER_GAME_LIMIT = 10000;
   static constexpr size_t MAX_QUIESCE_DEPTH_LIMIT = 10000;
   static constexpr size_t MAX_HASH_SIZE_MB = 1024 * 1024;  // 1TB
+  static constexpr size_t MAX_NUM_THREADS_LIMIT = 256;
+  static constexpr size_t MAX_PAWN_HASH_SIZE_MB = 1024;
+  static constexpr size_t MAX_EVAL_CACHE_SIZE_MB = 65536;
+  static constexpr size_t MIN_HASH_POW2 = 14;  // 16K 64-byte buckets = 1 MB
   
   // Game history limits (fixed at defaults for now)
   size_t maxPlysPerGame = DEFAULT_MAX_PLYS_PER_GAME;
@@ -36,14 +43,29 @@ struct SearchConfig {
   // User specifies size in MB, we calculate actual slots
   size_t hashSizeMB = DEFAULT_HASH_SIZE_MB;
   
-  // Computed: Actual number of hash slots (power of 2)
-  // This is computed from hashSizeMB and HashRecord size
+  // Computed: Actual number of hash buckets (power of 2)
+  // This is computed from hashSizeMB and TTBucket size (one cache line)
   size_t numHashSlots = 0;
   
   // Computed: Power of 2 used for the hash table
   // Table size = 2^hashPow2
   size_t hashPow2 = 0;
   
+  // Number of search threads (Lazy SMP: all threads share the hash table)
+  size_t numThreads = DEFAULT_NUM_THREADS;
+
+  // Interleave the hash table's pages across all NUMA nodes (configurable via
+  // CLI). Only worth it on multi-socket machines with many threads.
+  bool numaInterleave = false;
+
+  // Pawn hash table size (configurable via CLI/UCI). Each search thread has its
+  // own table of this size, so it needs no locking.
+  size_t pawnHashSizeMB = DEFAULT_PAWN_HASH_SIZE_MB;
+
+  // Evaluation cache size (configurable via CLI/UCI). Shared by all the search
+  // threads like the hash table, but sized separately (0 = no cache).
+  size_t evalCacheSizeMB = DEFAULT_EVAL_CACHE_SIZE_MB;
+  
   // =============================================================================
   // SEARCH ALGORITHM FLAGS (formerly compile-time defines)
   // =============================================================================
@@ -76,8 +98,8 @@ struct SearchConfig {
   // Finds the largest power of 2 that fits within the specified MB limit.
   
   void computeHashSize() {
-    // Get actual size of hash record at runtime
-    const size_t recordSize = sizeof(HashRecord);
+    // Get actual size of hash bucket at runtime
+    const size_t recordSize = sizeof(TTBucket);
     
     // Calculate target number of records from MB
     // hashSizeMB * 1024 * 1024 bytes available
@@ -94,10 +116,10 @@ struct SearchConfig {
       hashPow2++;
     }
     
-    // Ensure minimum reasonable size (2^16 = 64K slots)
-    if (hashPow2 < 16) {
-      hashPow2 = 16;
-      slots = 1 << 16;
+    // Ensure minimum reasonable size (2^14 = 16K buckets, ie: 1 MB)
+    if (hashPow2 < MIN_HASH_POW2) {
+      hashPow2 = MIN_HASH_POW2;
+      slots = size_t(1) << MIN_HASH_POW2;
     }
     
     // Ensure we don't overflow size_t
@@ -119,7 +141,10 @@ struct SearchConfig {
     if (maxQuiesceDepth == 0 || maxQuiesceDepth > MAX_QUIESCE_DEPTH_LIMIT) return false;
     if (hashSizeMB == 0 || hashSizeMB > MAX_HASH_SIZE_MB) return false;
     if (numHashSlots == 0) return false;
-    if (hashPow2 < 16 || hashPow2 >= sizeof(size_t) * 8) return false;
+    if (hashPow2 < MIN_HASH_POW2 || hashPow2 >= sizeof(size_t) * 8) return false;
+    if (numThreads == 0 || numThreads > MAX_NUM_THREADS_LIMIT) return false;
+    if (pawnHashSizeMB == 0 || pawnHashSizeMB > MAX_PAWN_HASH_SIZE_MB) return false;
+    if (evalCacheSizeMB > MAX_EVAL_CACHE_SIZE_MB) return false;
     // Boolean flags are always valid
     return true;
   }
@@ -130,7 +155,7 @@ struct SearchConfig {
   
   // Calculate actual memory usage of hash table
   [[nodiscard]] size_t getHashMemoryBytes() const {
-    return numHashSlots * sizeof(HashRecord);
+    return numHashSlots * sizeof(TTBucket);
   }
   
   [[nodiscard]] size_t getHashMemoryMB() const {
@@ -5,9 +5,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <vector>
 #include <array>
+#include <atomic>
+#include <iosfwd>
 
 #include "../chess_engine/types.h"
 #include "../chess_engine/chess_engine.h"
@@ -30,6 +33,52 @@ constexpr double EVAL_WINDOW = 0.99;                    // 0.5 to 0.99 seems ok
 // This is the root aspiration window.
 constexpr double ASPIRATION_WINDOW = 0.5;
 
+// Reverse futility (static null move) pruning: At shallow depths, cut the
+// node if the pessimistic static score is still this far above beta (in pawns
+// per ply of depth left).
+constexpr int REVERSE_FUTILITY_DEPTH = 3;
+constexpr double REVERSE_FUTILITY_MARGIN = 1.0;
+
+// Futility pruning: At the frontier, skip quiet moves if the optimistic
+// static score plus this margin (pawns per ply of depth left) can't reach
+// alpha.
+constexpr int FUTILITY_DEPTH = 2;
+constexpr double FUTILITY_MARGIN = 1.0;
+
+// Late move reductions: Quiet moves after the first few are searched with
+// less depth (and re-searched if they beat alpha).
+constexpr int LMR_MIN_DEPTH = 3;                        // Don't reduce shallower.
+constexpr int LMR_FULL_DEPTH_MOVES = 3;                 // Legal moves not reduced.
+constexpr int LMR_LATE_MOVES = 8;                       // Reduce 2 plies after this.
+
+// Null move verification: At this depth or deeper, a null move cutoff is
+// only trusted if a reduced search (with no null moves) also fails high.
+constexpr int NULL_VERIFY_DEPTH = 6;
+
+// Time polling: The clock is only read every so many nodes, aiming for
+// about TIME_CHECK_SECONDS between reads at the measured nodes/second.
+constexpr int64_t TIME_CHECK_MIN_NODES = 1024;
+constexpr int64_t TIME_CHECK_MAX_NODES = 4096;
+constexpr double TIME_CHECK_SECONDS = 0.001;
+
+// Time management (see time_manager.cpp). The clock is shared out over
+// TM_DEFAULT_MOVES_TO_GO moves unless told otherwise. The soft limit is
+// scaled between iterations by how settled the search looks, and the hard
+// limit (where the search is cut off) is a multiple of it.
+constexpr int    TM_DEFAULT_MOVES_TO_GO = 30;
+constexpr double TM_INCREMENT_SHARE = 0.75;         // Of the increment, per move.
+constexpr double TM_MAX_SOFT_SHARE = 0.5;           // Of the time left.
+constexpr double TM_MAX_HARD_SHARE = 0.75;          // Of the time left.
+constexpr double TM_HARD_RATIO = 3.0;               // Hard limit/soft limit.
+constexpr double TM_CHANGED_FACTOR = 1.4;           // Best move changed last iteration.
+constexpr double TM_STABLE_STEP = 0.1;              // Less for each stable iteration,
+constexpr double TM_MIN_STABLE_FACTOR = 0.5;        // down to this.
+constexpr double TM_SCORE_DROP_PAWNS = 0.5;         // A drop this big (or more),
+constexpr double TM_MAX_DROP_FACTOR = 2.0;          // gives this much more time.
+constexpr double TM_DOMINANT_SHARE = 0.9;           // Of the nodes on the best move,
+constexpr double TM_DOMINANT_FACTOR = 0.6;          // gives this much less time.
+constexpr double MIN_SEARCH_SECONDS = 0.01;
+
 // For calling PlayGame() function with.
 constexpr int TWO_HUMANS = 0;                           // Two Human Players.
 constexpr int COMPUTER_WHITE = 1;                       // Computer Plays White.
@@ -57,14 +106,14 @@ constexpr int UPPERBOUND = 2;                           // Upper bound score.
 constexpr int EXACTSCORE = 4;                           // Exact score.
 constexpr int QUIESCENT = 8;                            // Is the position quiescent?
 
-// These are the basic material values: ONLY USED BY BasicMaterialEval().
+// These are the basic material values: used by BasicMaterialEval() and the SEE.
 constexpr int PIECE_VALUE[6] = {10000, 30000, 30000, 50000, 90000, 0};
 
 // =============================================================================
 
 // SEARCH DATA TYPES:
 
-// Note: HashRecord is now defined in types.h
+// Note: TTEntry/TTBucket are now defined in types.h
 
 // This is used to keep ruinning material scores (Pawn/Pieces) for each side.
 struct RunningMaterial {
@@ -72,6 +121,82 @@ struct RunningMaterial {
   std::vector<std::array<int, 2>> pawnMatValue;
 }; // End RunningMaterial.
 
+// Per-depth statistics are kept for this many depths (deeper ones are counted
+// in the last).
+constexpr int MAX_STATS_DEPTH = 64;
+
+// A 64-bit statistics counter. Only the thread that owns it adds to it, but
+// others may read it while it is searching (eg: getTotalNodes()), so it is a
+// relaxed atomic that is added to with a plain load and store (no lock).
+class StatCounter {
+public:
+  StatCounter() = default;
+  StatCounter(const StatCounter& other) : value(other.get()) {}
+  StatCounter& operator=(const StatCounter& other) { set(other.get()); return *this; }
+
+  void operator++(int) { add(1); }
+  void add(int64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+  void set(int64_t n) { value.store(n, std::memory_order_relaxed); }
+  [[nodiscard]] int64_t get() const { return value.load(std::memory_order_relaxed); }
+  operator int64_t() const { return get(); }
+
+private:
+  std::atomic<int64_t> value{0};
+}; // End StatCounter.
+
+// The statistics of a search (see search_stats.cpp). Each search thread keeps
+// its own in its SearchData, and think() adds them up when it finishes.
+struct SearchStats {
+  StatCounter nodes;                   // search() and quiesceSearch() nodes.
+  StatCounter qsearchNodes;            // Of which quiesceSearch().
+  StatCounter alphaUpdates;
+  StatCounter betaCutoffs;             // Including quiesceSearch()'s stand pat.
+  StatCounter moveCutoffs;             // Beta cutoffs by a move in search().
+  StatCounter firstMoveCutoffs;        // Of which by the first legal move.
+  StatCounter nullCutoffs;
+  StatCounter materialEvals;
+  StatCounter trueEvals;
+  StatCounter moveGens;
+  StatCounter hashProbes;
+  StatCounter hashHits;
+  StatCounter hashPuts;
+  StatCounter hashCollisions;
+  StatCounter checkExtensions;
+  StatCounter mateExtensions;
+  StatCounter pawnHashProbes;          // Set by think() from each pawn table.
+  StatCounter pawnHashHits;
+  StatCounter evalCacheHits;
+  StatCounter evalCacheMisses;
+
+  // By remaining depth (0 = quiescent search).
+  std::array<StatCounter, MAX_STATS_DEPTH> hashProbesByDepth;
+  std::array<StatCounter, MAX_STATS_DEPTH> hashHitsByDepth;
+
+  // Filled in by think(): the nodes (all threads) to complete each iteration,
+  // and the search as a whole.
+  std::array<StatCounter, MAX_STATS_DEPTH> iterationNodes;
+  int    completedDepth = 0;
+  int    numThreads = 1;
+  double wallSeconds = 0.0;
+  double cpuSeconds = 0.0;
+  int    hashFull = 0;                 // Permille.
+
+  void reset();
+  SearchStats& operator+=(const SearchStats& other);  // Adds the counters only.
+}; // End SearchStats.
+
+// The limits for one call of think() (the defaults are search forever).
+// NOTE: Used by the UCI driver, the older think() call just sets depth/time.
+struct SearchLimits {
+  int     depth = 0;                        // Max iteration depth (0 = none).
+  double  timeSeconds = INFINITE_TIME;      // Time to search for (the hard limit).
+  double  softTimeSeconds = INFINITE_TIME;  // Playing on a clock: see TimeManager.
+  int64_t nodes = 0;                        // Main thread node limit (0 = none).
+  bool    infinite = false;                 // Don't stop at depth/mate, only when told.
+  const std::atomic<bool>* stop = nullptr;  // Set by the caller to stop early.
+  bool    uciOutput = false;                // Print UCI "info" lines when thinking.
+}; // End SearchLimits.
+
 // This hold all that is needed during a search.
 struct SearchData : RunningMaterial {
 
@@ -79,22 +204,13 @@ struct SearchData : RunningMaterial {
   // ES is set by think so that the correct set is used for a whole search.
   EvaluationParameters evalParams;          // Loaded from file in main.
 
+  // The position being searched (a private copy of the root, per thread).
+  Position pos;
+
   // --------------------------------------------------------------------------
 
-  // These are the extra stats collected while searching.
-  int totalNodesSearched;
-  int numAlphaCutOffs;
-  int numBetaCutOffs;
-  int numMaterialEvals;
-  int numTrueEvals;
-  int numNullCutOffs;
-  int totalMoveGens;
-  int numHashCollisions;
-  int totalPutHashCount;
-  int totalGetHashCount;
-  int numHashSuccesses;
-  int numCheckExtensions;
-  int numMateExtensions;
+  // These are the extra stats collected while searching (by this thread).
+  SearchStats stats;
 
   // The Iterative Deepening depth we are on.
   int iterDepth;
@@ -109,6 +225,35 @@ struct SearchData : RunningMaterial {
   // Used for exiting searches when time is up.
   ClockTime stopTime;   // For storing the stopping time in CPU secs.
 
+  // Time polling (see shouldTimeOut()): The clock is next read at nextTimeCheck
+  // nodes, and the interval is recalibrated from the last read each time.
+  int64_t   nextTimeCheck;
+  int64_t   timeCheckInterval;
+  int64_t   lastCheckNodes;
+  ClockTime lastCheckTime;
+
+  // Set once the search has timed out (or been told to stop), so that every
+  // later test agrees even though the clock isn't read each time.
+  bool timedOut;
+
+  // Set by think() to tell all the search threads to stop (nullptr if unused).
+  const std::atomic<bool>* stopSearch;
+
+  // Stop once this many nodes have been searched (0 = no limit).
+  int64_t nodeLimit;
+
+  // Print the thinking as UCI "info" lines (see printLine()).
+  bool uciOutput;
+
+
+  // The running piece-square sums for each ply (see PieceSquareSums).
+  std::vector<PieceSquareSums> pieceSquareSums;
+
+  // This thread's pawn hash table (kept between searches, cleared by reset()).
+  PawnHashTable pawnTable;
+
+  // The key of evalParams' weights, for the eval cache (see think()).
+  HashKey evalWeightsKey = 0;
 
   // This is the maximum positional score we have seen for each ply.
   // These are then used with the window to see if we can use an estimate rather
@@ -124,8 +269,8 @@ struct SearchData : RunningMaterial {
 
   // --------------------------------------------------------------------------
 
-  // This is the transpostion (hash) table.
-  std::vector<HashRecord> hashTable;
+  // NOTE: The transposition (hash) table is shared by all the search threads,
+  //       so now lives in g_transpositionTable (see transposition_table.cpp).
 
   // This is the hash move to be done.
   std::vector<MoveStruct> hashMoves; // -1,-1,-1,-1 if empty.
@@ -145,13 +290,19 @@ struct SearchData : RunningMaterial {
   // The move the computer has chosen.
   MoveStruct computersMove;
   int        computersMoveScore; 
+  int64_t    computersMoveNodes;   // This thread's nodes under it (this iteration).
+
+  // The game ply (pos.moveNum) the last search was started from (-1 if none).
+  // NOTE: The killers, hash moves, history and positional windows are kept
+  //       between the moves of a game, and only cleared by reset().
+  int lastRootMoveNum;
 
   // Constructor to initialize vectors based on configuration
-  explicit SearchData(const SearchConfig& config = SearchConfig()) {
+  explicit SearchData(const SearchConfig& config = SearchConfig()) : pos(config) {
     reset(config);
   }
 
-  // Reset/reinitialize all data structures
+  // Reset/reinitialize all data structures (ie: for a new game).
   void reset(const SearchConfig& config = SearchConfig()) {
     // Initialize RunningMaterial vectors
     pieceMatValue.assign(config.maxQuiesceDepth, std::array<int, 2>{0, 0});
@@ -160,7 +311,8 @@ struct SearchData : RunningMaterial {
     // Initialize search vectors
     minPositionEval.assign(config.maxQuiesceDepth, 0);
     maxPositionEval.assign(config.maxQuiesceDepth, 0);
-    hashTable.assign(config.numHashSlots, HashRecord{});
+    pieceSquareSums.assign(config.maxQuiesceDepth, PieceSquareSums{});
+    pawnTable.resize(config.pawnHashSizeMB);
     hashMoves.assign(config.maxQuiesceDepth, MoveStruct{-1, -1, 0, 0});
     killerMovesOld.assign(config.maxQuiesceDepth, MoveStruct{-1, -1, 0, 0});
     killerMovesNew.assign(config.maxQuiesceDepth, MoveStruct{-1, -1, 0, 0});
@@ -170,34 +322,134 @@ struct SearchData : RunningMaterial {
       row.fill(0);
     }
 
-    // Reset stats
-    totalNodesSearched = 0;
-    numAlphaCutOffs = 0;
-    numBetaCutOffs = 0;
-    numMaterialEvals = 0;
-    numTrueEvals = 0;
-    numNullCutOffs = 0;
-    totalMoveGens = 0;
-    numHashCollisions = 0;
-    totalPutHashCount = 0;
-    totalGetHashCount = 0;
-    numHashSuccesses = 0;
-    numCheckExtensions = 0;
-    numMateExtensions = 0;
+    lastRootMoveNum = -1;
+    resetStats();
+  }
+
+  // Get ready to search from the root at game ply rootMoveNum, keeping what
+  // was learnt by the last search of this game.
+  // NOTE: The per-ply tables are shifted down by the number of plies played
+  //       since, so that ply 0 is the new root again. If we can't line them
+  //       up (eg: a move was taken back) then they are just cleared.
+  void newSearch(int rootMoveNum) {
+    const int pliesPlayed = rootMoveNum - lastRootMoveNum;
+    if (lastRootMoveNum < 0 || pliesPlayed < 0
+        || static_cast<size_t>(pliesPlayed) >= hashMoves.size()) {
+      shiftPlyTables(hashMoves.size());
+    } else if (pliesPlayed > 0) {
+      shiftPlyTables(static_cast<size_t>(pliesPlayed));
+    }
+    lastRootMoveNum = rootMoveNum;
+    resetStats();
+  }
+
+  // Move the per-ply tables down by numPlies, emptying the top ones.
+  void shiftPlyTables(size_t numPlies) {
+    const MoveStruct noMove{-1, -1, 0, 0};
+    for (auto* table : {&hashMoves, &killerMovesOld, &killerMovesNew}) {
+      std::move(table->begin() + numPlies, table->end(), table->begin());
+      std::fill(table->end() - numPlies, table->end(), noMove);
+    }
+    for (auto* table : {&minPositionEval, &maxPositionEval}) {
+      std::move(table->begin() + numPlies, table->end(), table->begin());
+      std::fill(table->end() - numPlies, table->end(), 0);
+    }
+  }
+
+  // Reset the stats and search limits (done for every search).
+  void resetStats() {
+    stats.reset();
+    pawnTable.resetCounters();
     iterDepth = 0;
     startTime = 0;
     wallClockStart = 0.0;
     cpuStart = 0.0;
     stopTime = 0;
+    nextTimeCheck = TIME_CHECK_MIN_NODES;
+    timeCheckInterval = TIME_CHECK_MIN_NODES;
+    lastCheckNodes = 0;
+    lastCheckTime = 0;
+    timedOut = false;
+    stopSearch = nullptr;
+    nodeLimit = 0;
+    uciOutput = false;
     maxPositionalDiff = 0;
     rootAlpha = 0;
     rootBeta = 0;
     computersMove = MoveStruct{-1, -1, 0, 0};
     computersMoveScore = 0;
+    computersMoveNodes = 0;
   }
 
 }; // End SearchData structure.
 
+// The soft and hard time limits for a move played on a clock.
+struct TimeBudget {
+  double softSeconds;                   // Don't start an iteration after this.
+  double hardSeconds;                   // Cut the search off here.
+}; // End TimeBudget.
+
+// Decides if think() should stop after an iteration when playing on a clock
+// (only used if SearchLimits::softTimeSeconds is set): It stops early if the
+// best move has settled or one move takes nearly all the nodes, goes on for
+// longer if the best move just changed or the score dropped, and doesn't
+// start an iteration that it doesn't expect to finish by the hard limit.
+class TimeManager {
+public:
+  void start(const SearchLimits &limits,int numRootMoves);
+  [[nodiscard]] bool stopAfterIteration(const SearchData &sd,int64_t threadNodes);
+  [[nodiscard]] bool isActive() const { return active; }
+
+private:
+  bool       active = false;
+  double     softSeconds = 0.0;
+  double     hardSeconds = 0.0;
+  int        numRootMoves = 0;
+  ClockTime  startTime = 0;
+  ClockTime  iterationStart = 0;
+  MoveStruct lastBestMove{-1, -1, 0, 0};
+  int        lastScore = 0;
+  int        stableIterations = 0;
+}; // End TimeManager.
+
+// The stages of the move picker, in the order the moves are tried.
+enum class PickStage { HASH_MOVE, GEN_CAPTURES, GOOD_CAPTURES, KILLERS, GEN_QUIETS, QUIETS,
+                       BAD_CAPTURES, DONE };
+
+// Hands out the moves of one node best first, generating them in stages so a
+// cutoff on the hash move or a capture never pays for the quiet moves.
+// 1. Hash move (before any generation).
+// 2. Promotions and captures that don't lose material (MVV-LVA).
+// 3. Killer moves (this ply's, then from 2 plies back).
+// 4. Quiet moves (by move history).
+// 5. Captures that lose material by SEE (dropped when only captures wanted).
+// NOTE: The moves are pseudo-legal, so still need testing with makeMove().
+struct MovePicker {
+
+  MoveList moves;                          // Captures, then quiets added after.
+  int      moveScores[MOVELIST_ARRAY_SIZE];
+
+  SearchData* searchData;
+  int         currentPly;
+  bool        nullMove;                    // Don't favour recaptures if so.
+  bool        capturesOnly;                // For the quiescent search.
+
+  PickStage   stage;
+  int         index;                       // Next move in moves to pick from.
+  int         numCaptures;                 // Quiets are added after these.
+  int         badIndex;                    // First losing capture.
+  MoveStruct  hashMove;                    // NONE if there isn't one to try.
+  MoveStruct  killers[4];                  // Those that are pseudo-legal here.
+  int         numKillers;
+
+  // Start on a new node (the hash move is taken from hashMoves[currentPly]).
+  void init(SearchData &sd,int ply,bool isNullMove,bool onlyCaptures);
+
+  // Get the next move (and its sort score). Returns false when none are left.
+  bool next(MoveStruct &move,int &score);
+
+}; // End MovePicker.
+
 // ============================================================================
 // MODERN INLINE FUNCTIONS (replacing macros)
 // ============================================================================
@@ -218,9 +470,26 @@ struct SearchData : RunningMaterial {
   return 0;
 }
 
-// Returns true if the search should time out.
-[[nodiscard]] inline bool shouldTimeOut(const SearchData& sd) {
-  return (sd.iterDepth > 2 && getTime() >= sd.stopTime);
+// Reads the clock to see if the search is out of time, and recalibrates the
+// polling interval from the nodes searched since the last read.
+void checkTime(SearchData& sd);
+
+// Returns true if the search should time out (or has been told to stop).
+// NOTE: The first ply is always finished, so that there is a move to play.
+// NOTE: The clock is only read every few thousand nodes (see checkTime()),
+//       as it is a system call in CPU time mode. The stop flag is just a
+//       relaxed load, so is tested every time.
+[[nodiscard]] inline bool shouldTimeOut(SearchData& sd) {
+  if (sd.timedOut)
+    return true;
+  if (sd.iterDepth > 1 && sd.stopSearch != nullptr
+      && sd.stopSearch->load(std::memory_order_relaxed))
+    sd.timedOut = true;
+  else if (sd.iterDepth > 1 && sd.nodeLimit > 0 && sd.stats.nodes >= sd.nodeLimit)
+    sd.timedOut = true;
+  else if (sd.iterDepth > 2 && sd.stats.nodes >= sd.nextTimeCheck)
+    checkTime(sd);
+  return sd.timedOut;
 }
 
 // Get material value for a side - overloaded for RunningMaterial.
@@ -267,13 +536,33 @@ struct SearchData : RunningMaterial {
 // PROTOTYPES:
 
 // Think function.
-MoveStruct think(int searchDepth,double maxTimeSeconds,bool showOutput,
+void newGame(void);                              // Clear all search state.
+MoveStruct think(const Position &pos,int searchDepth,double maxTimeSeconds,bool showOutput,
+                 bool showThinking,double randomSwing,const EvaluationParameters &evalParams);
+MoveStruct think(const Position &pos,const SearchLimits &limits,bool showOutput,
                  bool showThinking,double randomSwing,const EvaluationParameters &evalParams);
+[[nodiscard]] int64_t getTotalNodes(const SearchData &sd); // Summed over all threads.
+[[nodiscard]] int64_t getLastSearchNodes(void);            // Of the last think().
+[[nodiscard]] const SearchStats& getLastSearchStats(void);  // Of the last think().
+
+// Search statistics (text table or a one line JSON object).
+void printSearchStats(const SearchStats &stats,std::ostream &out,bool json);
+
+// Time management.
+[[nodiscard]] TimeBudget allocateTime(int64_t timeLeftMs,int64_t incrementMs,int movesToGo,
+                                      int64_t moveOverheadMs);
 
 // This should be called after make move to keep the material eval consistent.
-void updateMaterialEvaluation(RunningMaterial &searchData,int currentPly,
+void updateMaterialEvaluation(const Position &pos,RunningMaterial &searchData,int currentPly,
                               const MoveStruct &moveMade);
 
+// As above, but also keeps the running piece-square sums (for the full eval).
+inline void updateRunningEvaluation(SearchData &searchData,int currentPly,const MoveStruct &moveMade) {
+  updateMaterialEvaluation(searchData.pos,searchData,currentPly,moveMade);
+  searchData.evalParams.updatePieceSquareSums(searchData.pos,searchData.pieceSquareSums[currentPly],
+                                              searchData.pieceSquareSums[currentPly+1],moveMade);
+}
+
 // Searching function.
 int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
            bool nullMove);
@@ -282,22 +571,40 @@ int search(SearchData &searchData,int currentPly,int alpha,int beta,int depth,
 int quiesceSearch(SearchData &searchData,int currentPly,int alpha,int beta,
                   bool nullMove);
 
-// Move ordering functions.
-void scoreMoves(SearchData &searchData,int currentPly,MoveList &moves,
-                int moveScores[MOVELIST_ARRAY_SIZE],bool nullMove);
+// Move ordering functions (see also MovePicker).
 void sortMoves(MoveList &moves,int moveScores[MOVELIST_ARRAY_SIZE],int source);
+[[nodiscard]] int staticExchange(const Position &pos,const MoveStruct &move); // In PIECE_VALUEs.
 
 // Quick Search functions (MATERIAL ONLY + NO BOOK-KEEPING).
-[[nodiscard]] int isQuiescent(void);               // Returns -1, for time-out.
-[[nodiscard]] int getQuiescentScore(RunningMaterial &searchData);
-int quickQuiesceSearch(RunningMaterial &searchData,int currentPly,int alpha,int beta);
+[[nodiscard]] int isQuiescent(Position &pos);               // Returns -1, for time-out.
+[[nodiscard]] int getQuiescentScore(Position &pos,RunningMaterial &searchData);
+int quickQuiesceSearch(Position &pos,RunningMaterial &searchData,int currentPly,int alpha,int beta);
 
 // Transposition Table functions.
+// NOTE: The table is shared (lockless) by all search threads.
+extern TTBucket* g_transpositionTable;
+bool ttAllocate(void);                            // (Re)size to config if changed.
+void ttClear(void);                               // Empty for a new game.
+void ttNewSearch(void);                           // Age the existing entries.
+[[nodiscard]] int ttHashFull(void);               // Permille used this search.
 int foldHashKey(HashKey key,int numElementsPow2); // Fold key to index.
 void ttPut(SearchData &searchData,int currentPly,int depth,int alpha,int beta,int score,
-           MoveStruct move,HashKey nextKey);
-uint8_t ttGet(SearchData &searchData,int currentPly,int depth,int &score,MoveStruct &move,
-              HashKey &nextKey);
+           MoveStruct move);
+uint8_t ttGet(SearchData &searchData,int currentPly,int depth,int &score,MoveStruct &move);
+
+// Start loading the current position's bucket into the cache. Called just
+// after a move is made, so that it's (nearly) there when the next ply probes.
+inline void ttPrefetch(const Position &pos) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(&g_transpositionTable[foldHashKey(pos.currentState->key)]);
+#endif
+}
+
+// Evaluation cache functions.
+// NOTE: The cache is shared (lock free) by all search threads.
+void evalCacheAllocate(void);                     // (Re)size to config if changed.
+bool evalCacheGet(SearchData &searchData,int &score); // The current position's eval?
+void evalCachePut(SearchData &searchData,int score);
 
 // =============================================================================
 
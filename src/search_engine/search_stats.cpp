@@ -0,0 +1,213 @@
+// **************************************************************************
+// *                            SEARCH STATISTICS                           *
+// **************************************************************************
+// Each search thread counts into the SearchStats in its own SearchData (no
+// sharing, so no locks or contention), and think() adds them all up once the
+// threads have stopped. The derived figures (rates, branching factor) are
+// only worked out here when they are printed.
+
+#include "search_engine.h"
+
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+
+using namespace std;
+
+// The effective branching factor is averaged over (up to) this many of the
+// last iterations (the first few are too small to mean much).
+constexpr int EBF_ITERATIONS = 4;
+
+// =========================================================================
+
+void SearchStats::reset()
+{ // Zero everything (done at the start of each search).
+
+  *this=SearchStats();
+
+} // End SearchStats::reset.
+
+// =========================================================================
+
+SearchStats& SearchStats::operator+=(const SearchStats &other)
+{ // Add another thread's counters to these (the rest are set by think()).
+
+  nodes.add(other.nodes);
+  qsearchNodes.add(other.qsearchNodes);
+  alphaUpdates.add(other.alphaUpdates);
+  betaCutoffs.add(other.betaCutoffs);
+  moveCutoffs.add(other.moveCutoffs);
+  firstMoveCutoffs.add(other.firstMoveCutoffs);
+  nullCutoffs.add(other.nullCutoffs);
+  materialEvals.add(other.materialEvals);
+  trueEvals.add(other.trueEvals);
+  moveGens.add(other.moveGens);
+  hashProbes.add(other.hashProbes);
+  hashHits.add(other.hashHits);
+  hashPuts.add(other.hashPuts);
+  hashCollisions.add(other.hashCollisions);
+  checkExtensions.add(other.checkExtensions);
+  mateExtensions.add(other.mateExtensions);
+  pawnHashProbes.add(other.pawnHashProbes);
+  pawnHashHits.add(other.pawnHashHits);
+  evalCacheHits.add(other.evalCacheHits);
+  evalCacheMisses.add(other.evalCacheMisses);
+  for (int i=0;i<MAX_STATS_DEPTH;i++) {
+    hashProbesByDepth[i].add(other.hashProbesByDepth[i]);
+    hashHitsByDepth[i].add(other.hashHitsByDepth[i]);
+    iterationNodes[i].add(other.iterationNodes[i]);
+  }
+
+  return *this;
+
+} // End SearchStats::operator+=.
+
+// =========================================================================
+
+static double safeRatio(int64_t numerator,int64_t denominator)
+{ // numerator/denominator, or 0 if there's nothing to divide by.
+
+  return (denominator>0) ? static_cast<double>(numerator)/static_cast<double>(denominator) : 0.0;
+
+} // End safeRatio.
+
+// =========================================================================
+
+static double effectiveBranchingFactor(const SearchStats &stats)
+{ // The geometric mean of the growth in nodes from one completed iteration
+  // to the next, over the last few. Returns 0 if there are fewer than two.
+
+  const int last=min(stats.completedDepth,MAX_STATS_DEPTH-1);
+  int first=last;
+  while (first>1 && last-first<EBF_ITERATIONS && stats.iterationNodes[first-1]>0)
+    first--;
+  if (first==last || stats.iterationNodes[first]<=0)
+    return 0.0;
+
+  return pow(safeRatio(stats.iterationNodes[last],stats.iterationNodes[first]),
+             1.0/static_cast<double>(last-first));
+
+} // End effectiveBranchingFactor.
+
+// =========================================================================
+
+void printSearchStats(const SearchStats &stats,ostream &out,bool json)
+{ // Print the stats as a table, or else as a single line JSON object.
+
+  const double nps=(stats.wallSeconds>0.0) ? static_cast<double>(stats.nodes)/stats.wallSeconds : 0.0;
+  const double cpuNps=(stats.cpuSeconds>0.0) ? static_cast<double>(stats.nodes)/stats.cpuSeconds : 0.0;
+  const int maxDepth=min(stats.completedDepth,MAX_STATS_DEPTH-1);
+
+  // The deepest depth that had any hash probes.
+  int maxHashDepth=0;
+  for (int i=0;i<MAX_STATS_DEPTH;i++) {
+    if (stats.hashProbesByDepth[i]>0)
+      maxHashDepth=i;
+  }
+
+  const ios_base::fmtflags savedFlags=out.flags();
+  const streamsize savedPrecision=out.precision();
+
+  if (json) {
+    out << fixed << setprecision(6)
+        << "{\"threads\": " << stats.numThreads
+        << ", \"depth\": " << stats.completedDepth
+        << ", \"wall_seconds\": " << stats.wallSeconds
+        << ", \"cpu_seconds\": " << stats.cpuSeconds
+        << ", \"nodes\": " << stats.nodes
+        << ", \"qsearch_nodes\": " << stats.qsearchNodes
+        << ", \"nps\": " << setprecision(0) << nps << setprecision(6)
+        << ", \"qsearch_share\": " << safeRatio(stats.qsearchNodes,stats.nodes)
+        << ", \"first_move_cutoff_rate\": " << safeRatio(stats.firstMoveCutoffs,stats.moveCutoffs)
+        << ", \"effective_branching_factor\": " << effectiveBranchingFactor(stats)
+        << ", \"move_gens\": " << stats.moveGens
+        << ", \"alpha_updates\": " << stats.alphaUpdates
+        << ", \"beta_cutoffs\": " << stats.betaCutoffs
+        << ", \"move_cutoffs\": " << stats.moveCutoffs
+        << ", \"first_move_cutoffs\": " << stats.firstMoveCutoffs
+        << ", \"null_cutoffs\": " << stats.nullCutoffs
+        << ", \"material_evals\": " << stats.materialEvals
+        << ", \"true_evals\": " << stats.trueEvals
+        << ", \"hash_probes\": " << stats.hashProbes
+        << ", \"hash_hits\": " << stats.hashHits
+        << ", \"hash_hit_rate\": " << safeRatio(stats.hashHits,stats.hashProbes)
+        << ", \"hash_puts\": " << stats.hashPuts
+        << ", \"hash_collisions\": " << stats.hashCollisions
+        << ", \"hash_full\": " << stats.hashFull
+        << ", \"check_extensions\": " << stats.checkExtensions
+        << ", \"mate_extensions\": " << stats.mateExtensions
+        << ", \"pawn_hash_probes\": " << stats.pawnHashProbes
+        << ", \"pawn_hash_hits\": " << stats.pawnHashHits
+        << ", \"pawn_hash_hit_rate\": " << safeRatio(stats.pawnHashHits,stats.pawnHashProbes)
+        << ", \"eval_cache_hits\": " << stats.evalCacheHits
+        << ", \"eval_cache_misses\": " << stats.evalCacheMisses
+        << ", \"eval_cache_hit_rate\": "
+        << safeRatio(stats.evalCacheHits,stats.evalCacheHits+stats.evalCacheMisses);
+    out << ", \"iteration_nodes\": [";
+    for (int i=1;i<=maxDepth;i++)
+      out << (i>1 ? ", " : "") << stats.iterationNodes[i];
+    out << "], \"hash_hit_rate_by_depth\": [";
+    for (int i=0;i<=maxHashDepth;i++)
+      out << (i>0 ? ", " : "") << safeRatio(stats.hashHitsByDepth[i],stats.hashProbesByDepth[i]);
+    out << "]}" << endl;
+  }
+  else {
+    out << "Search Threads                  : " << stats.numThreads << endl;
+    out << "Wall Clock Time                 : " << stats.wallSeconds << " seconds" << endl;
+    out << "CPU Time                        : " << stats.cpuSeconds << " seconds" << endl;
+    out << "Total Nodes Searched            : " << stats.nodes << endl;
+    if (stats.wallSeconds>0.0)
+      out << "Nodes Per Second (wall clock)   : " << static_cast<int64_t>(nps) << endl;
+    if (stats.cpuSeconds>0.0)
+      out << "Nodes Per Second (CPU)          : " << static_cast<int64_t>(cpuNps) << endl;
+    out << fixed << setprecision(1);
+    out << "Quiescent Nodes                 : " << stats.qsearchNodes
+        << " (" << 100.0*safeRatio(stats.qsearchNodes,stats.nodes) << "%)" << endl;
+    out << "Total Move Gens                 : " << stats.moveGens << endl;
+    out << "Total Alpha Updates             : " << stats.alphaUpdates << endl;
+    out << "Total Beta Cutoffs              : " << stats.betaCutoffs << endl;
+    out << "First Move Cutoffs              : " << stats.firstMoveCutoffs << '/' << stats.moveCutoffs
+        << " (" << 100.0*safeRatio(stats.firstMoveCutoffs,stats.moveCutoffs) << "%)" << endl;
+    out << "Total Null Cutoffs              : " << stats.nullCutoffs << endl;
+    out << "Total Material Evals            : " << stats.materialEvals << endl;
+    out << "Total True Evals                : " << stats.trueEvals << endl;
+    out << "Total Hash Colisions            : " << stats.hashCollisions << endl;
+    out << "Total Put In Hash               : " << stats.hashPuts << endl;
+    out << "Total Get Hash Count            : " << stats.hashProbes << endl;
+    out << "Total Hash Successes            : " << stats.hashHits
+        << " (" << 100.0*safeRatio(stats.hashHits,stats.hashProbes) << "%)" << endl;
+    out << "Hash Full (permille)            : " << stats.hashFull << endl;
+    out << "Pawn Hash Hits                  : " << stats.pawnHashHits << '/' << stats.pawnHashProbes
+        << " (" << 100.0*safeRatio(stats.pawnHashHits,stats.pawnHashProbes) << "%)" << endl;
+    out << "Eval Cache Hits                 : " << stats.evalCacheHits << '/'
+        << stats.evalCacheHits+stats.evalCacheMisses << " ("
+        << 100.0*safeRatio(stats.evalCacheHits,stats.evalCacheHits+stats.evalCacheMisses) << "%)" << endl;
+    out << "Total Check Extentions          : " << stats.checkExtensions << endl;
+    out << "Total Mate Extentions           : " << stats.mateExtensions << endl;
+    out << setprecision(2);
+    out << "Effective Branching Factor      : " << effectiveBranchingFactor(stats) << endl;
+
+    // Per depth: the nodes to complete each iteration (all threads), and the
+    // hash hit rate by remaining depth (0 = quiescent search).
+    out << "Depth | Iteration Nodes | Hash Hit %" << endl;
+    for (int i=0;i<=max(maxDepth,maxHashDepth);i++) {
+      out << setw(5) << i << " | ";
+      if (i>0 && i<=maxDepth)
+        out << setw(15) << stats.iterationNodes[i];
+      else
+        out << setw(15) << '-';
+      out << " | ";
+      if (stats.hashProbesByDepth[i]>0)
+        out << setw(10) << setprecision(1) << 100.0*safeRatio(stats.hashHitsByDepth[i],stats.hashProbesByDepth[i]);
+      else
+        out << setw(10) << '-';
+      out << endl;
+    }
+  }
+
+  out.flags(savedFlags);
+  out.precision(savedPrecision);
+
+} // End printSearchStats.
+
+// =========================================================================
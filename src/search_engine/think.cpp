@@ -6,12 +6,201 @@
 #include "../interface/interface.h"
 #include <algorithm>
 #include <limits>
+#include <memory>
+#include <thread>
 
 using namespace std;
 
+// Set by newGame() so that think() clears the search data before its next
+// search (the search data lives inside think()).
+static bool newGamePending=true;
+
+// Lazy-SMP: Each helper thread gets its own search data (and position).
+static vector<unique_ptr<SearchData>> helperData;
+
+// The stats of the last think() (all threads), see getLastSearchStats().
+static SearchStats lastSearchStats;
+
 // ==========================================================================
 
-MoveStruct think(int searchDepth,double maxTimeSeconds,bool showOutput,
+void newGame(void)
+{ // Forget everything learnt while searching the last game: The hash table
+  // and each search thread's killers, hash moves, history and windows.
+  // NOTE: Between the moves of a game these are all kept, which gets to the
+  //       same depth quicker on the 2nd and later moves.
+
+  ttClear();
+  newGamePending=true;
+
+} // End newGame.
+
+// ==========================================================================
+
+static void initRootMaterial(SearchData &sd)
+{ // Set up the ply 0 positional window and running material from the root
+  // state of the search data's own position.
+
+  const Position &pos=sd.pos;
+
+  // Set up the the max positional value for ply 0 from a call to Eval().
+  sd.minPositionEval[0]=sd.maxPositionEval[0]=sd.evalParams.eval(pos);
+
+  // And the running piece-square sums (see updateRunningEvaluation()).
+  sd.evalParams.initPieceSquareSums(pos,sd.pieceSquareSums[0]);
+
+  // Set up the material evaluations for this state.
+  sd.pieceMatValue[0][WHITE]=0;
+  sd.pieceMatValue[0][BLACK]=0;
+  sd.pawnMatValue[0][WHITE]=0;
+  sd.pawnMatValue[0][BLACK]=0;
+  for (int i=0;i<64;i++) {
+
+    // Don't bother if theres no piece on the square.
+    if (pos.currentPiece[i]==NONE)
+      continue;
+
+    // See if it's a pawn or a piece.
+    if (pos.currentPiece[i]==PAWN)
+      sd.pawnMatValue[0][pos.currentColour[i]]+=PIECE_VALUE[PAWN];
+    else
+      sd.pieceMatValue[0][pos.currentColour[i]]+=PIECE_VALUE[pos.currentPiece[i]];
+
+  }
+
+} // End initRootMaterial.
+
+// ==========================================================================
+
+static int countRootMoves(Position &pos)
+{ // The number of legal moves at the root (for the time manager).
+
+  MoveList moves;
+  genLegalMoves(pos,moves);
+  return moves.numMoves;
+
+} // End countRootMoves.
+
+// ==========================================================================
+
+static void helperThink(SearchData &sd,int helperNum)
+{ // Lazy-SMP helper thread: Searches the same root as think() on its own copy
+  // of the position, only sharing results through the transposition table.
+  // NOTE: Runs until think() sets the stop flag, and never prints anything.
+  // NOTE: Every other helper starts a ply deeper, so that the threads don't
+  //       all search the same depth at the same time.
+
+  int lastScore=0;
+
+  // Set up the root as per think().
+  initRootMaterial(sd);
+  sd.rootAlpha=-WIN_SCORE;
+  sd.rootBeta=WIN_SCORE;
+
+  // Run for each iteration until told to stop (capped to fit the ply arrays).
+  for (sd.iterDepth=1+(helperNum&1);
+       sd.iterDepth<static_cast<int>(g_searchConfig.maxQuiesceDepth/2);
+       sd.iterDepth++) {
+
+    // Aspiration search.
+    for (;;) {
+      lastScore=search(sd,0,sd.rootAlpha,sd.rootBeta,sd.iterDepth,false);
+      if (shouldTimeOut(sd)==true)
+        return;
+      if (lastScore<=sd.rootAlpha)
+        sd.rootAlpha=-WIN_SCORE;                 // Fail low.
+      else if (lastScore>=sd.rootBeta)
+        sd.rootBeta=WIN_SCORE;                   // Fail high.
+      else
+        break;
+    }
+
+    // Reset the aspiration window.
+    sd.rootAlpha=lastScore-static_cast<int>(ASPIRATION_WINDOW*static_cast<double>(PIECE_VALUE[PAWN]));
+    sd.rootBeta=lastScore+static_cast<int>(ASPIRATION_WINDOW*static_cast<double>(PIECE_VALUE[PAWN]));
+
+  }
+
+} // End helperThink.
+
+// ==========================================================================
+
+void checkTime(SearchData &sd)
+{ // Called by shouldTimeOut() every timeCheckInterval nodes: Reads the clock,
+  // and sets the interval so the next read is about TIME_CHECK_SECONDS on.
+  // NOTE: Without a time limit the clock is never read again.
+
+  if (sd.stopTime==std::numeric_limits<ClockTime>::max()) {
+    sd.nextTimeCheck=std::numeric_limits<int64_t>::max();
+    return;
+  }
+
+  const ClockTime now=getTime();
+  if (now>=sd.stopTime)
+    sd.timedOut=true;
+
+  // Recalibrate from the nodes/second since the last read.
+  const int64_t nodes=sd.stats.nodes;
+  if (now>sd.lastCheckTime) {
+    const double nodesPerSecond=static_cast<double>(nodes-sd.lastCheckNodes)
+                                /timeDiffToSeconds(sd.lastCheckTime,now);
+    sd.timeCheckInterval=std::clamp(static_cast<int64_t>(nodesPerSecond*TIME_CHECK_SECONDS),
+                                    TIME_CHECK_MIN_NODES,TIME_CHECK_MAX_NODES);
+  }
+  sd.lastCheckNodes=nodes;
+  sd.lastCheckTime=now;
+  sd.nextTimeCheck=nodes+sd.timeCheckInterval;
+
+} // End checkTime.
+
+// ==========================================================================
+
+int64_t getTotalNodes(const SearchData &sd)
+{ // The nodes searched by think()'s search data plus all of the helpers'.
+  // NOTE: Only approximate while the helpers are still searching.
+
+  int64_t totalNodes=sd.stats.nodes;
+  for (const auto &helper : helperData)
+    totalNodes+=helper->stats.nodes;
+  return totalNodes;
+
+} // End getTotalNodes.
+
+// ==========================================================================
+
+int64_t getLastSearchNodes(void)
+{ // The nodes searched by the last think() call, summed over all threads.
+
+  return lastSearchStats.nodes;
+
+} // End getLastSearchNodes.
+
+// ==========================================================================
+
+const SearchStats& getLastSearchStats(void)
+{ // The stats of the last think() call, summed over all threads.
+
+  return lastSearchStats;
+
+} // End getLastSearchStats.
+
+// ==========================================================================
+
+MoveStruct think(const Position &pos,int searchDepth,double maxTimeSeconds,bool showOutput,
+                 bool showThinking,double randomSwing,const EvaluationParameters &evalParams)
+{ // Search to a fixed depth, or else for maxTimeSeconds (see below).
+
+  SearchLimits limits;
+  if (searchDepth==static_cast<int>(INFINITE_DEPTH))
+    limits.timeSeconds=maxTimeSeconds;
+  else
+    limits.depth=searchDepth;
+  return think(pos,limits,showOutput,showThinking,randomSwing,evalParams);
+
+} // End think.
+
+// ==========================================================================
+
+MoveStruct think(const Position &pos,const SearchLimits &limits,bool showOutput,
                  bool showThinking,double randomSwing,const EvaluationParameters &evalParams)
 { // This function calls search() iteratively and prints the thinking results
   // after every iteration (if asked to show thinking).
@@ -28,11 +217,30 @@ MoveStruct think(int searchDepth,double maxTimeSeconds,bool showOutput,
   // This is the data type that holds everything used while searching!
   // This is done to make it so only one extra parameter need be pass to
   // the Search() functions.
-  static SearchData sd;
+  static SearchData sd(g_searchConfig);
+
+  // Lazy-SMP: The helper threads (their search data is kept between calls).
+  vector<thread> helperThreads;
+  atomic<bool> stopHelpers{false};
   
-  // Initialize SearchData vectors based on current configuration.
-  // Note: sd is static to reuse allocated memory across searches.
-  sd.reset();
+  // Only clear the search data for a new game, else just reset the stats.
+  // Note: sd is static to reuse allocated memory (and results) across searches.
+  const bool clearSearchData=newGamePending;
+  newGamePending=false;
+  if (clearSearchData)
+    sd.reset(g_searchConfig);
+  else if (sd.pawnTable.getSizeMB()!=g_searchConfig.pawnHashSizeMB)
+    sd.pawnTable.resize(g_searchConfig.pawnHashSizeMB);  // Changed by the GUI.
+  sd.newSearch(pos.moveNum);
+
+  // Start a new generation in the (shared) transposition table.
+  // NOTE: The table is only cleared for a new game (see newGame()), so the
+  //       entries from the previous moves' searches stay useful.
+  ttAllocate();
+  ttNewSearch();
+
+  // Search on our own copy of the position (so the caller's is untouched).
+  sd.pos.copyFrom(pos);
 
   // Copy it in to the Search Data.
   //memcpy(&sd.evalParams,&evalParams,sizeof(sd.evalParams)); // BAD FOR NN (=MEM LEAK *BUGS*)!
@@ -41,25 +249,35 @@ MoveStruct think(int searchDepth,double maxTimeSeconds,bool showOutput,
   // 2003_v7: Mutate the eval set.
   sd.evalParams.mutate(randomSwing);
 
+  // The eval cache only matches entries from this (mutated) set.
+  evalCacheAllocate();
+  sd.evalWeightsKey=sd.evalParams.getWeightsKey();
+
+  // Print thinking either as the table, or as UCI info lines.
+  const bool printThinking=(showOutput && showThinking) || limits.uciOutput;
+  sd.uciOutput=limits.uciOutput;
+
   // Set the starting time of the search (for thinking info!).
   // NOTE: Do after clearing the big tables/lists/hash ect as their slow...
-  if (showOutput==true && showThinking==true) {
+  // NOTE: The wall clock and CPU times are always taken for the stats.
+  if (printThinking)
     sd.startTime=getTime();
-    sd.wallClockStart=getWallClockTime();
-    sd.cpuStart=getCPUTime();
-  }
-  else {
+  else
     sd.startTime=0;                                  // For search to see.
-    sd.wallClockStart=0.0;
-    sd.cpuStart=0.0;
-  }
+  sd.wallClockStart=getWallClockTime();
+  sd.cpuStart=getCPUTime();
 
   // Save the stopping time (in processor clock cycles).
-  if (searchDepth==static_cast<int>(INFINITE_DEPTH))
+  if (limits.timeSeconds!=INFINITE_TIME)
     sd.stopTime=getTime()
-                +(static_cast<ClockTime>(maxTimeSeconds*getClocksPerSecond()));
+                +(static_cast<ClockTime>(limits.timeSeconds*getClocksPerSecond()));
   else
     sd.stopTime=std::numeric_limits<ClockTime>::max();  // Don't stop search on time limit!
+  sd.lastCheckTime=getTime();
+
+  // The caller can also stop us, or limit the nodes searched.
+  sd.stopSearch=limits.stop;
+  sd.nodeLimit=limits.nodes;
 
   // Print thinking table's header.
   if (showOutput)
@@ -74,34 +292,40 @@ MoveStruct think(int searchDepth,double maxTimeSeconds,bool showOutput,
   }
 
 
-  // Set up the the max positional value for ply 0 from a call to Eval().
-  sd.minPositionEval[0]=sd.maxPositionEval[0]=sd.evalParams.eval();
-
-  // Set up the material evaluations for this state.
-  sd.pieceMatValue[0][WHITE]=0;
-  sd.pieceMatValue[0][BLACK]=0;
-  sd.pawnMatValue[0][WHITE]=0;
-  sd.pawnMatValue[0][BLACK]=0;
-  for (int i=0;i<64;i++) {
-
-    // Don't bother if theres no piece on the square.
-    if (g_currentPiece[i]==NONE)
-      continue;
-
-    // See if it's a pawn or a piece.
-    if (g_currentPiece[i]==PAWN)
-      sd.pawnMatValue[0][g_currentColour[i]]+=PIECE_VALUE[PAWN];
-    else
-      sd.pieceMatValue[0][g_currentColour[i]]+=PIECE_VALUE[g_currentPiece[i]];
-
+  // Set up the positional window and material evaluations for this state.
+  initRootMaterial(sd);
+
+  // Start the helper threads (they stop when we set the flag below).
+  helperData.resize(g_searchConfig.numThreads-1);
+  for (size_t i=0;i<helperData.size();i++) {
+    if (!helperData[i])
+      helperData[i]=make_unique<SearchData>(g_searchConfig);
+    else if (clearSearchData)
+      helperData[i]->reset(g_searchConfig);
+    else if (helperData[i]->pawnTable.getSizeMB()!=g_searchConfig.pawnHashSizeMB)
+      helperData[i]->pawnTable.resize(g_searchConfig.pawnHashSizeMB);
+    helperData[i]->newSearch(pos.moveNum);
+    helperData[i]->evalParams=sd.evalParams;         // Same (mutated) set.
+    helperData[i]->evalWeightsKey=sd.evalWeightsKey;
+    helperData[i]->stopTime=std::numeric_limits<ClockTime>::max();
+    helperData[i]->stopSearch=&stopHelpers;
+    helperData[i]->pos.copyFrom(pos);
+    helperThreads.emplace_back(helperThink,std::ref(*helperData[i]),static_cast<int>(i));
   }
 
   // Init first level (ie: Depth=1) to full width window.
   sd.rootAlpha=-WIN_SCORE;
   sd.rootBeta=WIN_SCORE;
 
+  // When playing on a clock, the time manager decides when to stop.
+  TimeManager timeManager;
+  timeManager.start(limits,countRootMoves(sd.pos));
+
   // Run for each iteration, going deeper each time.
+  int64_t iterationStartNodes=0,threadStartNodes=0;
+  bool outOfTime=false;
   for (sd.iterDepth=1;;sd.iterDepth++) {
+    bool iterationDone=false;
 
     // Aspiration search.
     // NOTE: The move's score it returned in ComputersMove.Score, as we may get
@@ -111,8 +335,9 @@ MoveStruct think(int searchDepth,double maxTimeSeconds,bool showOutput,
       // Do the search with a reduced window.
       lastScore=search(sd,0,sd.rootAlpha,sd.rootBeta,sd.iterDepth,false);
 
-      // Break if thime is up.
-      if (shouldTimeOut(sd)==true)
+      // Break if the search was cut short (only the search sets timedOut, so
+      // a search that finished before the time ran out still counts).
+      if (sd.timedOut)
         break;
 
       // See if we failed low/high.
@@ -120,7 +345,13 @@ MoveStruct think(int searchDepth,double maxTimeSeconds,bool showOutput,
         sd.rootAlpha=-WIN_SCORE;                 // Fail low.
       else if (lastScore>=sd.rootBeta)
         sd.rootBeta=WIN_SCORE;                   // Fail high.
-      else
+      else {
+        iterationDone=true;
+        break;
+      }
+
+      // Break if thime is up (before searching again with the wider window).
+      if (shouldTimeOut(sd)==true)
         break;
 
     }
@@ -129,62 +360,72 @@ MoveStruct think(int searchDepth,double maxTimeSeconds,bool showOutput,
     sd.rootAlpha=lastScore-static_cast<int>(ASPIRATION_WINDOW*static_cast<double>(PIECE_VALUE[PAWN]));
     sd.rootBeta=lastScore+static_cast<int>(ASPIRATION_WINDOW*static_cast<double>(PIECE_VALUE[PAWN]));
 
+    // The nodes (all threads) it took to complete this iteration, and if
+    // the time manager thinks another is worth starting.
+    if (iterationDone) {
+      const int64_t totalNodes=getTotalNodes(sd);
+      sd.stats.iterationNodes[min(sd.iterDepth,MAX_STATS_DEPTH-1)].set(totalNodes-iterationStartNodes);
+      sd.stats.completedDepth=sd.iterDepth;
+      iterationStartNodes=totalNodes;
+      outOfTime=timeManager.stopAfterIteration(sd,sd.stats.nodes-threadStartNodes);
+      threadStartNodes=sd.stats.nodes;
+    }
+
     // Print the move chosen (different for partialy searched ply, but usable!).
-    if (showThinking && showOutput) {
-      if (shouldTimeOut(sd)==true)
+    if (printThinking) {
+      if (!iterationDone)
         printLine(sd,sd.computersMove,sd.computersMoveScore,'%');
       else
         printLine(sd,sd.computersMove,sd.computersMoveScore,'.');
     }
 
+    // Read the clock now rather than at the next poll, so as not to start
+    // another iteration once out of time.
+    // NOTE: Only once the finished iteration has been recorded above.
+    if (sd.iterDepth>2 && !sd.timedOut)
+      checkTime(sd);
+
     // Break time is up/depth is reached or definite forced mate.
     // Note: No MAX_SEARCH_DevalParamsTH limit - search continues until depth/time/mate.
-    if ((sd.iterDepth==searchDepth && maxTimeSeconds==INFINITE_TIME)
-        || shouldTimeOut(sd)==true
-        || isMateScore(sd.computersMoveScore)) {
+    // NOTE: An infinite search only stops when told (or the ply arrays run out).
+    if (shouldTimeOut(sd)==true || outOfTime
+        || sd.iterDepth>=static_cast<int>(g_searchConfig.maxQuiesceDepth/2)) {
+      break;
+    }
+    if (!limits.infinite
+        && (sd.iterDepth==limits.depth || isMateScore(sd.computersMoveScore))) {
       break;
     }
 
   }
 
+  // Stop the helper threads and wait for them.
+  stopHelpers=true;
+  for (auto &helperThread : helperThreads)
+    helperThread.join();
+
+  // Add up the stats from all the threads (the pawn tables count their own).
+  sd.stats.pawnHashProbes.set(sd.pawnTable.probes);
+  sd.stats.pawnHashHits.set(sd.pawnTable.hits);
+  lastSearchStats=sd.stats;
+  for (const auto &helper : helperData) {
+    helper->stats.pawnHashProbes.set(helper->pawnTable.probes);
+    helper->stats.pawnHashHits.set(helper->pawnTable.hits);
+    lastSearchStats+=helper->stats;
+  }
+  lastSearchStats.completedDepth=sd.stats.completedDepth;
+  lastSearchStats.numThreads=static_cast<int>(g_searchConfig.numThreads);
+  lastSearchStats.wallSeconds=getWallClockTime()-sd.wallClockStart;
+  lastSearchStats.cpuSeconds=getCPUTime()-sd.cpuStart;
+  lastSearchStats.hashFull=ttHashFull();
+
   // Print rest of the info.
   if (showThinking && showOutput) {
     cout << "=================================================================="
          << endl;
 
-    // Print stats - both wall clock and CPU time for comparison.
-    double wallClockElapsed = getWallClockTime() - sd.wallClockStart;
-    double cpuElapsed = getCPUTime() - sd.cpuStart;
-    cout << "Wall Clock Time                 : " << wallClockElapsed << " seconds" << endl;
-    cout << "CPU Time                        : " << cpuElapsed << " seconds" << endl;
-    cout << "Total Nodes Searched            : " << sd.totalNodesSearched << endl;
-    if (wallClockElapsed > 0.0) {
-      cout << "Nodes Per Second (wall clock)   : " 
-           << (int)((double)sd.totalNodesSearched / wallClockElapsed)
-           << endl;
-    }
-    if (cpuElapsed > 0.0) {
-      cout << "Nodes Per Second (CPU)          : " 
-           << (int)((double)sd.totalNodesSearched / cpuElapsed)
-           << endl;
-    }
-    cout << "Total Move Gens                 : " << sd.totalMoveGens << endl;
-    cout << "Total Alpha Updates             : " << sd.numAlphaCutOffs << endl;
-    cout << "Total Beta Cutoffs              : " << sd.numBetaCutOffs << endl;
-    cout << "Total Null Cutoffs              : " << sd.numNullCutOffs << endl;
-    cout << "Total Material Evals            : " << sd.numMaterialEvals << endl;
-    cout << "Total True Evals                : " << sd.numTrueEvals << endl;
-    cout << "Total Hash Colisions            : " << sd.numHashCollisions 
-                                                 << endl;
-    cout << "Total Put In Hash               : " << sd.totalPutHashCount 
-                                                 << endl;
-    cout << "Total Get Hash Count            : " << sd.totalGetHashCount 
-                                                 << endl;
-    cout << "Total Hash Successes            : " << sd.numHashSuccesses << endl;
-    cout << "Total Check Extentions          : " << sd.numCheckExtensions 
-                                                 << endl;
-    cout << "Total Mate Extentions           : " << sd.numMateExtensions 
-                                                 << endl;
+    // Print stats.
+    printSearchStats(lastSearchStats,cout,false);
 
     // Find the Max positional difference for any ply of search.
     sd.maxPositionalDiff=0;
@@ -219,9 +460,9 @@ MoveStruct think(int searchDepth,double maxTimeSeconds,bool showOutput,
     //            force mate in 0 moves mean? - Rubish, N will force mate in 1
     //            move - ie: The move we have chosen, will mate after the move! 
     if (isMateScore(sd.computersMoveScore)) {
-      if ((g_currentSide==WHITE 
+      if ((pos.currentSide==WHITE 
            && ((WIN_SCORE-1)-labs(sd.computersMoveScore))%2==1)
-          || (g_currentSide==BLACK 
+          || (pos.currentSide==BLACK 
               && ((WIN_SCORE-1)-labs(sd.computersMoveScore))%2==0)) {
         cout << endl << "Black will force mate in " 
              << (WIN_SCORE)-labs(sd.computersMoveScore) 
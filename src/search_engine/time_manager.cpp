@@ -0,0 +1,122 @@
+// **************************************************************************
+// *                              TIME MANAGEMENT                           *
+// **************************************************************************
+// When playing on a clock, each move gets a soft and a hard time limit. The
+// search is only cut off at the hard limit; between iterations think() asks
+// the TimeManager if it is worth going on, which scales the soft limit by how
+// settled the search looks. So easy moves save time for the hard ones.
+// NOTE: A fixed time per move (eg: "go movetime", ChessTest and PlayChess's
+//       -t) has no soft limit, and always uses all of it.
+
+#include "search_engine.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+// The growth in nodes from one iteration to the next is assumed to be this
+// if it can't be measured yet (and is kept within these bounds).
+constexpr double DEFAULT_BRANCHING_FACTOR = 2.0;
+constexpr double MIN_BRANCHING_FACTOR = 1.5;
+constexpr double MAX_BRANCHING_FACTOR = 8.0;
+
+// =========================================================================
+
+TimeBudget allocateTime(int64_t timeLeftMs,int64_t incrementMs,int movesToGo,int64_t moveOverheadMs)
+{ // Share out the clock: The soft limit is an equal part of what's left plus
+  // most of the increment (but never more than half what's left), and the
+  // hard limit a few times that (but never more than 3/4 of what's left).
+  // The move overhead is held back from both for the GUI's lag.
+
+  if (movesToGo<=0)
+    movesToGo=TM_DEFAULT_MOVES_TO_GO;
+  const double timeLeft=static_cast<double>(timeLeftMs);
+  double soft=timeLeft/movesToGo+TM_INCREMENT_SHARE*static_cast<double>(incrementMs);
+  soft=min(soft,TM_MAX_SOFT_SHARE*timeLeft);
+  double hard=min(TM_HARD_RATIO*soft,TM_MAX_HARD_SHARE*timeLeft);
+
+  soft=max((soft-moveOverheadMs)/1000.0,MIN_SEARCH_SECONDS);
+  hard=max((hard-moveOverheadMs)/1000.0,soft);
+  return TimeBudget{soft,hard};
+
+} // End allocateTime.
+
+// =========================================================================
+
+void TimeManager::start(const SearchLimits &limits,int numRootMoves)
+{ // Called by think() before the first iteration.
+
+  active=(limits.softTimeSeconds!=INFINITE_TIME && !limits.infinite);
+  softSeconds=limits.softTimeSeconds;
+  hardSeconds=limits.timeSeconds;
+  this->numRootMoves=numRootMoves;
+  startTime=iterationStart=getTime();
+  lastBestMove=MoveStruct{-1,-1,0,0};
+  lastScore=0;
+  stableIterations=0;
+
+} // End TimeManager::start.
+
+// =========================================================================
+
+bool TimeManager::stopAfterIteration(const SearchData &sd,int64_t threadNodes)
+{ // Called by think() after each completed iteration, with the nodes its own
+  // search data took for it. Returns true if it isn't worth starting another.
+
+  const ClockTime now=getTime();
+  const double elapsed=timeDiffToSeconds(startTime,now);
+  const double iterationSeconds=timeDiffToSeconds(iterationStart,now);
+  iterationStart=now;
+
+  // Is it the same best move as last iteration?
+  const bool sameMove=(sd.computersMove.source==lastBestMove.source
+                       && sd.computersMove.target==lastBestMove.target
+                       && sd.computersMove.promote==lastBestMove.promote);
+  const bool firstIteration=(lastBestMove.source<0);
+  stableIterations=sameMove ? stableIterations+1 : 0;
+  const int scoreDrop=firstIteration ? 0 : lastScore-sd.computersMoveScore;
+  lastBestMove=sd.computersMove;
+  lastScore=sd.computersMoveScore;
+
+  if (!active)
+    return false;
+
+  // Nothing to think about.
+  if (numRootMoves==1)
+    return true;
+
+  // Scale the soft limit: Up if the best move only just changed, and down
+  // the longer it has stayed the same.
+  double scale;
+  if (!sameMove && !firstIteration)
+    scale=TM_CHANGED_FACTOR;
+  else
+    scale=max(1.0+TM_STABLE_STEP-TM_STABLE_STEP*stableIterations,TM_MIN_STABLE_FACTOR);
+
+  // Up if the score dropped (by up to TM_MAX_DROP_FACTOR).
+  if (scoreDrop>0 && !isMateScore(sd.computersMoveScore)) {
+    const double dropPawns=static_cast<double>(scoreDrop)/static_cast<double>(PIECE_VALUE[PAWN]);
+    scale*=1.0+(TM_MAX_DROP_FACTOR-1.0)*min(dropPawns/TM_SCORE_DROP_PAWNS,1.0);
+  }
+
+  // Down if (nearly) all of the iteration's effort went on the best move.
+  if (threadNodes>0
+      && static_cast<double>(sd.computersMoveNodes)>=TM_DOMINANT_SHARE*static_cast<double>(threadNodes))
+    scale*=TM_DOMINANT_FACTOR;
+
+  if (elapsed>=min(softSeconds*scale,hardSeconds))
+    return true;
+
+  // Don't start an iteration we don't expect to finish in time.
+  double branchingFactor=DEFAULT_BRANCHING_FACTOR;
+  const int depth=min(sd.iterDepth,MAX_STATS_DEPTH-1);
+  if (depth>1 && sd.stats.iterationNodes[depth-1]>0)
+    branchingFactor=clamp(static_cast<double>(sd.stats.iterationNodes[depth])
+                          /static_cast<double>(sd.stats.iterationNodes[depth-1]),
+                          MIN_BRANCHING_FACTOR,MAX_BRANCHING_FACTOR);
+  return (elapsed+iterationSeconds*branchingFactor>hardSeconds);
+
+} // End TimeManager::stopAfterIteration.
+
+// =========================================================================
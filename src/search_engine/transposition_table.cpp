@@ -4,6 +4,252 @@
 
 #include "search_engine.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// The one transposition table, shared by all of the search threads.
+TTBucket* g_transpositionTable=nullptr;
+static size_t ttNumBuckets=0;
+static void *ttMappedMemory=nullptr;   // What mmap() gave us, for munmap().
+static size_t ttMappedBytes=0;
+
+// Huge pages are 2MB on x86-64 (the table is mapped in multiples of this).
+constexpr size_t TT_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// For mbind() (see <numaif.h>, which needs libnuma installed to get).
+constexpr int TT_MPOL_INTERLEAVE = 3;
+
+// The generation (age) of the current search, kept in the top 5 bits of
+// TTEntry::genBound (the low 3 bits hold the bound flags).
+constexpr uint8_t TT_BOUND_MASK = 0x07;
+constexpr uint8_t TT_GENERATION_STEP = 0x08;
+constexpr uint8_t TT_GENERATION_MASK = 0xF8;
+static uint8_t ttGeneration=0;
+
+// ==========================================================================
+
+static inline uint32_t ttEntryCheck(const TTEntry &entry)
+{ // Mix the data fields of an entry into 32 bits.
+  // NOTE: The key is stored XORed with this, so an entry that was torn by two
+  //       threads writing at once fails the key test instead of returning a
+  //       move/score from another position.
+
+  return static_cast<uint32_t>(entry.move)
+         ^(static_cast<uint32_t>(entry.depth)<<16)
+         ^(static_cast<uint32_t>(entry.genBound)<<24)
+         ^static_cast<uint32_t>(entry.score);
+
+} // End ttEntryCheck.
+
+// ==========================================================================
+
+static inline uint16_t packMove(const MoveStruct &move)
+{ // Pack a move into 16 bits: source, target, promotion and a "valid" bit.
+  // NOTE: The type flags are not stored, see unpackMove().
+
+  if (move.source==NONE)
+    return 0;
+  return static_cast<uint16_t>(0x8000|move.source|(move.target<<6)|(move.promote<<12));
+
+} // End packMove.
+
+// ==========================================================================
+
+static MoveStruct unpackMove(const Position &pos,uint16_t packed)
+{ // Unpack a move, working the type flags back out from the position (so it
+  // compares equal to the one from genMoves()).
+  // NOTE: On a (partial) key collision this can be nonsense, but the hash
+  //       move is only ever used after matching it to a generated move.
+
+  MoveStruct move;
+
+  if (!(packed&0x8000))
+    return MoveStruct{NONE, NONE, NORMAL_MOVE, NO_PROMOTION};
+
+  move.source=packed&63;
+  move.target=(packed>>6)&63;
+  move.promote=(packed>>12)&7;
+  move.type=NORMAL_MOVE;
+
+  if (pos.currentColour[move.target]==getOtherSide(pos.currentSide))
+    move.type|=CAPTURE;
+  if (pos.currentPiece[move.source]==PAWN) {
+    move.type|=PAWN_MOVE;
+    if (move.target==pos.currentState->enPass && getFile(move.source)!=getFile(move.target))
+      move.type|=EN_PASSANT|CAPTURE;
+    if (abs(move.target-move.source)==16)
+      move.type|=TWO_SQUARES;
+    if (move.promote!=NO_PROMOTION)
+      move.type|=PROMOTION;
+  }
+  else if (pos.currentPiece[move.source]==KING && abs(move.target-move.source)==2) {
+    move.type|=CASTLE;
+  }
+
+  return move;
+
+} // End unpackMove.
+
+// ==========================================================================
+
+static void ttFree(void)
+{ // Give the table's memory back.
+
+  if (g_transpositionTable!=nullptr) {
+#ifdef __linux__
+    munmap(ttMappedMemory,ttMappedBytes);
+#else
+    std::free(g_transpositionTable);
+#endif
+  }
+  g_transpositionTable=nullptr;
+  ttNumBuckets=0;
+  ttMappedMemory=nullptr;
+  ttMappedBytes=0;
+
+} // End ttFree.
+
+// ==========================================================================
+
+static void ttZero(void)
+{ // Zero the whole table, splitting it between the search threads as for a
+  // big table it takes a while on one.
+  // NOTE: This also faults in a new table's pages, spread over the threads
+  //       (and so their NUMA nodes), rather than one by one during a search.
+
+  const size_t numThreads=std::max<size_t>(1,g_searchConfig.numThreads);
+  const size_t chunkSize=(ttNumBuckets+numThreads-1)/numThreads;
+  std::vector<std::thread> clearThreads;
+
+  for (size_t i=0;i<numThreads;i++) {
+    const size_t start=i*chunkSize;
+    const size_t end=std::min(ttNumBuckets,start+chunkSize);
+    if (start>=end)
+      break;
+    clearThreads.emplace_back([start,end]() {
+      std::memset(static_cast<void*>(g_transpositionTable+start),0,(end-start)*sizeof(TTBucket));
+    });
+  }
+  for (auto &clearThread : clearThreads)
+    clearThread.join();
+
+} // End ttZero.
+
+// ==========================================================================
+
+bool ttAllocate(void)
+{ // (Re)allocate the table if the configured size has changed.
+  // Returns true if a new (empty) table was allocated.
+  // NOTE: On Linux the table is mmap()ed and we ask for transparent huge
+  //       pages (fewer TLB misses on probes) and, if configured, to interleave
+  //       the pages across the NUMA nodes. Neither is fatal if the kernel says
+  //       no. The pages are touched here, as faulting in a huge page can stall
+  //       for a long time (the kernel may compact memory to find one), which
+  //       we don't want to happen on the clock.
+
+  if (g_transpositionTable!=nullptr && ttNumBuckets==g_searchConfig.numHashSlots)
+    return false;
+
+  ttFree();
+
+  const size_t numBytes=g_searchConfig.numHashSlots*sizeof(TTBucket);
+
+#ifdef __linux__
+  // mmap() only promises 4KB alignment, so map an extra huge page and start
+  // the table at the first 2MB boundary (or the kernel can't back it with
+  // huge pages from the start).
+  const size_t tableBytes=((numBytes+TT_HUGE_PAGE_SIZE-1)/TT_HUGE_PAGE_SIZE)*TT_HUGE_PAGE_SIZE;
+  const size_t mappedBytes=tableBytes+TT_HUGE_PAGE_SIZE;
+  void *mappedMemory=mmap(nullptr,mappedBytes,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  if (mappedMemory==MAP_FAILED)
+    FATAL_ERROR("Failed to allocate hash table ("+std::to_string(mappedBytes)+" bytes)");
+  const uintptr_t alignedAddress=(reinterpret_cast<uintptr_t>(mappedMemory)+TT_HUGE_PAGE_SIZE-1)
+                                 &~static_cast<uintptr_t>(TT_HUGE_PAGE_SIZE-1);
+  void *memory=reinterpret_cast<void*>(alignedAddress);
+#ifdef MADV_HUGEPAGE
+  madvise(memory,tableBytes,MADV_HUGEPAGE);     // Just 4KB pages if this fails.
+#endif
+  if (g_searchConfig.numaInterleave) {
+#ifdef SYS_mbind
+    // All nodes: the kernel masks this down to the ones we are allowed.
+    const unsigned long nodeMask=~0UL;
+    if (syscall(SYS_mbind,memory,tableBytes,TT_MPOL_INTERLEAVE,&nodeMask,
+                sizeof(nodeMask)*8,0)!=0)
+      LOG_WARNING("Could not interleave the hash table across NUMA nodes.");
+#else
+    LOG_WARNING("NUMA interleaving is not supported on this system.");
+#endif
+  }
+  ttMappedMemory=mappedMemory;
+  ttMappedBytes=mappedBytes;
+#else
+  void *memory=std::aligned_alloc(sizeof(TTBucket),numBytes);
+  if (memory==nullptr)
+    FATAL_ERROR("Failed to allocate hash table ("+std::to_string(numBytes)+" bytes)");
+#endif
+
+  g_transpositionTable=static_cast<TTBucket*>(memory);
+  ttNumBuckets=g_searchConfig.numHashSlots;
+  ttZero();
+  ttGeneration=0;
+  return true;
+
+} // End ttAllocate.
+
+// ==========================================================================
+
+void ttClear(void)
+{ // Empty the table for a new game, (re)allocating it first if the configured
+  // size changed.
+
+  if (!ttAllocate())
+    ttZero();
+  ttGeneration=0;
+
+} // End ttClear.
+
+// ==========================================================================
+
+void ttNewSearch(void)
+{ // Start a new generation, so entries from older searches are replaced first.
+
+  ttGeneration+=TT_GENERATION_STEP;
+
+} // End ttNewSearch.
+
+// ==========================================================================
+
+int ttHashFull(void)
+{ // How full the table is (in permille), sampling the first 1000 buckets for
+  // entries written by the current search.
+
+  const size_t numSamples=std::min<size_t>(1000,ttNumBuckets);
+  int numUsed=0;
+
+  for (size_t i=0;i<numSamples;i++) {
+    for (const TTEntry &entry : g_transpositionTable[i].entries) {
+      if ((entry.genBound&TT_BOUND_MASK)!=0
+          && (entry.genBound&TT_GENERATION_MASK)==ttGeneration)
+        numUsed++;
+    }
+  }
+
+  return numSamples==0 ? 0 : static_cast<int>((numUsed*1000)/(numSamples*TT_BUCKET_ENTRIES));
+
+} // End ttHashFull.
+
 // ==========================================================================
 
 int foldHashKey(HashKey key,int numElementsPow2)
@@ -31,96 +277,117 @@ int foldHashKey(HashKey key,int numElementsPow2)
 // ============================================================================
 
 void ttPut(SearchData &searchData,int currentPly,int depth,int alpha,int beta,int score,
-           MoveStruct move,HashKey nextKey)
+           MoveStruct move)
 {  // Put the current state (ie 64bit identifier key!) in the hash table.
+   // Replaces the entry for this state if there is one, else the entry in the
+   // bucket that is emptiest/oldest/shallowest.
 
-  HashKey key;
+  const Position &pos=searchData.pos;
 
-  HashRecord *hash;
+  // Get the key and the bucket it goes in.
+  const HashKey key=pos.currentState->key;
+  const uint32_t keyTop=static_cast<uint32_t>(key>>32);
+  TTBucket &bucket=g_transpositionTable[foldHashKey(key)];
 
-  // Get the key and a pointer to hash ellement.
-  key=g_currentState->key;
-  // Add the castle permisions and the en-passent info.
-  key^=g_castleHashCode[g_currentState->castlePerm];
-  if (g_currentState->enPass!=NO_EN_PASSANT)
-    key^=g_enPassantHashCode[g_currentState->enPass];
-  if (g_currentSide==BLACK)
-    key^=g_sideHashCode;
-  hash=&searchData.hashTable[foldHashKey(key)];
+  TTEntry *replace=nullptr;
+  int replaceValue=std::numeric_limits<int>::max();
+  for (TTEntry &entry : bucket.entries) {
 
-  // Is it better than this state (ie: lower depth?).
-  if (hash->flags!=0 && hash->depth>depth && !isMateScore(score))
-    return;
+    // Empty, so use it.
+    if ((entry.genBound&TT_BOUND_MASK)==0) {
+      replace=&entry;
+      break;
+    }
 
-  // Is it a collision?
-  if (hash->flags!=0)
-    searchData.numHashCollisions++;
+    // Already here: is it better than this state (ie: lower depth?).
+    if ((entry.keyCheck^ttEntryCheck(entry))==keyTop) {
+      if (entry.depth>depth && (entry.genBound&TT_GENERATION_MASK)==ttGeneration
+          && !isMateScore(score))
+        return;
+      replace=&entry;
+      break;
+    }
+
+    // Else prefer to replace old and then shallow entries.
+    const int age=static_cast<uint8_t>(ttGeneration-(entry.genBound&TT_GENERATION_MASK))
+                  /TT_GENERATION_STEP;
+    const int value=entry.depth-8*age;
+    if (value<replaceValue) {
+      replaceValue=value;
+      replace=&entry;
+    }
+
+  }
+
+  // Is it a collision (ie: throwing away another state)?
+  if ((replace->genBound&TT_BOUND_MASK)!=0
+      && (replace->keyCheck^ttEntryCheck(*replace))!=keyTop)
+    searchData.stats.hashCollisions++;
 
   // One more put in hash.
-  searchData.totalPutHashCount++;
+  searchData.stats.hashPuts++;
 
-  // Save the currect stuuf to the hash record.
-  hash->depth=depth;
-  hash->key=key;
-  hash->nextKey=nextKey;
-  hash->move=move;
+  // Save the currect stuuf to a local entry, then write it in one go.
+  TTEntry entry;
+  entry.depth=static_cast<uint8_t>(depth);
+  entry.move=packMove(move);
   if (isMateScore(score))
-    hash->score=score+(score>0?currentPly:-currentPly);
+    entry.score=score+(score>0?currentPly:-currentPly);
   else
-    hash->score=score;
+    entry.score=score;
   if (score>=beta)
-    hash->flags=LOWERBOUND;
+    entry.genBound=ttGeneration|LOWERBOUND;
   else if (score<=alpha)
-    hash->flags=UPPERBOUND;
+    entry.genBound=ttGeneration|UPPERBOUND;
   else
-    hash->flags=EXACTSCORE;
+    entry.genBound=ttGeneration|EXACTSCORE;
+  entry.keyCheck=keyTop^ttEntryCheck(entry);
+  *replace=entry;
 
 } // End ttPut.
 
 // =============================================================================
 
-uint8_t ttGet(SearchData &searchData,int currentPly,int depth,int &score,MoveStruct &move,
-              HashKey &nextKey)
+uint8_t ttGet(SearchData &searchData,int currentPly,int depth,int &score,MoveStruct &move)
 { // Get a record from the hash if possible.
 
-  HashRecord *hash;
-
-  HashKey key;
-
-  // Get the key and a pointer to hash ellement.
-  key=g_currentState->key;
-  // Add the castle permisions and the en-passent info.
-  key^=g_castleHashCode[g_currentState->castlePerm];
-  if (g_currentState->enPass!=NO_EN_PASSANT)
-    key^=g_enPassantHashCode[g_currentState->enPass];
-  if (g_currentSide==BLACK)
-    key^=g_sideHashCode;
-  hash=&searchData.hashTable[foldHashKey(key)];
-
-  // If not there, poor-draft or key not same - return.
-  if (hash->key!=key) {
-    move = MoveStruct{NONE, NONE, NORMAL_MOVE, NO_PROMOTION};  // So move is invalid.
-   nextKey=0;                           // So key is 0.
-   return 0;
-  }
+  const Position &pos=searchData.pos;
 
-  // Get the move and the score to return.
-  move=hash->move;
-  nextKey=hash->nextKey;
-  score=hash->score;
+  // Get the key and the bucket it would be in.
+  const HashKey key=pos.currentState->key;
+  const uint32_t keyTop=static_cast<uint32_t>(key>>32);
+  const TTBucket &bucket=g_transpositionTable[foldHashKey(key)];
 
-  // If depth is too low, we can still use the move!
-  if (hash->depth<depth && !isMateScore(hash->score))
-    return 0;
+  for (const TTEntry &sharedEntry : bucket.entries) {
 
-  // Alter to be the correct mate in N for the ply.
-  if (isMateScore(score))
-    score-=(score>0?currentPly:-currentPly);
+    // NOTE: Take a local copy, as another thread may write it while we look.
+    const TTEntry entry=sharedEntry;
+
+    // If not there or key not same - try the next one.
+    if ((entry.genBound&TT_BOUND_MASK)==0 || (entry.keyCheck^ttEntryCheck(entry))!=keyTop)
+      continue;
+
+    // Get the move and the score to return.
+    move=unpackMove(pos,entry.move);
+    score=entry.score;
+
+    // If depth is too low, we can still use the move!
+    if (entry.depth<depth && !isMateScore(entry.score))
+      return 0;
 
-  // Return the flags.
-  return hash->flags;
+    // Alter to be the correct mate in N for the ply.
+    if (isMateScore(score))
+      score-=(score>0?currentPly:-currentPly);
+
+    // Return the flags.
+    return entry.genBound&TT_BOUND_MASK;
+
+  }
+
+  // Not found.
+  move = MoveStruct{NONE, NONE, NORMAL_MOVE, NO_PROMOTION};  // So move is invalid.
+  return 0;
 
 } // End ttGet.
 
 // ==========================================================================
-